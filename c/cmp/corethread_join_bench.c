@@ -0,0 +1,80 @@
+/**
+* PROGRAM DESCRIPTION:
+*
+* Benchmark of the fork-join latency of corethreads.
+*
+* For 1 to all slave cores, core 0 starts an empty thread on each slave
+* and waits for all of them, ROUNDS times. Once with corethread_join(),
+* which polls main memory, and once with noc_corethread_join(), which
+* spins on a flag in the local SPM that is set through the NoC. Core 0
+* reports the average number of cycles per fork-join.
+*
+*/
+
+/*
+	Copyright: DTU, BSD License
+*/
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libnoc/noc.h"
+
+#define ROUNDS 20
+
+// Set by the threads, so the empty thread is not optimized away
+volatile _UNCACHED int done[MAX_CORES];
+
+void empty(void *arg) {
+  done[get_cpuid()]++;
+  int ret = 0;
+  corethread_exit(&ret);
+  return;
+}
+
+static unsigned fork_join(int n, int notify) {
+  // One flag word per slave in the communication SPM of core 0
+  volatile unsigned _SPM *flags = (volatile unsigned _SPM *)NOC_SPM_BASE;
+  unsigned long long start = get_cpu_cycles();
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 1; i <= n; i++) {
+      if (notify) {
+        noc_corethread_create(i, &empty, NULL, &flags[i]);
+      } else {
+        corethread_create(i, &empty, NULL);
+      }
+    }
+    for (int i = 1; i <= n; i++) {
+      int *ret;
+      if (notify) {
+        noc_corethread_join(i, (void **)&ret);
+      } else {
+        corethread_join(i, (void **)&ret);
+      }
+    }
+  }
+  unsigned long long stop = get_cpu_cycles();
+  return (unsigned)((stop - start) / ROUNDS);
+}
+
+int main() {
+  int cores = get_cpucnt();
+
+  printf("Cycles per fork-join of empty threads\n");
+  printf("%6s %10s %10s\n", "slaves", "poll", "noc");
+  for (int n = 1; n < cores; n++) {
+    unsigned poll = fork_join(n, 0);
+    unsigned noc = fork_join(n, 1);
+    printf("%6d %10u %10u\n", n, poll, noc);
+  }
+
+  int err = 0;
+  for (int i = 1; i < cores; i++) {
+    err |= done[i] != 2*ROUNDS*(cores-i);
+  }
+  if (err) {
+    puts("Wrong number of threads run");
+  }
+  return err;
+}
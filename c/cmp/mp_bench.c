@@ -49,8 +49,17 @@ int iterations = 100;
 //int num_sizes = sizeof(sizes)/sizeof(sizes[0]);
 int repeat_count = 1;
 
-qpd_t m2s;
-qpd_t s2m;
+#define M2S_ID 1
+#define S2M_ID 2
+#define NUM_BUF 4
+
+/* The ports and the initialization state of each core, indexed by core id */
+qpd_t * m2s_port[MAX_CORES];
+qpd_t * s2m_port[MAX_CORES];
+int ports_ready[MAX_CORES];
+int world_ready[MAX_CORES];
+#define m2s (m2s_port[get_cpuid()])
+#define s2m (s2m_port[get_cpuid()])
 
 communicator_t comm;
 communicator_t comm_world;
@@ -60,9 +69,17 @@ int sizes[1] = {BUFFER_SIZE};
 int num_sizes = sizeof(sizes)/sizeof(sizes[0]);
 
 #define SLAVE_CORE 4
-int cores[] = {0,SLAVE_CORE};
-int cores_world[] = {0,1,2,3,4,5,6,7,8};
-//coreid_t cores_world[] = {0,1};
+coreid_t cores[] = {0,SLAVE_CORE};
+coreid_t cores_world[MAX_CORES];
+int num_cores_world;
+
+/* How the receivers acknowledge messages */
+#define ACK_EACH 0
+#define ACK_BATCHED 1
+#define ACK_PIGGYBACK 2
+int ack_mode = ACK_EACH;
+/* Whether the current test runs on all cores */
+int world_test = 0;
 
 /*************************/
 /*  Benchmarks           */
@@ -99,7 +116,7 @@ void mp_send_size(qpd_t* qpd_ptr, int bytes) {
     //      *((volatile char _SPM *)m2s.write_buf+j) = send_data[k+j];
     //  }
       // Send the chunk of data
-      mp_send(qpd_ptr);
+      mp_send(qpd_ptr,0);
       DEBUGGER("Message sent\n");
       k += chunk;
   	}
@@ -108,7 +125,7 @@ void mp_send_size(qpd_t* qpd_ptr, int bytes) {
 void mp_recv_size(qpd_t* qpd_ptr, int bytes) {
 	int k = 0;
     while(k < bytes) {
-      mp_recv(qpd_ptr);
+      mp_recv(qpd_ptr,0);
       
       int chunk = 0;
       if ( bytes-k >= qpd_ptr->buf_size) {
@@ -122,7 +139,7 @@ void mp_recv_size(qpd_t* qpd_ptr, int bytes) {
     //  for (int j = 0; j < chunk; ++j) {
     //      *((volatile char _SPM *)qpd_ptr.write_buf+j) = send_data[k+j];
     //  }
-      mp_ack(qpd_ptr);
+      mp_ack(qpd_ptr,0);
       k += chunk;
   	}
 }
@@ -140,11 +157,11 @@ int latency_master(int cnt, int bytes) {
       inval_dcache();
       inval_mcache();   
     }
-    mp_send_size(&m2s,bytes);
+    mp_send_size(m2s,bytes);
   }
   TIMER_STOP;
-  mp_recv(&s2m);
-  mp_ack(&s2m);
+  mp_recv(s2m,0);
+  mp_ack(s2m,0);
   total = TIMER_ELAPSED;
   total -= calibrate_cache_flush(cnt);
   return(total/cnt);   
@@ -159,9 +176,9 @@ int latency_slave(int cnt, int bytes) {
       inval_dcache();
       inval_mcache();
     }
-    mp_recv_size(&m2s,bytes);
+    mp_recv_size(m2s,bytes);
   }
-  mp_send(&s2m); 
+  mp_send(s2m,0); 
   return 0;
 }
 
@@ -178,8 +195,8 @@ int roundtrip_master(int cnt, int bytes) {
       inval_dcache();
       inval_mcache();
     }
-    mp_send_size(&m2s, bytes);
-    mp_recv_size(&s2m, bytes);
+    mp_send_size(m2s, bytes);
+    mp_recv_size(s2m, bytes);
   }
   TIMER_STOP;
   total = TIMER_ELAPSED;
@@ -196,8 +213,8 @@ int roundtrip_slave(int cnt, int bytes) {
       inval_dcache();
       inval_mcache();
     }
-    mp_recv_size(&m2s, bytes);
-    mp_send_size(&s2m, bytes);
+    mp_recv_size(m2s, bytes);
+    mp_send_size(s2m, bytes);
   }
   return 0;
 }
@@ -215,10 +232,10 @@ int bandwidth_master(int cnt, int bytes)
       inval_dcache();
       inval_mcache();
     }
-        mp_send_size(&m2s, bytes);
+        mp_send_size(m2s, bytes);
     }
-      mp_recv(&s2m);
-      mp_ack(&s2m);
+      mp_recv(s2m,0);
+      mp_ack(s2m,0);
       TIMER_STOP;
       total = TIMER_ELAPSED;
       total -= calibrate_cache_flush(cnt);
@@ -236,9 +253,9 @@ int bandwidth_slave(int cnt, int bytes)
       inval_dcache();
       inval_mcache();
     }
-        mp_recv_size(&m2s, bytes);
+        mp_recv_size(m2s, bytes);
     }
-      mp_send(&s2m);
+      mp_send(s2m,0);
       return 0;
 }
 
@@ -360,26 +377,66 @@ int barrier_slave(int cnt, int bytes)
 }
 
 
+/*************************/
+/*  Setup                */
+/*************************/
+
+/* Create the ports and the communicators of the calling core the first
+   time a test runs on it */
+void setup(void) {
+  int id = get_cpuid();
+  if (!world_test && !ports_ready[id]) {
+    if (id == NOC_MASTER) {
+      m2s = mp_create_qport(M2S_ID, SOURCE, BUFFER_SIZE, NUM_BUF);
+      s2m = mp_create_qport(S2M_ID, SINK, BUFFER_SIZE, NUM_BUF);
+    } else {
+      m2s = mp_create_qport(M2S_ID, SINK, BUFFER_SIZE, NUM_BUF);
+      s2m = mp_create_qport(S2M_ID, SOURCE, BUFFER_SIZE, NUM_BUF);
+    }
+    if (m2s == NULL || s2m == NULL) {
+      abort();
+    }
+    mp_init_ports();
+    if (!mp_communicator_init(&comm, 2, cores, 0)) {
+      abort();
+    }
+    ports_ready[id] = 1;
+  }
+  if (world_test && !world_ready[id]) {
+    if (!mp_communicator_init(&comm_world, num_cores_world, cores_world, BUFFER_SIZE)) {
+      abort();
+    }
+    world_ready[id] = 1;
+  }
+  if (world_test) {
+    return;
+  }
+
+  /* Apply the acknowledgement mode to the receiving port */
+  qpd_t * sink = id == NOC_MASTER ? s2m : m2s;
+  qpd_t * source = id == NOC_MASTER ? m2s : s2m;
+  if (ack_mode == ACK_EACH) {
+    mp_set_ack_batch(sink, 1, NUM_BUF);
+  } else {
+    /* Only send acknowledgements when the sender runs out of buffers */
+    mp_set_ack_batch(sink, NUM_BUF, 0);
+  }
+  if (ack_mode == ACK_PIGGYBACK) {
+    mp_pair_qports(sink, source);
+  }
+}
+
 void loop(void* arg) {
   int (*test)(int, int) = (int (*)(int, int))arg;
   int i, j;
   int res;
-  //communicator_t* loc_com = &comm;
-  communicator_t* loc_com = &comm_world;
-  //if (test == barrier_master || test == barrier_slave ||
-  //    test == broadcast_master || test == broadcast_slave) {
-  //  loc_com = &comm_world;
-  //}
-  //communicator_t stack_com;
-  //stack_com.barrier_set = loc_com->barrier_set;
-  //for(int i = 0; i < loc_com->count; i++) {
-  //  stack_com.addr[i] = loc_com->addr[i];
-  //}
-  //stack_com.count = loc_com->count;
-  //stack_com.msg_size = loc_com->msg_size;
+  /* The test parameters may have changed since the last run on this core */
+  inval_dcache();
+  setup();
+  communicator_t* loc_com = world_test ? &comm_world : &comm;
   DEBUGGER("Initial test run\n");
   /* Allow routing/cache setup ahead of time */
-  test(1,1024);
+  test(1,BUFFER_SIZE);
   DEBUGGER("Initial test run done\n");
   for( i=0; i < num_sizes; i++){
     if (flush & FLUSH_BETWEEN_SIZES)
@@ -393,13 +450,15 @@ void loop(void* arg) {
         inval_mcache();
       }
       mp_barrier(loc_com);
-      //mp_barrier(&stack_com);
       res = test(iterations, sizes[i]);
       my_two_printf("%u\t%i\n",sizes[i],res);
       mp_barrier(loc_com);
-      //mp_barrier(&stack_com);
     }
   }
+  /* Do not leave acknowledgements behind for the next test */
+  if (!world_test) {
+    mp_ack_flush(get_cpuid() == NOC_MASTER ? s2m : m2s, 0);
+  }
 
 	inval_dcache();
 	inval_mcache();
@@ -412,136 +471,76 @@ void loop(void* arg) {
 
 }
 
+/* Run a test on the master and the slave core */
+void run_pair(int (*master)(int, int), int (*slave)(int, int), int mode) {
+  int* ret;
+  ack_mode = mode;
+  world_test = 0;
+  if (corethread_create(SLAVE_CORE,&loop,(void*)slave) != 0) {
+    printf("Corethread %d not created\n",SLAVE_CORE);
+  }
+  loop((void*)master);
+  corethread_join(SLAVE_CORE,(void**)&ret);
+}
+
+/* Run a test on all cores */
+void run_world(int (*master)(int, int), int (*slave)(int, int)) {
+  int* ret;
+  world_test = 1;
+  for (int i = 0; i < num_cores_world; i++) {
+    if (cores_world[i] != NOC_MASTER) {
+      if (corethread_create(cores_world[i],&loop,(void*)slave) != 0) {
+        printf("Corethread %d not created\n",i);
+      }
+    }
+  }
+  loop((void*)master);
+  for (int i = 0; i < num_cores_world; i++) {
+    if (cores_world[i] != NOC_MASTER) {
+      corethread_join(cores_world[i],(void**)&ret);
+    }
+  }
+}
+
 /********************/
 /*  main            */
 /********************/
 
 
 int main() {
-  int slave1 = 1;
-  int slave2 = 2;
-  int slave3 = 3;
-  int slave4 = 4;
-  int slave5 = 5;
-  int slave6 = 6;
-  int slave7 = 7;
-  int slave8 = 8;
-
-  if (!mp_chan_init(&m2s,
-      get_cpuid(),
-      slave4,
-      BUFFER_SIZE,
-      2)) {
-      abort();
-  }
-  if (!mp_chan_init(&s2m,
-      slave4,
-      get_cpuid(),
-      BUFFER_SIZE,
-      2)) {
-      abort();
-  }
-  if (!mp_communicator_init(&comm,
-      2,
-      cores,
-      0)) {
-    abort();
+  num_cores_world = get_cpucnt();
+  for (int i = 0; i < num_cores_world; i++) {
+    cores_world[i] = i;
   }
-  if (!mp_communicator_init(&comm_world,
-      sizeof(cores_world)/sizeof(cores_world[0]),
-      cores_world,
-      BUFFER_SIZE)) {
-    abort();
-  }
-
-  int* ret;
-  /* set up the run */
-  //corethread_create(slave,&loop,(void*)roundtrip_slave);
 
   /* run appropriate test */
-//  // TEST_LATENCY
-//  puts("Latency (usecs)");
-//  corethread_create(slave4,&loop,(void*)latency_slave);
-//  loop(latency_master);
-//  corethread_join(slave4,(void**)&ret);
-//
-//  // TEST_ROUNDTRIP
-//  puts("Roundtrip (Transactions/sec)");
-//  corethread_create(slave4,&loop,(void*)roundtrip_slave);
-//  loop(roundtrip_master);
-//  corethread_join(slave4,(void**)&ret);
-//
-//  // TEST_BANDWIDTH
-//  puts("Bandwidth (KB/sec)");
-//  corethread_create(slave4,&loop,(void*)bandwidth_slave);
-//  loop(bandwidth_master);
-//  corethread_join(slave4,(void**)&ret);
-
-//  // TEST_BIBANDWIDTH
-//  puts("Bibandwidth");
-//  corethread_create(slave4,&loop,(void*)bibandwidth_slave);
-//  loop(bibandwidth_master);
-//  corethread_join(slave4,(void**)&ret);
-//
-//  // TEST_REDUCE
-//  puts("Reduce");
-//  corethread_create(slave4,&loop,(void*)reduce_slave);
-//  loop(reduce_master);
-//  corethread_join(slave4,(void**)&ret);
-//
-//  // TEST_ALLREDUCE
-//  puts("Allreduce");
-//  corethread_create(slave4,&loop,(void*)allreduce_slave);
-//  loop(allreduce_master);
-//  corethread_join(slave4,(void**)&ret);
-//
-//  // TEST_ALLTOALL
-//  puts("Alltoall");
-//  corethread_create(slave4,&loop,(void*)alltoall_slave);
-//  loop(alltoall_master);
-//  corethread_join(slave4,(void**)&ret);
+  // TEST_LATENCY
+  puts("Latency (cycles)");
+  run_pair(latency_master, latency_slave, ACK_EACH);
+
+  // TEST_BANDWIDTH, before and after batching the acknowledgements
+  puts("Bandwidth (KB/sec)");
+  run_pair(bandwidth_master, bandwidth_slave, ACK_EACH);
+  puts("Bandwidth, batched acknowledgements (KB/sec)");
+  run_pair(bandwidth_master, bandwidth_slave, ACK_BATCHED);
+
+  // TEST_ROUNDTRIP, before and after piggybacking the acknowledgements
+  puts("Roundtrip (Transactions/sec)");
+  run_pair(roundtrip_master, roundtrip_slave, ACK_EACH);
+  puts("Roundtrip, piggybacked acknowledgements (Transactions/sec)");
+  run_pair(roundtrip_master, roundtrip_slave, ACK_PIGGYBACK);
 
   /////////////////////////////////////////////////////////////////////////////
   // TEST_BARRIER
   /////////////////////////////////////////////////////////////////////////////
-  puts("Barrier (usecs)");
-  for(int i = 0; i < sizeof(cores_world)/sizeof(cores_world[0]); i++) {
-    if (i != NOC_MASTER) {
-      if(corethread_create(cores_world[i],&loop,(void*)barrier_slave) != 0){
-        printf("Corethread %d not created\n",i);
-      }
-    }
-  }
-  loop(barrier_master);
-  //puts("Master finished");
-  for (int i = 0; i < sizeof(cores_world)/sizeof(cores_world[0]); ++i) {
-    if (i != NOC_MASTER) {
-      corethread_join(cores_world[i],(void**)&ret);
-      //printf("Slave %d joined\n",i);
-    }
-  }
-
+  puts("Barrier (cycles)");
+  run_world(barrier_master, barrier_slave);
 
-
-//  /////////////////////////////////////////////////////////////////////////////
-//  // TEST_BROADCAST
-//  /////////////////////////////////////////////////////////////////////////////
-//  puts("Broadcast (KB/sec)");
-//  for(int i = 0; i < sizeof(cores_world)/sizeof(cores_world[0]); i++) {
-//    if (i != NOC_MASTER) {
-//      if(corethread_create(cores_world[i],&loop,(void*)broadcast_slave) != 0){
-//        printf("Corethread %d not created\n",i);
-//      }
-//    }
-//  }
-//  loop(broadcast_master);
-//  //puts("Master finished");
-//  for (int i = 0; i < sizeof(cores_world)/sizeof(cores_world[0]); ++i) {
-//    if (i != NOC_MASTER) {
-//      corethread_join(cores_world[i],(void**)&ret);
-//      //printf("Slave %d joined\n",i);
-//    }
-//  }
+  /////////////////////////////////////////////////////////////////////////////
+  // TEST_BROADCAST
+  /////////////////////////////////////////////////////////////////////////////
+  puts("Broadcast (KB/sec)");
+  run_world(broadcast_master, broadcast_slave);
 
   exit(0);
 }
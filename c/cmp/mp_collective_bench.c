@@ -0,0 +1,176 @@
+/**
+* PROGRAM DESCRIPTION:
+*
+* Benchmark of the collective operations in libmp.
+*
+* For a growing number of cores (2, 4, 8, ... and all cores) the cores
+* 0..n-1 form a communicator and run each collective operation
+* ITERATIONS times. Core 0 reports the average number of cycles per
+* operation. Every operation starts with a barrier, so the numbers of the
+* data operations include one barrier.
+*
+* After the timing each operation is run once more and its result is
+* checked.
+*
+*/
+
+/*
+	Copyright: DTU, BSD License
+*/
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libmp/mp.h"
+
+#define ITERATIONS 100
+#define MSG_SIZE 16
+#define MSG_WORDS (MSG_SIZE/sizeof(int))
+
+#define MAX_COMMS 8
+#define NUM_OPS 4
+
+const char *op_names[NUM_OPS] = {"barrier", "broadcast", "reduce", "allgather"};
+
+communicator_t comms[MAX_COMMS];
+int comm_sizes[MAX_COMMS];
+int num_comms;
+coreid_t member_ids[MAX_CORES];
+
+// Written by core 0 only
+unsigned results[MAX_COMMS][NUM_OPS];
+
+static void fill_buf(communicator_t *comm, int value) {
+  volatile int _SPM * buf = (volatile int _SPM *)mp_comm_buf(comm);
+  for (int i = 0; i < MSG_WORDS; i++) {
+    buf[i] = value + i;
+  }
+}
+
+static unsigned run_op(communicator_t *comm, int op) {
+  unsigned long long start, stop;
+
+  mp_barrier(comm);
+  start = get_cpu_cycles();
+  for (int i = 0; i < ITERATIONS; i++) {
+    switch (op) {
+    case 0:
+      mp_barrier(comm);
+      break;
+    case 1:
+      mp_broadcast(comm, 0);
+      break;
+    case 2:
+      mp_reduce(comm, 0, REDUCE_SUM);
+      break;
+    case 3:
+      mp_allgather(comm);
+      break;
+    }
+  }
+  stop = get_cpu_cycles();
+  return (unsigned)((stop - start) / ITERATIONS);
+}
+
+static int check_ops(communicator_t *comm, int n) {
+  int id = get_cpuid();
+  int err = 0;
+  volatile int _SPM * buf = (volatile int _SPM *)mp_comm_buf(comm);
+
+  // Broadcast from core 0
+  fill_buf(comm, id == 0 ? 1000 : -1);
+  mp_broadcast(comm, 0);
+  for (int i = 0; i < MSG_WORDS; i++) {
+    err |= buf[i] != 1000 + i;
+  }
+
+  // Sum of the core ids at core 0
+  fill_buf(comm, id);
+  mp_reduce(comm, 0, REDUCE_SUM);
+  if (id == 0) {
+    for (int i = 0; i < MSG_WORDS; i++) {
+      err |= buf[i] != n*(n-1)/2 + n*i;
+    }
+  }
+
+  // Each core contributes its id
+  fill_buf(comm, id);
+  mp_allgather(comm);
+  for (int k = 0; k < n; k++) {
+    volatile int _SPM * slot = (volatile int _SPM *)mp_allgather_slot(comm, k);
+    for (int i = 0; i < MSG_WORDS; i++) {
+      err |= slot[i] != k + i;
+    }
+  }
+  return err;
+}
+
+static void run_all(void) {
+  int id = get_cpuid();
+  for (int c = 0; c < num_comms; c++) {
+    // The members of communicator c are the cores 0..comm_sizes[c]-1
+    if (id >= comm_sizes[c]) {
+      continue;
+    }
+    if (!mp_communicator_init(&comms[c], comm_sizes[c], member_ids, MSG_SIZE)) {
+      abort();
+    }
+    fill_buf(&comms[c], id);
+    for (int op = 0; op < NUM_OPS; op++) {
+      unsigned cycles = run_op(&comms[c], op);
+      if (id == 0) {
+        results[c][op] = cycles;
+      }
+    }
+    if (check_ops(&comms[c], comm_sizes[c])) {
+      printf("Core %d: wrong result with %d cores\n", id, comm_sizes[c]);
+    }
+  }
+}
+
+void worker(void *arg) {
+  run_all();
+  int ret = 0;
+  corethread_exit(&ret);
+  return;
+}
+
+int main() {
+  int cores = get_cpucnt();
+
+  for (int i = 0; i < cores; i++) {
+    member_ids[i] = i;
+  }
+  num_comms = 0;
+  for (int n = 2; n < cores && num_comms < MAX_COMMS-1; n <<= 1) {
+    comm_sizes[num_comms++] = n;
+  }
+  comm_sizes[num_comms++] = cores;
+
+  for (int i = 1; i < cores; i++) {
+    if (corethread_create(i, &worker, NULL) != 0) {
+      printf("Corethread %d not created\n", i);
+    }
+  }
+  run_all();
+  for (int i = 1; i < cores; i++) {
+    int *ret;
+    corethread_join(i, (void **)&ret);
+  }
+
+  printf("Cycles per operation, %d bytes per core\n", MSG_SIZE);
+  printf("%6s", "cores");
+  for (int op = 0; op < NUM_OPS; op++) {
+    printf(" %10s", op_names[op]);
+  }
+  printf("\n");
+  for (int c = 0; c < num_comms; c++) {
+    printf("%6d", comm_sizes[c]);
+    for (int op = 0; op < NUM_OPS; op++) {
+      printf(" %10u", results[c][op]);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+/**
+* PROGRAM DESCRIPTION:
+*
+* Contention benchmark of the message passing lock in libmp.
+*
+* For a growing number of cores (2, 4, 8, ... and all cores, at most
+* LOCK_MAX_CORES) the cores 0..n-1 share one lock and each acquire it
+* MAX_CNT times. The critical section waits WAIT cycles on the deadline
+* device and increments a shared counter, which is checked at the end.
+* Core 0 reports the average and maximum acquire latency over all cores
+* and the fairness as the ratio of the largest to the smallest per-core
+* average.
+*
+*/
+
+/*
+	Copyright: DTU, BSD License
+*/
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libmp/mp.h"
+
+#ifndef MAX_CNT
+#define MAX_CNT 100
+#endif
+#ifndef WAIT
+#define WAIT 100
+#endif
+
+#define MAX_GROUPS 8
+
+lock_group_t groups[MAX_GROUPS];
+int group_sizes[MAX_GROUPS];
+int num_groups;
+coreid_t member_ids[LOCK_MAX_CORES];
+
+_UNCACHED int counter[MAX_GROUPS];
+_UNCACHED unsigned avg_cycles[MAX_GROUPS][LOCK_MAX_CORES];
+_UNCACHED unsigned max_cycles[MAX_GROUPS][LOCK_MAX_CORES];
+
+volatile _IODEV int *dead_ptr = (volatile _IODEV int *) PATMOS_IO_DEADLINE;
+
+static void test(int g) {
+  int id = get_cpuid();
+  LOCK_T * lock = initialize_lock_group(&groups[g], group_sizes[g], member_ids);
+  if (lock == NULL) {
+    abort();
+  }
+
+  unsigned long long sum = 0;
+  unsigned max = 0;
+  for (int i = 0; i < MAX_CNT; i++) {
+    unsigned long long start = get_cpu_cycles();
+    acquire_lock(lock);
+    unsigned cycles = (unsigned)(get_cpu_cycles() - start);
+    *dead_ptr = WAIT;
+    counter[g]++;
+    *dead_ptr;
+    release_lock(lock);
+
+    sum += cycles;
+    if (cycles > max) {
+      max = cycles;
+    }
+  }
+  avg_cycles[g][id] = (unsigned)(sum / MAX_CNT);
+  max_cycles[g][id] = max;
+}
+
+static void run_all(void) {
+  int id = get_cpuid();
+  for (int g = 0; g < num_groups; g++) {
+    // The members of group g are the cores 0..group_sizes[g]-1
+    if (id < group_sizes[g]) {
+      test(g);
+    }
+  }
+}
+
+void worker(void *arg) {
+  run_all();
+  int ret = 0;
+  corethread_exit(&ret);
+  return;
+}
+
+int main() {
+  int cores = get_cpucnt();
+  if (cores > LOCK_MAX_CORES) {
+    cores = LOCK_MAX_CORES;
+  }
+
+  for (int i = 0; i < cores; i++) {
+    member_ids[i] = i;
+  }
+  num_groups = 0;
+  for (int n = 2; n < cores && num_groups < MAX_GROUPS-1; n <<= 1) {
+    group_sizes[num_groups++] = n;
+  }
+  group_sizes[num_groups++] = cores;
+
+  for (int i = 1; i < cores; i++) {
+    if (corethread_create(i, &worker, NULL) != 0) {
+      printf("Corethread %d not created\n", i);
+    }
+  }
+  run_all();
+  for (int i = 1; i < cores; i++) {
+    int *ret;
+    corethread_join(i, (void **)&ret);
+  }
+
+  printf("Acquire latency in cycles, %d acquires per core, %d cycles held\n",
+         MAX_CNT, WAIT);
+  printf("%6s %10s %10s %10s %8s\n", "cores", "average", "maximum", "fairness", "valid");
+  for (int g = 0; g < num_groups; g++) {
+    int n = group_sizes[g];
+    unsigned long long sum = 0;
+    unsigned max = 0;
+    unsigned min_avg = avg_cycles[g][0];
+    unsigned max_avg = avg_cycles[g][0];
+    for (int i = 0; i < n; i++) {
+      sum += avg_cycles[g][i];
+      if (max_cycles[g][i] > max) {
+        max = max_cycles[g][i];
+      }
+      if (avg_cycles[g][i] < min_avg) {
+        min_avg = avg_cycles[g][i];
+      }
+      if (avg_cycles[g][i] > max_avg) {
+        max_avg = avg_cycles[g][i];
+      }
+    }
+    printf("%6d %10u %10u %7u.%02u %8s\n", n, (unsigned)(sum / n), max,
+           max_avg / (min_avg ? min_avg : 1),
+           (max_avg * 100 / (min_avg ? min_avg : 1)) % 100,
+           counter[g] == n * MAX_CNT ? "yes" : "no");
+  }
+  return 0;
+}
@@ -0,0 +1,150 @@
+/**
+* PROGRAM DESCRIPTION:
+*
+* Benchmark of the sampling port implementations in libmp.
+*
+* For each implementation and sample size the slave core writes samples
+* to core 0 as fast as it can, while core 0 reads ITERATIONS samples.
+* Both sides measure the average and the maximum number of cycles of a
+* call, so the implementation of a channel can be chosen from its sample
+* size and whether the reader or the writer is more critical.
+*
+*        __________           _________
+*        |        |           |       |
+*        | Core 0 | <-------- | Slave |
+*        |________|           |_______|
+*
+*/
+
+/*
+	Copyright: DTU, BSD License
+*/
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libmp/mp.h"
+
+#define ITERATIONS 100
+#define SLAVE_CORE 1
+
+#define NUM_IMPLS 7
+#define NUM_SIZES 3
+#define NUM_CONFIGS (NUM_IMPLS*NUM_SIZES)
+
+const char *impl_names[NUM_IMPLS] = {"single_shm", "single_noc", "double_noc",
+                                     "triple_noc", "multi_noc_nb", "multi_noc_mp",
+                                     "double_noc_wr"};
+const int sample_sizes[NUM_SIZES] = {8, 64, 256};
+
+// Configuration c uses channel c+1
+#define CONFIG_IMPL(c) ((sport_impl_t)((c) / NUM_SIZES))
+#define CONFIG_SIZE(c) (sample_sizes[(c) % NUM_SIZES])
+
+volatile _UNCACHED int written;
+volatile _UNCACHED int read_done;
+
+_UNCACHED unsigned read_avg[NUM_CONFIGS];
+_UNCACHED unsigned read_max[NUM_CONFIGS];
+_UNCACHED unsigned write_avg[NUM_CONFIGS];
+_UNCACHED unsigned write_max[NUM_CONFIGS];
+
+void func_worker_1(void* arg) {
+  volatile int _SPM * sample = mp_alloc(sample_sizes[NUM_SIZES-1]);
+  if (sample == NULL) {
+    abort();
+  }
+
+  for (int c = 0; c < NUM_CONFIGS; ++c) {
+    spd_t * sport = mp_create_sport_impl(c+1, SOURCE, CONFIG_SIZE(c), CONFIG_IMPL(c));
+    if (sport == NULL) {
+      abort();
+    }
+    mp_init_ports();
+
+    unsigned long long sum = 0;
+    unsigned max = 0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+      for (int j = 0; j < CONFIG_SIZE(c)/sizeof(int); ++j) {
+        sample[j] = i;
+      }
+      unsigned long long start = get_cpu_cycles();
+      mp_write(sport, sample);
+      unsigned cycles = (unsigned)(get_cpu_cycles() - start);
+      sum += cycles;
+      if (cycles > max) {
+        max = cycles;
+      }
+      written = c+1;
+    }
+    write_avg[c] = (unsigned)(sum / ITERATIONS);
+    write_max[c] = max;
+
+    // Keep the reader supplied with new samples until it is done
+    while (read_done <= c) {
+      mp_write(sport, sample);
+    }
+  }
+
+  int ret = 0;
+  corethread_exit(&ret);
+  return;
+}
+
+int main() {
+
+  volatile int _SPM * sample = mp_alloc(sample_sizes[NUM_SIZES-1]);
+  if (sample == NULL) {
+    abort();
+  }
+
+  if (corethread_create(SLAVE_CORE, &func_worker_1, NULL) != 0) {
+    puts("Corethread not created");
+    abort();
+  }
+
+  for (int c = 0; c < NUM_CONFIGS; ++c) {
+    spd_t * sport = mp_create_sport_impl(c+1, SINK, CONFIG_SIZE(c), CONFIG_IMPL(c));
+    if (sport == NULL) {
+      abort();
+    }
+    mp_init_ports();
+
+    // Wait for the first sample
+    while (written <= c) {
+      /* Spin */
+    }
+
+    unsigned long long sum = 0;
+    unsigned max = 0;
+    for (int i = 0; i < ITERATIONS; ++i) {
+      unsigned long long start = get_cpu_cycles();
+      mp_read(sport, sample);
+      unsigned cycles = (unsigned)(get_cpu_cycles() - start);
+      sum += cycles;
+      if (cycles > max) {
+        max = cycles;
+      }
+    }
+    read_avg[c] = (unsigned)(sum / ITERATIONS);
+    read_max[c] = max;
+    read_done = c+1;
+  }
+
+  int *ret;
+  corethread_join(SLAVE_CORE, (void **)&ret);
+
+  printf("Cycles per call, %d calls\n", ITERATIONS);
+  printf("%14s %6s %10s %10s %10s %10s\n", "impl", "bytes",
+         "read avg", "read max", "write avg", "write max");
+  for (int c = 0; c < NUM_CONFIGS; ++c) {
+    printf("%14s %6d %10u %10u %10u %10u\n", impl_names[CONFIG_IMPL(c)], CONFIG_SIZE(c),
+           read_avg[c], read_max[c], write_avg[c], write_max[c]);
+  }
+  for (int s = 0; s < NUM_SIZES; ++s) {
+    printf("Automatic choice for %d bytes: %s\n", sample_sizes[s],
+           impl_names[mp_sport_impl(sample_sizes[s])]);
+  }
+  return 0;
+}
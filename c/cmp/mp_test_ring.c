@@ -0,0 +1,106 @@
+/**
+* PROGRAM DESCRIPTION:
+*
+* This is an test case for the zero-copy queuing ports in libmp.
+*
+* Core 0 streams numbered messages to a slave core. The messages are
+* written in place into the send ring with mp_reserve() and mp_commit(),
+* so several transfers are queued without waiting for the DMA. The slave
+* holds up to ACK_BATCH messages before it releases them with one
+* mp_ack_n() and checks that they arrive in order.
+*
+*        __________ (chan 1)  _________
+*        |        | --------> |       |
+*        | Core 0 |           | Slave |
+*        |________|           |_______|
+*
+*/
+
+/*
+	Copyright: DTU, BSD License
+*/
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libmp/mp.h"
+
+#define MP_CHAN_1_ID 1
+#define MP_CHAN_1_NUM_BUF 4
+#define MP_CHAN_1_NUM_SEND_BUF 4
+#define MP_CHAN_1_MSG_SIZE 32
+
+#define MSG_COUNT 100
+#define ACK_BATCH 2
+
+int worker_errors;
+
+void func_worker_1(void* arg) {
+  qpd_t * chan1 = mp_create_qport_ring(MP_CHAN_1_ID, SINK,
+              MP_CHAN_1_MSG_SIZE, MP_CHAN_1_NUM_BUF, MP_CHAN_1_NUM_SEND_BUF);
+  if (chan1 == NULL) {
+    abort();
+  }
+  mp_init_ports();
+
+  int held = 0;
+  for (int i = 0; i < MSG_COUNT; ++i) {
+    volatile int _SPM * msg;
+    while ((msg = (volatile int _SPM *)mp_nbrecv_ptr(chan1)) == NULL) {
+      /* Spin */
+    }
+    for (int j = 0; j < MP_CHAN_1_MSG_SIZE/sizeof(int); ++j) {
+      if (msg[j] != i + j) {
+        worker_errors++;
+      }
+    }
+    // Release the messages in batches
+    if (++held == ACK_BATCH) {
+      mp_ack_n(chan1, 0, held);
+      held = 0;
+    }
+  }
+  if (held != 0) {
+    mp_ack_n(chan1, 0, held);
+  }
+
+  corethread_exit(&worker_errors);
+  return;
+}
+
+int main() {
+
+  puts("Master");
+  int worker_1 = 2; // For now the core ID
+
+  corethread_create(worker_1,&func_worker_1,NULL);
+
+  qpd_t * chan1 = mp_create_qport_ring(MP_CHAN_1_ID, SOURCE,
+              MP_CHAN_1_MSG_SIZE, MP_CHAN_1_NUM_BUF, MP_CHAN_1_NUM_SEND_BUF);
+  if (chan1 == NULL) {
+    abort();
+  }
+  mp_init_ports();
+
+  unsigned long long start = get_cpu_cycles();
+  for (int i = 0; i < MSG_COUNT; ++i) {
+    volatile int _SPM * msg;
+    while ((msg = (volatile int _SPM *)mp_reserve(chan1)) == NULL) {
+      /* Spin until a send buffer is free */
+    }
+    for (int j = 0; j < MP_CHAN_1_MSG_SIZE/sizeof(int); ++j) {
+      msg[j] = i + j;
+    }
+    mp_commit(chan1);
+  }
+  mp_flush(chan1, 0);
+  unsigned long long stop = get_cpu_cycles();
+
+  int* res;
+  corethread_join(worker_1,(void**)&res);
+  printf("%d messages of %d bytes in %llu cycles, %d errors\n",
+         MSG_COUNT, MP_CHAN_1_MSG_SIZE, stop - start, *res);
+
+  return *res;
+}
@@ -0,0 +1,132 @@
+/*
+    Test of the libnoc completion queues with a double-buffered stream.
+
+    Core 0 produces BLOCKS blocks and sends them to the two receive
+    buffers of core 1. With the completion queue the next block is
+    produced while the current one is transferred. Core 1 learns about
+    each block from its data interrupt and returns a credit when it has
+    consumed it. The run is repeated with a blocking transfer for
+    comparison.
+
+    Copyright: DTU, BSD License
+*/
+
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <machine/patmos.h>
+#include <machine/spm.h>
+#include "libnoc/noc.h"
+#include "libcorethread/corethread.h"
+
+#define SLAVE 1
+#define WORDS 64
+#define BLOCKS 32
+#define WORK 200
+
+// The same layout is used in the communication SPM of both cores
+struct stream_t {
+  int buf[2][WORDS];
+  int consumed;
+  int credit;
+};
+
+volatile _SPM struct stream_t *stream = (volatile _SPM struct stream_t *)NOC_SPM_BASE;
+
+volatile _UNCACHED int run;
+volatile _UNCACHED int ready;
+volatile _UNCACHED int errors;
+
+static void produce(volatile _SPM int *buf, int block) {
+  for (int i = 0; i < WORDS; i++) {
+    buf[i] = block + i;
+  }
+  for (int i = 0; i < WORK; i++) {
+    asm volatile ("");
+  }
+}
+
+static void consumer(void *arg) {
+  volatile void _SPM *addr[1];
+  noc_recv_irq_enable();
+  for (int r = 1; r <= 2; r++) {
+    // The last credit must arrive before the producer is reset
+    while (!noc_dma_done(NOC_MASTER)) {
+      /* spin */
+    }
+    ready = r;
+    while (run != r) {
+      /* spin */
+    }
+    for (int b = 0; b < BLOCKS; b++) {
+      while (noc_recv_drain(addr, 1) == 0) {
+        /* spin */
+      }
+      volatile _SPM int *buf = stream->buf[b % 2];
+      for (int i = 0; i < WORDS; i++) {
+        if (buf[i] != b + i) {
+          errors++;
+          break;
+        }
+      }
+      stream->credit = b + 1;
+      noc_write(NOC_MASTER, &stream->consumed, &stream->credit, sizeof(int), 0);
+    }
+  }
+  int ret = 0;
+  corethread_exit(&ret);
+}
+
+static unsigned long long producer(int overlap) {
+  noc_cq_t cq;
+  unsigned tags[1];
+  noc_cq_init(&cq);
+
+  unsigned long long start = get_cpu_cycles();
+  produce(stream->buf[0], 0);
+  for (int b = 0; b < BLOCKS; b++) {
+    // The receive buffer is free when block b-2 has been consumed
+    while (stream->consumed < b - 1) {
+      /* spin */
+    }
+    while (!noc_cq_post(&cq, b, SLAVE, stream->buf[b % 2], stream->buf[b % 2],
+                        WORDS*sizeof(int), 1)) {
+      noc_cq_drain(&cq, tags, 1);
+    }
+    if (!overlap) {
+      while (!noc_cq_empty(&cq)) {
+        noc_cq_drain(&cq, tags, 1);
+      }
+    }
+    // Block b-1 has left the other local buffer
+    if (b + 1 < BLOCKS) {
+      produce(stream->buf[(b + 1) % 2], b + 1);
+    }
+  }
+  while (stream->consumed < BLOCKS) {
+    /* spin */
+  }
+  return get_cpu_cycles() - start;
+}
+
+int main() {
+  unsigned long long cycles[2];
+
+  corethread_create(SLAVE, &consumer, NULL);
+  for (int r = 1; r <= 2; r++) {
+    while (ready != r) {
+      /* spin */
+    }
+    stream->consumed = 0;
+    run = r;
+    cycles[r-1] = producer(r == 1);
+  }
+
+  int *ret;
+  corethread_join(SLAVE, (void **)&ret);
+
+  printf("%d blocks of %d bytes\n", BLOCKS, (int)(WORDS*sizeof(int)));
+  printf("overlapped: %llu cycles\n", cycles[0]);
+  printf("blocking:   %llu cycles\n", cycles[1]);
+  printf("%d errors\n", errors);
+  return errors != 0;
+}
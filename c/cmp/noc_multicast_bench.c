@@ -0,0 +1,134 @@
+/*
+    Benchmark of one-to-many transfers with libnoc.
+
+    Core 0 sends a buffer to all other cores, either with one unicast
+    after the other, with noc_multicast(), or along a tree with
+    noc_tree_forward(). The time is measured until all receivers have
+    seen the last word of the buffer.
+
+    Copyright: DTU, BSD License
+*/
+
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <machine/patmos.h>
+#include <machine/spm.h>
+#include "libnoc/noc.h"
+#include "libcorethread/corethread.h"
+
+#define WORDS 64
+#define ROUNDS 10
+#define FANOUT 2
+
+#define MODE_SERIAL    0
+#define MODE_MULTICAST 1
+#define MODE_TREE      2
+#define MODES          3
+
+const char *mode_names[MODES] = {"serial", "multicast", "tree"};
+
+// The buffer is at the same address at all cores, the last word is the
+// sequence number, which is transmitted last
+volatile _SPM int *buf = (volatile _SPM int *)NOC_SPM_BASE;
+
+volatile _UNCACHED int mode;
+volatile _UNCACHED int seen[CORESET_SIZE];
+volatile _UNCACHED int finished;
+
+noc_tree_t tree;
+coreset_t receivers;
+
+static void slave(void* param) {
+  int id = get_cpuid();
+  int seq = 0;
+  for (int i = 0; i < WORDS; i++) {
+    buf[i] = 0;
+  }
+  seen[id] = -1;
+  while (!finished) {
+    if (buf[WORDS-1] != seq) {
+      seq = buf[WORDS-1];
+      if (mode == MODE_TREE) {
+        noc_tree_forward(&tree, buf, WORDS*sizeof(int), 0);
+      }
+      seen[id] = seq;
+    }
+  }
+  int ret = 0;
+  corethread_exit(&ret);
+}
+
+int main() {
+  int cores = get_cpucnt();
+
+  for (int i = 0; i < WORDS; i++) {
+    buf[i] = 0;
+  }
+  coreset_clearall(&receivers);
+  for (int i = 1; i < cores; i++) {
+    coreset_add(i, &receivers);
+    seen[i] = 0;
+  }
+  coreset_t members = receivers;
+  coreset_add(0, &members);
+  noc_tree_init(&tree, &members, 0, FANOUT);
+
+  for (int i = 1; i < cores; i++) {
+    corethread_create(i, &slave, NULL);
+  }
+  // Wait until the receivers have cleared their buffer
+  for (int i = 1; i < cores; i++) {
+    while (seen[i] != -1) {
+      /* spin */
+    }
+  }
+
+  // The destination address is the same at all receivers
+  volatile void _SPM *dst[CORESET_SIZE];
+  for (int i = 0; i < CORESET_SIZE; i++) {
+    dst[i] = buf;
+  }
+
+  int seq = 0;
+  unsigned long long cycles[MODES];
+  for (int m = 0; m < MODES; m++) {
+    mode = m;
+    cycles[m] = 0;
+    for (int r = 0; r < ROUNDS; r++) {
+      buf[WORDS-1] = ++seq;
+      unsigned long long start = get_cpu_cycles();
+      switch (m) {
+      case MODE_SERIAL:
+        for (int i = 1; i < cores; i++) {
+          noc_write(i, buf, buf, WORDS*sizeof(int), 0);
+          while (!noc_dma_done(i));
+        }
+        break;
+      case MODE_MULTICAST:
+        noc_multicast(&receivers, dst, 0, buf, WORDS*sizeof(int), 0);
+        break;
+      case MODE_TREE:
+        noc_tree_forward(&tree, buf, WORDS*sizeof(int), 0);
+        break;
+      }
+      for (int i = 1; i < cores; i++) {
+        while (seen[i] != seq) {
+          /* spin */
+        }
+      }
+      cycles[m] += get_cpu_cycles() - start;
+    }
+  }
+  finished = 1;
+
+  for (int i = 1; i < cores; i++) {
+    int *ret;
+    corethread_join(i, (void **)&ret);
+  }
+
+  printf("%d bytes to %d cores, cycles per transfer\n", (int)(WORDS*sizeof(int)), cores-1);
+  for (int m = 0; m < MODES; m++) {
+    printf("%10s %10u\n", mode_names[m], (unsigned)(cycles[m] / ROUNDS));
+  }
+  return 0;
+}
@@ -0,0 +1,99 @@
+/*
+  A fixed-point mandelbrot generator on the task runtime of
+  libcorethread, based on mandelbrot_par.c.
+
+  The image is computed once on the master core and once with
+  parallel_for() on all cores. The rows of the image take different
+  times, so the work stealing balances the load.
+
+  Copyright: DTU, BSD License
+*/
+
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libcorethread/task.h"
+
+#define ROWS  48
+#define COLS  64
+#define GRAIN 1
+
+#define FRAC_BITS 16
+#define FRAC_ONE  (1 << FRAC_BITS)
+
+#define XSTART     (2*-FRAC_ONE)
+#define XEND       (FRAC_ONE)
+#define YSTART     (-FRAC_ONE)
+#define YEND       (FRAC_ONE)
+#define XSTEP_SIZE ((XEND-XSTART+COLS-1)/COLS)
+#define YSTEP_SIZE ((YEND-YSTART+ROWS-1)/ROWS)
+
+#define MAX_SQUARE (16*FRAC_ONE)
+#define MAX_ITER   64
+
+int image_seq[ROWS][COLS];
+int image_par[ROWS][COLS];
+
+static int fracmul(int x, int y) {
+  return (long long)x*y >> FRAC_BITS;
+}
+
+static int do_iter(int cx, int cy,
+                   unsigned int max_square, int max_iter) {
+  unsigned int square = 0;
+  int iter = 0;
+  int x = 0;
+  int y = 0;
+  while (square <= max_square && iter < max_iter) {
+    int xt = fracmul(x, x) - fracmul(y, y) + cx;
+    int yt = 2*fracmul(x, y) + cy;
+    x = xt;
+    y = yt;
+    iter++;
+    square = fracmul(x, x) + fracmul(y, y);
+  }
+
+  return iter;
+}
+
+static void rows(int first, int last, void *arg) {
+  int (*image)[COLS] = arg;
+  for (int r = first; r < last; r++) {
+    int y = YSTART + r*YSTEP_SIZE;
+    for (int c = 0; c < COLS; c++) {
+      image[r][c] = do_iter(XSTART + c*XSTEP_SIZE, y, MAX_SQUARE, MAX_ITER);
+    }
+  }
+}
+
+int main() {
+  unsigned long long start, seq, par;
+
+  start = get_cpu_cycles();
+  rows(0, ROWS, image_seq);
+  seq = get_cpu_cycles() - start;
+
+  if (task_init() != 0) {
+    puts("Task runtime not started");
+    return 1;
+  }
+  start = get_cpu_cycles();
+  parallel_for(0, ROWS, GRAIN, &rows, image_par);
+  par = get_cpu_cycles() - start;
+  task_exit();
+
+  int errors = 0;
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      errors += image_seq[r][c] != image_par[r][c];
+    }
+  }
+
+  printf("%dx%d pixels on %d cores\n", COLS, ROWS, get_cpucnt());
+  printf("sequential: %llu cycles\n", seq);
+  printf("parallel:   %llu cycles, speedup %llu.%02llu\n", par,
+         seq / par, (seq * 100 / par) % 100);
+  printf("%d errors\n", errors);
+  return errors != 0;
+}
@@ -0,0 +1,74 @@
+/*
+  Matrix multiplication on the task runtime of libcorethread, based on
+  matrix_mult.c.
+
+  The product is computed once on the master core and once with
+  parallel_for() over the rows of the result on all cores.
+
+  Copyright: DTU, BSD License
+*/
+
+const int NOC_MASTER = 0;
+#include <stdio.h>
+#include <machine/patmos.h>
+#include "libcorethread/corethread.h"
+#include "libcorethread/task.h"
+
+#define N     32
+#define GRAIN 2
+
+int first_matrix[N][N];
+int second_matrix[N][N];
+int result_seq[N][N];
+int result_par[N][N];
+
+static void rows(int first, int last, void *arg) {
+  int (*result)[N] = arg;
+  for (int i = first; i < last; i++) {
+    for (int k = 0; k < N; k++) {
+      int sum = 0;
+      for (int j = 0; j < N; j++) {
+        sum += first_matrix[i][j] * second_matrix[j][k];
+      }
+      result[i][k] = sum;
+    }
+  }
+}
+
+int main() {
+  unsigned long long start, seq, par;
+
+  for (int i = 0; i < N; i++) {
+    for (int j = 0; j < N; j++) {
+      first_matrix[i][j] = i + j;
+      second_matrix[i][j] = i - j;
+    }
+  }
+
+  start = get_cpu_cycles();
+  rows(0, N, result_seq);
+  seq = get_cpu_cycles() - start;
+
+  if (task_init() != 0) {
+    puts("Task runtime not started");
+    return 1;
+  }
+  start = get_cpu_cycles();
+  parallel_for(0, N, GRAIN, &rows, result_par);
+  par = get_cpu_cycles() - start;
+  task_exit();
+
+  int errors = 0;
+  for (int i = 0; i < N; i++) {
+    for (int k = 0; k < N; k++) {
+      errors += result_seq[i][k] != result_par[i][k];
+    }
+  }
+
+  printf("%dx%d matrices on %d cores\n", N, N, get_cpucnt());
+  printf("sequential: %llu cycles\n", seq);
+  printf("parallel:   %llu cycles, speedup %llu.%02llu\n", par,
+         seq / par, (seq * 100 / par) % 100);
+  printf("%d errors\n", errors);
+  return errors != 0;
+}
@@ -47,12 +47,40 @@
 
 struct arp_table_entry{
 	unsigned char used;//0 if empty 
-	unsigned char ip_addr[4];
 	unsigned char mac_addr[6];
+	unsigned int ip;
+	unsigned long long time;//insertion time in microseconds
 };
 
 struct arp_table_entry arp_table[ARP_TABLE_SIZE];
 
+//The IP as a 32-bit key
+static unsigned int arp_ip_key(unsigned char ip_addr[]){
+	return (ip_addr[0] << 24) | (ip_addr[1] << 16) | (ip_addr[2] << 8) | ip_addr[3];
+}
+
+//The first entry to probe for a key (multiplicative hashing)
+static unsigned int arp_hash(unsigned int ip){
+	return (ip * 2654435761u) >> (32 - ARP_TABLE_BITS);
+}
+
+//The index of the entry holding the key, -1 if it is not in the table. Expired entries are freed.
+static int arp_table_find(unsigned int ip, unsigned long long now){
+	unsigned int h = arp_hash(ip);
+	int ans = -1;
+	#pragma loopbound min ARP_TABLE_PROBES max ARP_TABLE_PROBES
+	for (int i=0; i<ARP_TABLE_PROBES; i++){
+		struct arp_table_entry *e = &arp_table[(h + i) & (ARP_TABLE_SIZE-1)];
+		if (e->used == 1 && now - e->time >= ARP_ENTRY_TIMEOUT){
+			e->used = 0;
+		}
+		if (e->used == 1 && e->ip == ip){
+			ans = (h + i) & (ARP_TABLE_SIZE-1);
+		}
+	}
+	return ans;
+}
+
 //This function initilize the ARP table.
 void arp_table_init(){
 	for (int i=0; i<ARP_TABLE_SIZE; i++){
@@ -63,50 +91,47 @@ void arp_table_init(){
 
 //This function searches in the ARP table for the given IP. If it exists it returns 1 and the MAC. If not it returns 0.
 int arp_table_search(unsigned char ip_addr[], unsigned char mac_addr[]){
-	#pragma loopbound min ARP_TABLE_SIZE max ARP_TABLE_SIZE
-	for (int i=0; i<ARP_TABLE_SIZE; i++){
-		if (arp_table[i].used == 1 && arp_table[i].ip_addr[0]==ip_addr[0] && arp_table[i].ip_addr[1]==ip_addr[1] && arp_table[i].ip_addr[2]==ip_addr[2] && arp_table[i].ip_addr[3]==ip_addr[3]){
-			for(int j=0; j<6; j++){
-				mac_addr[j] = arp_table[i].mac_addr[j];			
-			}
-			return 1;
-		}
+	int i = arp_table_find(arp_ip_key(ip_addr), get_cpu_usecs());
+	if (i < 0){
+		return 0;
 	}
-	return 0;
+	#pragma loopbound min 6 max 6
+	for(int j=0; j<6; j++){
+		mac_addr[j] = arp_table[i].mac_addr[j];
+	}
+	return 1;
 }
 
 //This function remove ARP table entries for the given IP. If something is removed it returns 1. If not it returns 0.
 int arp_table_delete_entry(unsigned char ip_addr[]){
-	int ans = 0;	
-	#pragma loopbound min ARP_TABLE_SIZE max ARP_TABLE_SIZE
-	for (int i=0; i<ARP_TABLE_SIZE; i++){
-		if (arp_table[i].used == 1 && arp_table[i].ip_addr[0]==ip_addr[0] && arp_table[i].ip_addr[1]==ip_addr[1] && arp_table[i].ip_addr[2]==ip_addr[2] && arp_table[i].ip_addr[3]==ip_addr[3]){
-			arp_table[i].used=0;
-			ans = 1;
-		}
+	int i = arp_table_find(arp_ip_key(ip_addr), get_cpu_usecs());
+	if (i < 0){
+		return 0;
 	}
-	return ans;
+	arp_table[i].used = 0;
+	return 1;
 }
 
-//This function insert a new entry in the ARP IP/MAC table. If an entry was already there the fields are updated. If we are out of space, the first entry is replaced.
+//This function insert a new entry in the ARP IP/MAC table. If an entry was already there the fields are updated. If we are out of space, the oldest entry among the probed ones is replaced.
 void arp_table_new_entry(unsigned char ip_addr[], unsigned char mac_addr[]){
-	unsigned char previous_mac[6];
-	int i = 0;
-	if(arp_table_search(ip_addr, previous_mac) == 1){
-		arp_table_delete_entry(ip_addr);
-	}
-	#pragma loopbound min 1 max ARP_TABLE_SIZE
-	while(arp_table[i].used == 1 && i<ARP_TABLE_SIZE){
-		i++;
-	}
-	if (i == ARP_TABLE_SIZE){
-		i = 0;//table is full
+	unsigned int ip = arp_ip_key(ip_addr);
+	unsigned long long now = get_cpu_usecs();
+	int i = arp_table_find(ip, now);
+	if (i < 0){
+		//Take a free entry, or the oldest one
+		unsigned int h = arp_hash(ip);
+		i = h;
+		#pragma loopbound min ARP_TABLE_PROBES max ARP_TABLE_PROBES
+		for (int k=0; k<ARP_TABLE_PROBES; k++){
+			int j = (h + k) & (ARP_TABLE_SIZE-1);
+			if (arp_table[i].used == 1 && (arp_table[j].used == 0 || arp_table[j].time < arp_table[i].time)){
+				i = j;
+			}
+		}
 	}
 	arp_table[i].used = 1;
-	#pragma loopbound min 4 max 4
-	for(int j=0; j<4; j++){
-		arp_table[i].ip_addr[j] = ip_addr[j];
-	}
+	arp_table[i].ip = ip;
+	arp_table[i].time = now;
 	#pragma loopbound min 6 max 6
 	for(int j=0; j<6; j++){
 		arp_table[i].mac_addr[j] = mac_addr[j];
@@ -117,10 +142,13 @@ void arp_table_new_entry(unsigned char ip_addr[], unsigned char mac_addr[]){
 
 //This ugly function prints the ARP table for debug purposes.
 void arp_table_print(){
-	printf("ARP IP/MAC table\n#\tUsed\tIP\t\tMAC\n");
+	unsigned long long now = get_cpu_usecs();
+	printf("ARP IP/MAC table\n#\tUsed\tIP\t\tMAC\t\t\tAge (s)\n");
 	for (int i=0; i<ARP_TABLE_SIZE; i++){
-		printf("%d\t%d\t%d.%d.%d.%d\t", i, arp_table[i].used, arp_table[i].ip_addr[0], arp_table[i].ip_addr[1], arp_table[i].ip_addr[2], arp_table[i].ip_addr[3]);
-		printf("%02X:%02X:%02X:%02X:%02X:%02X\n", arp_table[i].mac_addr[0], arp_table[i].mac_addr[1], arp_table[i].mac_addr[2], arp_table[i].mac_addr[3], arp_table[i].mac_addr[4], arp_table[i].mac_addr[5]);
+		unsigned int ip = arp_table[i].ip;
+		printf("%d\t%d\t%d.%d.%d.%d\t", i, arp_table[i].used, ip >> 24, (ip >> 16) & 0xFF, (ip >> 8) & 0xFF, ip & 0xFF);
+		printf("%02X:%02X:%02X:%02X:%02X:%02X\t", arp_table[i].mac_addr[0], arp_table[i].mac_addr[1], arp_table[i].mac_addr[2], arp_table[i].mac_addr[3], arp_table[i].mac_addr[4], arp_table[i].mac_addr[5]);
+		printf("%llu\n", arp_table[i].used ? (now - arp_table[i].time) / 1000000 : 0);
 	}
 	return;
 }
@@ -179,9 +207,7 @@ unsigned int arp_build_reply(unsigned int rx_addr, unsigned int tx_addr){
 	
 	//Copy the entire frame	
 	if (rx_addr != tx_addr ){ 
-		for(int i=0; i<frame_length; i++){
-			mem_iowr_byte(tx_addr + i, mem_iord_byte(rx_addr + i));
-		}
+		mem_copy(tx_addr, rx_addr, frame_length);
 	}
 	//Swap MAC addrs in ethernet header
 	for (int i=0; i<6; i++){
@@ -49,7 +49,17 @@
 #include "mac.h"
 #include "eth_mac_driver.h"
 
-#define ARP_TABLE_SIZE 8
+//The ARP table is a hash table of ARP_TABLE_SIZE entries (a power of two).
+//Each IP is stored in one of ARP_TABLE_PROBES consecutive entries after its
+//hash, so all table operations take a bounded time.
+#define ARP_TABLE_BITS 5
+#define ARP_TABLE_SIZE (1 << ARP_TABLE_BITS)
+#define ARP_TABLE_PROBES 4
+
+//Entries expire this many microseconds after they were inserted.
+#ifndef ARP_ENTRY_TIMEOUT
+#define ARP_ENTRY_TIMEOUT 60000000ULL
+#endif
 
 ///////////////////////////////////////////////////////////////
 //Functions related to the ARP table
@@ -64,7 +74,7 @@ int arp_table_search(unsigned char ip_addr[], unsigned char mac_addr[]);
 //This function remove ARP table entries for the given IP. If something is removed it returns 1. If not it returns 0.
 int arp_table_delete_entry(unsigned char ip_addr[]);
 
-//This function insert a new entry in the ARP IP/MAC table. If an entry was already there the fields are updated. If we are out of space, the first entry is replaced.
+//This function insert a new entry in the ARP IP/MAC table. If an entry was already there the fields are updated. If we are out of space, the oldest entry among the probed ones is replaced.
 void arp_table_new_entry(unsigned char ip_addr[], unsigned char mac_addr[]);
 
 //This ugly function prints the ARP table for debug purposes.
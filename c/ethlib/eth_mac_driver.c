@@ -48,11 +48,9 @@
 //This function sends an ethernet frame located at tx_addr and of length frame_length.
 void eth_mac_send(unsigned int tx_addr, unsigned int frame_length){
     unsigned char done = 0;
-    unsigned char free = 1; 
     //Wait until buffer is free 
     _Pragma("loopbound min 0 max 1")
-	while (free==1){
-         free = (eth_iord(TX_BD_ADDR_BASE) & 0x8000);
+	while (!eth_mac_tx_idle()){
     };
     eth_iowr(INT_SOURCE_ADDR, 0x00000001);
 	eth_iowr(TX_BD_ADDR_BASE+4, tx_addr);
@@ -67,17 +65,22 @@ return;
 
 //This function sends an ethernet frame located at tx_addr and of length frame_length (NON-BLOCKING call).
 unsigned eth_mac_send_nb(unsigned int tx_addr, unsigned int frame_length){
-    if((eth_iord(TX_BD_ADDR_BASE) & TX_BD_READY_BIT)==1){
+    if(!eth_mac_tx_idle()){
         return 0;
     } else {
 	    eth_iowr((TX_BD_ADDR_BASE+4), tx_addr);
-	    eth_iowr(TX_BD_ADDR_BASE, ((frame_length<<16)|(0xF000)));
 	    eth_iowr(INT_SOURCE_ADDR, INT_SOURCE_TXB_BIT);
-	    eth_iowr(TX_BD_ADDR_BASE, TX_BD_READY_BIT | TX_BD_IRQEN_BIT | TX_BD_WRAP_BIT | TX_BD_PAD_EN_BIT);
+	    //The length and the ready bit go in one write, the MAC may start sending right away
+	    eth_iowr(TX_BD_ADDR_BASE, (frame_length<<16) | TX_BD_READY_BIT | TX_BD_IRQEN_BIT | TX_BD_WRAP_BIT | TX_BD_PAD_EN_BIT);
     }
     return 1;
 }
 
+//This function checks if the transmit buffer descriptor is free, i.e. the last frame was sent.
+unsigned eth_mac_tx_idle(void){
+    return (eth_iord(TX_BD_ADDR_BASE) & TX_BD_READY_BIT) == 0;
+}
+
 //This function receive an ethernet frame and put it in rx_addr.
 unsigned eth_mac_receive(unsigned int rx_addr, unsigned long long int timeout){
     eth_iowr(RX_BD_ADDR_BASE(eth_iord(TX_BD_NUM_ADDR))+4, rx_addr);
@@ -156,6 +159,133 @@ void eth_mac_initialize(){
 	return;
 }
 
+///////////////////////////////////////////////////////////////
+//Descriptor rings
+///////////////////////////////////////////////////////////////
+
+#define RX_BD_ERROR_BITS (RX_BD_OR_BIT | RX_BD_IS_BIT | RX_BD_DN_BIT | RX_BD_TL_BIT | \
+                          RX_BD_SF_BIT | RX_BD_CRCERR_BIT | RX_BD_LC_BIT)
+
+//Ring state, the indices count descriptors from the start of each ring
+static unsigned tx_ring_num;
+static unsigned tx_head;    //next descriptor to fill
+static unsigned tx_tail;    //oldest descriptor not reaped
+static unsigned tx_pending;
+static unsigned rx_ring_num;
+static unsigned rx_head;    //next descriptor to check for a frame
+static unsigned rx_tail;    //oldest descriptor not released
+static unsigned rx_pending;
+static unsigned rx_error_cnt;
+
+static unsigned tx_bd_addr(unsigned i){
+    return TX_BD_ADDR_BASE + i * 8;
+}
+
+static unsigned rx_bd_addr(unsigned i){
+    return RX_BD_ADDR_BASE(tx_ring_num) + i * 8;
+}
+
+static unsigned rx_bd_empty(unsigned i){
+    return RX_BD_EMPTY_BIT | RX_BD_IRQEN_BIT | (i == rx_ring_num-1 ? RX_BD_WRAP_BIT : 0);
+}
+
+//This function sets up tx_num TX and rx_num RX descriptors as rings.
+int eth_mac_ring_init(unsigned int rx_buff_addr, unsigned int tx_num, unsigned int rx_num){
+    if (tx_num == 0 || rx_num == 0 || tx_num + rx_num > ETH_MAC_BD_NUM ||
+        rx_buff_addr + rx_num * ETH_MAC_FRAME_SIZE > ETH_MAC_BUFF_END){
+        return 0;
+    }
+    unsigned moder = eth_iord(MODER_ADDR);
+    eth_iowr(MODER_ADDR, moder & ~(TXEN_BIT | RXEN_BIT));
+
+    tx_ring_num = tx_num;
+    rx_ring_num = rx_num;
+    tx_head = tx_tail = tx_pending = 0;
+    rx_head = rx_tail = rx_pending = 0;
+    rx_error_cnt = 0;
+    eth_iowr(TX_BD_NUM_ADDR, tx_num);
+    _Pragma("loopbound min 1 max 127")
+    for (unsigned i = 0; i < tx_num; i++){
+        eth_iowr(tx_bd_addr(i), i == tx_num-1 ? TX_BD_WRAP_BIT : 0);
+    }
+    _Pragma("loopbound min 1 max 127")
+    for (unsigned i = 0; i < rx_num; i++){
+        eth_iowr(rx_bd_addr(i)+4, rx_buff_addr + i * ETH_MAC_FRAME_SIZE);
+        eth_iowr(rx_bd_addr(i), rx_bd_empty(i));
+    }
+    eth_iowr(INT_SOURCE_ADDR, INT_SOURCE_RXB_BIT | INT_SOURCE_RXE_BIT |
+                              INT_SOURCE_TXB_BIT | INT_SOURCE_TXE_BIT | INT_SOURCE_BUSY_BIT);
+
+    eth_iowr(MODER_ADDR, moder | TXEN_BIT | RXEN_BIT);
+    return 1;
+}
+
+//This function queues up to n frames (NON-BLOCKING call).
+unsigned eth_mac_tx_burst(const unsigned int tx_addr[], const unsigned int frame_length[], unsigned n){
+    unsigned i;
+    _Pragma("loopbound min 0 max 127")
+    for (i = 0; i < n && tx_pending < tx_ring_num; i++){
+        unsigned wrap = tx_head == tx_ring_num-1 ? TX_BD_WRAP_BIT : 0;
+        eth_iowr(tx_bd_addr(tx_head)+4, tx_addr[i]);
+        eth_iowr(tx_bd_addr(tx_head), (frame_length[i]<<16) | TX_BD_READY_BIT |
+                                      TX_BD_IRQEN_BIT | TX_BD_PAD_EN_BIT | wrap);
+        tx_head = wrap ? 0 : tx_head+1;
+        tx_pending++;
+    }
+    return i;
+}
+
+//This function frees the descriptors of sent frames.
+unsigned eth_mac_tx_reap(){
+    unsigned cnt = 0;
+    eth_iowr(INT_SOURCE_ADDR, INT_SOURCE_TXB_BIT | INT_SOURCE_TXE_BIT);
+    _Pragma("loopbound min 0 max 127")
+    while (tx_pending > 0 && (eth_iord(tx_bd_addr(tx_tail)) & TX_BD_READY_BIT) == 0){
+        tx_tail = tx_tail == tx_ring_num-1 ? 0 : tx_tail+1;
+        tx_pending--;
+        cnt++;
+    }
+    return cnt;
+}
+
+//This function returns up to max received frames without copying them.
+unsigned eth_mac_rx_burst(unsigned int rx_addr[], unsigned int frame_length[], unsigned max){
+    unsigned i;
+    eth_iowr(INT_SOURCE_ADDR, INT_SOURCE_RXB_BIT | INT_SOURCE_RXE_BIT | INT_SOURCE_BUSY_BIT);
+    _Pragma("loopbound min 0 max 127")
+    for (i = 0; i < max && rx_pending < rx_ring_num; i++){
+        unsigned bd = eth_iord(rx_bd_addr(rx_head));
+        if (bd & RX_BD_EMPTY_BIT){
+            break;
+        }
+        rx_addr[i] = eth_iord(rx_bd_addr(rx_head)+4);
+        if (bd & RX_BD_ERROR_BITS){
+            frame_length[i] = 0;
+            rx_error_cnt++;
+        } else {
+            frame_length[i] = bd >> 16;
+        }
+        rx_head = rx_head == rx_ring_num-1 ? 0 : rx_head+1;
+        rx_pending++;
+    }
+    return i;
+}
+
+//This function gives the n oldest received frames back to the EthMac.
+void eth_mac_rx_release(unsigned n){
+    _Pragma("loopbound min 0 max 127")
+    for (; n > 0 && rx_pending > 0; n--){
+        eth_iowr(rx_bd_addr(rx_tail), rx_bd_empty(rx_tail));
+        rx_tail = rx_tail == rx_ring_num-1 ? 0 : rx_tail+1;
+        rx_pending--;
+    }
+}
+
+//This function returns the number of received frames with errors.
+unsigned eth_mac_rx_errors(){
+    return rx_error_cnt;
+}
+
 ///////////////////////////////////////////////////////////////
 //Regs accessing
 ///////////////////////////////////////////////////////////////
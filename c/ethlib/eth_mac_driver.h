@@ -145,6 +145,9 @@ void eth_mac_send(unsigned int tx_addr, unsigned int frame_length);
 //This function sends an ethernet frame located at tx_addr and of length frame_length (NON-BLOCKING call).
 unsigned eth_mac_send_nb(unsigned int tx_addr, unsigned int frame_length);
 
+//This function checks if the transmit buffer descriptor is free, i.e. the last frame was sent.
+unsigned eth_mac_tx_idle(void);
+
 //This function receive an ethernet frame and put it in rx_addr by clear the buffer.
 unsigned eth_mac_receive(unsigned int rx_addr, unsigned long long int timeout);
 
@@ -163,6 +166,45 @@ void eth_mac_clear_rx_buffer(unsigned int rx_buff, unsigned int rx_bd);
 //This function initilize the ethernet controller (only for the demo).
 void eth_mac_initialize();
 
+///////////////////////////////////////////////////////////////
+//Descriptor rings
+///////////////////////////////////////////////////////////////
+
+//The EthMac has 128 buffer descriptors, shared by TX (first) and RX.
+#define ETH_MAC_BD_NUM      128
+//Size of the buffer of one RX descriptor, enough for a full frame.
+#define ETH_MAC_FRAME_SIZE  0x800
+//End of the buffer memory, the registers start here.
+#define ETH_MAC_BUFF_END    0xF000
+
+//This function sets up tx_num TX and rx_num RX descriptors as rings and
+//enables RX and TX. The RX buffers are placed one after another from
+//rx_buff_addr. Returns 0 if the descriptors or buffers do not fit, 1
+//otherwise. Do not mix the ring calls with the single descriptor calls above.
+int eth_mac_ring_init(unsigned int rx_buff_addr, unsigned int tx_num, unsigned int rx_num);
+
+//This function queues up to n frames located at tx_addr[i] and of length
+//frame_length[i] (NON-BLOCKING call). Returns the number of frames queued.
+//A frame buffer may be reused when eth_mac_tx_reap() has counted it.
+unsigned eth_mac_tx_burst(const unsigned int tx_addr[], const unsigned int frame_length[], unsigned n);
+
+//This function frees the descriptors of sent frames, oldest first, and
+//returns their number.
+unsigned eth_mac_tx_reap(void);
+
+//This function returns up to max received frames without copying them:
+//the buffer address in rx_addr[i] and the length in frame_length[i]
+//(NON-BLOCKING call). Frames with errors have a length of 0. The buffers
+//stay valid until released with eth_mac_rx_release().
+unsigned eth_mac_rx_burst(unsigned int rx_addr[], unsigned int frame_length[], unsigned max);
+
+//This function gives the n oldest frames returned by eth_mac_rx_burst()
+//back to the EthMac.
+void eth_mac_rx_release(unsigned n);
+
+//This function returns the number of received frames with errors.
+unsigned eth_mac_rx_errors();
+
 ///////////////////////////////////////////////////////////////
 //Regs accessing
 ///////////////////////////////////////////////////////////////
@@ -82,6 +82,108 @@ unsigned mem_iord_byte(unsigned addr) {
     return (full_data & mask) >> shift_factor;
 }
 
+// Copy length bytes from data into the rx-tx buffer at addr, word-wise
+void mem_iowr_bytes(unsigned addr, const unsigned char data[], unsigned length) {
+    unsigned i = 0;
+    _Pragma("loopbound min 0 max 3")
+    for (; i < length && ((addr + i) & 0x03) != 0; i++) {
+        mem_iowr_byte(addr + i, data[i]);
+    }
+    _Pragma("loopbound min 0 max 375")
+    for (; i + 4 <= length; i += 4) {
+        *(BUFF_BASE+((addr+i)>>2)) = (data[i] << 24) | (data[i+1] << 16) | (data[i+2] << 8) | data[i+3];
+    }
+    _Pragma("loopbound min 0 max 3")
+    for (; i < length; i++) {
+        mem_iowr_byte(addr + i, data[i]);
+    }
+    return;
+}
+
+// Copy length bytes from the rx-tx buffer at addr into data, word-wise
+void mem_iord_bytes(unsigned addr, unsigned char data[], unsigned length) {
+    unsigned i = 0;
+    _Pragma("loopbound min 0 max 3")
+    for (; i < length && ((addr + i) & 0x03) != 0; i++) {
+        data[i] = mem_iord_byte(addr + i);
+    }
+    _Pragma("loopbound min 0 max 375")
+    for (; i + 4 <= length; i += 4) {
+        unsigned word = *(BUFF_BASE+((addr+i)>>2));
+        data[i] = word >> 24;
+        data[i+1] = word >> 16;
+        data[i+2] = word >> 8;
+        data[i+3] = word;
+    }
+    _Pragma("loopbound min 0 max 3")
+    for (; i < length; i++) {
+        data[i] = mem_iord_byte(addr + i);
+    }
+    return;
+}
+
+// Copy length bytes inside the rx-tx buffer
+void mem_copy(unsigned dst, unsigned src, unsigned length) {
+    unsigned i = 0;
+    if (((dst ^ src) & 0x03) == 0) {
+        _Pragma("loopbound min 0 max 3")
+        for (; i < length && ((src + i) & 0x03) != 0; i++) {
+            mem_iowr_byte(dst + i, mem_iord_byte(src + i));
+        }
+        _Pragma("loopbound min 0 max 375")
+        for (; i + 4 <= length; i += 4) {
+            *(BUFF_BASE+((dst+i)>>2)) = *(BUFF_BASE+((src+i)>>2));
+        }
+    }
+    _Pragma("loopbound min 0 max 1500")
+    for (; i < length; i++) {
+        mem_iowr_byte(dst + i, mem_iord_byte(src + i));
+    }
+    return;
+}
+
+// Add a value to a 32-bit one's complement sum (end-around carry)
+unsigned eth_checksum_add(unsigned sum, unsigned value) {
+    sum += value;
+    return sum + (sum < value);
+}
+
+// Add length bytes of the rx-tx buffer at addr (even) to a one's complement sum.
+// Halfwords may be added in either half of the 32-bit sum, as 2^16 is 1
+// modulo 0xFFFF.
+unsigned eth_checksum_mem(unsigned sum, unsigned addr, unsigned length) {
+    // Keep the loop within its bound for bad lengths from the network
+    if (length > ETH_CHECKSUM_MAX) {
+        length = ETH_CHECKSUM_MAX;
+    }
+    if ((addr & 0x02) != 0 && length >= 2) {
+        sum = eth_checksum_add(sum, *(BUFF_BASE+(addr>>2)) & 0xFFFF);
+        addr += 2;
+        length -= 2;
+    }
+    _Pragma("loopbound min 0 max 375")
+    for (; length >= 4; length -= 4) {
+        sum = eth_checksum_add(sum, *(BUFF_BASE+(addr>>2)));
+        addr += 4;
+    }
+    if (length >= 2) {
+        sum = eth_checksum_add(sum, *(BUFF_BASE+(addr>>2)) >> 16);
+        addr += 2;
+        length -= 2;
+    }
+    if (length == 1) {
+        sum = eth_checksum_add(sum, mem_iord_byte(addr) << 8);
+    }
+    return sum;
+}
+
+// Fold a 32-bit one's complement sum to the 16-bit Internet checksum
+unsigned short eth_checksum_finish(unsigned sum) {
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (unsigned short)(~sum & 0xFFFF);
+}
+
 // Similar functions for second ethernet controller (when present)
 // Write to ethernet controller
 void eth_iowr1(unsigned addr,unsigned data) {
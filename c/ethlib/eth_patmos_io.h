@@ -92,6 +92,28 @@ unsigned mem_iord(int addr);
 // Write a byte in rx-tx buffer
 unsigned mem_iord_byte(unsigned addr);// __attribute__((noinline));
 
+// Copy length bytes from data into the rx-tx buffer at addr, word-wise
+void mem_iowr_bytes(unsigned addr, const unsigned char data[], unsigned length);
+
+// Copy length bytes from the rx-tx buffer at addr into data, word-wise
+void mem_iord_bytes(unsigned addr, unsigned char data[], unsigned length);
+
+// Copy length bytes inside the rx-tx buffer, word-wise if src and dst are
+// equally aligned
+void mem_copy(unsigned dst, unsigned src, unsigned length);
+
+// Add a value to a 32-bit one's complement sum
+unsigned eth_checksum_add(unsigned sum, unsigned value);
+
+// Add length bytes of the rx-tx buffer at addr (even) to a 32-bit one's
+// complement sum. An odd last byte is padded with zero. At most
+// ETH_CHECKSUM_MAX bytes are added, longer lengths are cut.
+#define ETH_CHECKSUM_MAX 1500
+unsigned eth_checksum_mem(unsigned sum, unsigned addr, unsigned length);
+
+// Fold a 32-bit one's complement sum to the 16-bit Internet checksum
+unsigned short eth_checksum_finish(unsigned sum);
+
 // Write to ethernet controller
 void eth_iowr1(unsigned addr,unsigned data);
 
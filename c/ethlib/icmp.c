@@ -71,10 +71,7 @@ unsigned int icmp_build_ping_reply(unsigned int rx_addr, unsigned int tx_addr){
 	
 	//Copy the entire frame	
 	if (rx_addr != tx_addr ){
-		#pragma loopbound min 98 max 98 
-		for(int i=0; i<frame_length; i++){
-			mem_iowr_byte(tx_addr + i, mem_iord_byte(rx_addr + i));
-		}
+		mem_copy(tx_addr, rx_addr, frame_length);
 	} 
 	//Swap MAC addrs
 	#pragma loopbound min 6 max 6
@@ -149,37 +149,15 @@ void ipv4_set_my_ip(unsigned char new_ip[]){
 //This function compute and returns the IP header checksum. The function ignore the field checksum.
 unsigned short int ipv4_compute_checksum(unsigned int pkt_addr){
 	unsigned int checksum;
-	checksum = 0;
-	_Pragma("loopbound min 0 max 10")
-	for (int i = 0; i<20; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 14 + i) << 8) + (mem_iord_byte(pkt_addr + 15 + i) & 0xFF);
-	}
-	checksum = checksum - (mem_iord_byte(pkt_addr + 24) << 8) + (mem_iord_byte(pkt_addr + 25) & 0xFF);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	checksum = ((~checksum) & 0xFFFF);
-	return (unsigned short int) checksum;		
+	checksum = eth_checksum_mem(0, pkt_addr + 14, 10);
+	checksum = eth_checksum_mem(checksum, pkt_addr + 26, 8);
+	return eth_checksum_finish(checksum);
 }
 
 //This function verify the IP header checksum. If the checksum is correct it returns 1, otherwise it returns 0.
 int ipv4_verify_checksum(unsigned int pkt_addr){
 	unsigned int checksum;
-	checksum = 0;
-	_Pragma("loopbound min 0 max 10")
-	for (int i = 0; i<20; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 14 + i) << 8) + (mem_iord_byte(pkt_addr + 15 + i) & 0xFF);
-	}
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	checksum = ((~checksum) & 0xFFFF);
+	checksum = eth_checksum_finish(eth_checksum_mem(0, pkt_addr + 14, 20));
 	if (checksum == 0){
 		return 1;
 	}else{
@@ -98,20 +98,70 @@ unsigned short tcp_get_data_length(unsigned int pkt_addr){
 //This function gets the data field of an TCP packet.
 __attribute__((noinline))
 unsigned int tcp_get_data(unsigned int pkt_addr, unsigned char* data, unsigned int data_length){
-	int i = 0;
-	_Pragma("loopbound min 0 max 64")
-	for (i = 0; i<tcp_get_data_length(pkt_addr); i++){
-		data[i] = mem_iord_byte(pkt_addr + 34 + tcp_get_header_length(pkt_addr) + i);
-	}
-	return i;
+	unsigned int length = tcp_get_data_length(pkt_addr);
+	mem_iord_bytes(pkt_addr + 34 + tcp_get_header_length(pkt_addr), data, length);
+	return length;
+}
+
+//This function gets the window field of an TCP packet.
+unsigned short tcp_get_window(unsigned int pkt_addr){
+	return (mem_iord(pkt_addr+48) >> 16);
 }
 
+//This function gets the MSS option of an TCP packet, or the default MSS if there is none.
 __attribute__((noinline))
-int tcp_send(tcp_connection *conn, unsigned short flags, unsigned char data[], unsigned short data_length){
-	unsigned short int tcp_length = data_length + 20;
+unsigned short tcp_get_mss(unsigned int pkt_addr){
+	unsigned int addr = pkt_addr + 54;
+	unsigned int end = pkt_addr + 34 + tcp_get_header_length(pkt_addr);
+	_Pragma("loopbound min 0 max 40")
+	while(addr < end){
+		unsigned char kind = mem_iord_byte(addr);
+		if(kind == 0){
+			break;
+		} else if(kind == 1){
+			addr++;
+			continue;
+		}
+		unsigned char length = mem_iord_byte(addr+1);
+		if(length < 2){
+			break;
+		}
+		if(kind == 2 && length == 4){
+			unsigned short mss = (mem_iord_byte(addr+2) << 8) + mem_iord_byte(addr+3);
+			//An MSS of 0 would make tcp_output send empty segments, treat it as no option
+			if(mss != 0){
+				return mss;
+			}
+			break;
+		}
+		addr += length;
+	}
+	return TCP_DEFAULT_MSS;
+}
+
+//The window advertised to the peer, the free space of the receive ring
+static unsigned short tcp_rcv_window(tcp_connection *conn){
+	if(conn->rcv_buf == NULL){
+		return 0x7210;
+	}
+	unsigned int window = conn->rcv_size - conn->rcv_len;
+	return window > 0xFFFF ? 0xFFFF : window;
+}
+
+//Frames are sent non-blocking, so the tx buffer may still hold the previous frame.
+static void tcp_wait_tx(void){
+	_Pragma("loopbound min 0 max 1")
+	while(!eth_mac_tx_idle()){
+	}
+}
+
+//Writes the headers of a segment with sequence number seq to the tx buffer and returns the TCP header length. SYN segments carry the MSS option.
+static unsigned short tcp_write_header(tcp_connection *conn, unsigned short flags, unsigned int seq, unsigned short data_length){
+	unsigned short int hdr_length = (flags & SYN) ? 24 : 20;
+	unsigned short int tcp_length = data_length + hdr_length;
 	unsigned short int ip_length = tcp_length + 20;
-	unsigned short int frame_length = ip_length + 14;
 
+	tcp_wait_tx();
 	//MAC addrs
 	mem_iowr(conn->eth_tx_addr, (conn->dstMAC[0] << 24) | (conn->dstMAC[1] << 16) | (conn->dstMAC[2] << 8) | conn->dstMAC[3]);
 	mem_iowr(conn->eth_tx_addr + 4, (conn->dstMAC[4] << 24) | (conn->dstMAC[5] << 16) | (conn->srcMAC[0] << 8) | conn->srcMAC[1]);
@@ -126,18 +176,25 @@ int tcp_send(tcp_connection *conn, unsigned short flags, unsigned char data[], u
 	mem_iowr(conn->eth_tx_addr + 24, (conn->srcIP[0] << 8) | conn->srcIP[1]);
 	mem_iowr(conn->eth_tx_addr + 28, (conn->srcIP[2] << 24) | (conn->srcIP[3] << 16) | (conn->dstIP[0] << 8) | conn->dstIP[1]);
 	mem_iowr(conn->eth_tx_addr + 32, (conn->dstIP[2] << 24) | (conn->dstIP[3] << 16) | conn->srcport);
-	mem_iowr(conn->eth_tx_addr + 36, (conn->dstport << 16) | (conn->seqNum >> 24) << 8 | ((conn->seqNum >> 16) & 0xFF));
-	mem_iowr(conn->eth_tx_addr + 40, ((conn->seqNum >> 8) & 0xFF) << 24 | (conn->seqNum & 0xFF) << 16 | (conn->ackNum >> 24) << 8 | ((conn->ackNum >> 16) & 0xFF));
-	mem_iowr(conn->eth_tx_addr + 44, ((conn->ackNum >> 8) & 0xFF) << 24 | (conn->ackNum & 0xFF) << 16 | ((tcp_length-data_length) << 2) << 8 | ((unsigned char)flags & 0xFF));
+	mem_iowr(conn->eth_tx_addr + 36, (conn->dstport << 16) | (seq >> 24) << 8 | ((seq >> 16) & 0xFF));
+	mem_iowr(conn->eth_tx_addr + 40, ((seq >> 8) & 0xFF) << 24 | (seq & 0xFF) << 16 | (conn->ackNum >> 24) << 8 | ((conn->ackNum >> 16) & 0xFF));
+	mem_iowr(conn->eth_tx_addr + 44, ((conn->ackNum >> 8) & 0xFF) << 24 | (conn->ackNum & 0xFF) << 16 | (hdr_length << 2) << 8 | ((unsigned char)flags & 0xFF));
 	//TCP Window size + Checksum 
-	mem_iowr(conn->eth_tx_addr + 48, 0x72 << 24 | 0x10 << 16 | 0x0000);
-	//TCP Urgent pointer + data[0,1]
-	mem_iowr(conn->eth_tx_addr + 52, 0x0000);
-	//TCP Data
-	_Pragma("loopbound min 0 max 30")
-	for (int i=0; i<data_length; i++){
-		mem_iowr_byte(conn->eth_tx_addr + 54 + i, data[i]);
+	mem_iowr(conn->eth_tx_addr + 48, tcp_rcv_window(conn) << 16);
+	if(flags & SYN){
+		//TCP Urgent pointer + MSS option
+		mem_iowr(conn->eth_tx_addr + 52, 0x00000204);
+		mem_iowr(conn->eth_tx_addr + 56, TCP_MSS << 16);
+	} else {
+		//TCP Urgent pointer + data[0,1]
+		mem_iowr(conn->eth_tx_addr + 52, 0x0000);
 	}
+	return hdr_length;
+}
+
+//Computes the checksums of the segment in the tx buffer and returns its frame length.
+static unsigned int tcp_finish_segment(tcp_connection *conn, unsigned short hdr_length, unsigned short data_length){
+	unsigned short int tcp_length = data_length + hdr_length;
 	//IPv4 checksum
 	unsigned short int checksum = ipv4_compute_checksum(conn->eth_tx_addr);
 	mem_iowr_byte(conn->eth_tx_addr + 24, (checksum >> 8));
@@ -146,62 +203,73 @@ int tcp_send(tcp_connection *conn, unsigned short flags, unsigned char data[], u
 	checksum = tcp_compute_checksum(conn->eth_tx_addr, tcp_length, data_length);
 	mem_iowr_byte(conn->eth_tx_addr + 50, (checksum >> 8));
 	mem_iowr_byte(conn->eth_tx_addr + 51, (checksum & 0xFF));
+	return tcp_length + 34;
+}
+
+__attribute__((noinline))
+int tcp_send(tcp_connection *conn, unsigned short flags, unsigned char data[], unsigned short data_length){
+	unsigned short hdr_length = tcp_write_header(conn, flags, conn->seqNum, data_length);
+	//TCP Data
+	mem_iowr_bytes(conn->eth_tx_addr + 34 + hdr_length, data, data_length);
 	//Ethernet send
-	return eth_mac_send_nb(conn->eth_tx_addr, frame_length);
+	return eth_mac_send_nb(conn->eth_tx_addr, tcp_finish_segment(conn, hdr_length, data_length));
+}
+
+//Sends length bytes of the send ring starting at sequence number seq
+static void tcp_send_segment(tcp_connection *conn, unsigned short flags, unsigned int seq, unsigned int length){
+	unsigned int offset = (conn->snd_head + (seq - conn->snd_una)) % conn->snd_size;
+	unsigned int first = conn->snd_size - offset;
+	unsigned short hdr_length = tcp_write_header(conn, flags, seq, length);
+	unsigned int data_addr = conn->eth_tx_addr + 34 + hdr_length;
+	if(first >= length){
+		mem_iowr_bytes(data_addr, conn->snd_buf + offset, length);
+	} else {
+		mem_iowr_bytes(data_addr, conn->snd_buf + offset, first);
+		mem_iowr_bytes(data_addr + first, conn->snd_buf, length - first);
+	}
+	eth_mac_send_nb(conn->eth_tx_addr, tcp_finish_segment(conn, hdr_length, length));
 }
 
 __attribute__((noinline))
 unsigned short tcp_compute_checksum(unsigned int pkt_addr, unsigned short tcp_length, unsigned short data_length){
-	unsigned checksum = 0;
-	unsigned short hex = 0; 
-	unsigned short corrected_length = 0;
-	unsigned i = 0;
-	//Length alignment
-	if ((tcp_length & 0x1) == 0){
-		//even
-		corrected_length = tcp_length;
-	}else{
-		//odd
-		corrected_length = tcp_length + 1;
-		mem_iowr_byte(pkt_addr + 34 + tcp_length , 0x00);
-	}
+	unsigned checksum;
 	//Pseudo IP Header
-	_Pragma("loopbound min 0 max 2")
-	for (i=0; i<4; i+=2){
-		hex = (mem_iord_byte(pkt_addr + 26 + i) << 8) + mem_iord_byte(pkt_addr + 26 + i + 1);
-		checksum += hex;
-	}
-	_Pragma("loopbound min 0 max 2")
-	for (i=0; i<4; i+=2){
-		hex = (mem_iord_byte(pkt_addr + 30 + i) << 8) + mem_iord_byte(pkt_addr + 30 + i + 1);
-		checksum += hex;
-	}
-	checksum += 0x0006;
-	checksum += (tcp_length);
-	//TCP Header
-	_Pragma("loopbound min 12 max 14")
-	for (i=0; i<corrected_length; i+=2){
-		checksum += (mem_iord_byte(pkt_addr + 34 + i) << 8) + mem_iord_byte(pkt_addr + 34 + i + 1);
-	}
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	//One's complement
-	checksum = (~checksum) & 0xFFFF;
-	return (unsigned short) checksum;
+	checksum = eth_checksum_mem(0, pkt_addr + 26, 8);
+	checksum = eth_checksum_add(checksum, 0x0006 + tcp_length);
+	//TCP Header without the checksum field, and data
+	checksum = eth_checksum_mem(checksum, pkt_addr + 34, 16);
+	if(tcp_length > 18){
+		checksum = eth_checksum_mem(checksum, pkt_addr + 52, tcp_length - 18);
+	}
+	return eth_checksum_finish(checksum);
 }
 
 __attribute__((noinline))
 int tcp_verify_checksum(unsigned int pkt_addr){
-	return 1;
+	unsigned short int ip_length = ipv4_get_length(pkt_addr);
+	unsigned char header_length = tcp_get_header_length(pkt_addr);
+	//Reject lengths that do not fit a single frame before they are used to checksum
+	if(ip_length < 40 || ip_length > TCP_MSS + 40 || header_length < 20 || header_length > ip_length - 20){
+		return 0;
+	}
+	unsigned short int tcp_length = ip_length - 20;
+	unsigned int checksum;
+	checksum = eth_checksum_mem(0, pkt_addr + 26, 8);
+	checksum = eth_checksum_add(checksum, 0x0006 + tcp_length);
+	checksum = eth_checksum_mem(checksum, pkt_addr + 34, tcp_length);
+	checksum = eth_checksum_finish(checksum);
+	if (checksum == 0){
+		return 1;
+	}else{
+		return 0;
+	}
 }
 
 /*
  * High-level TCP protocol functions
  */
+static void tcp_input(tcp_connection* conn);
+
 const char* tcpstatenames[] = {"CLOSED", "LISTEN", "SYN_SENT", "SYN_RCVD", "ESTABLISHED", "FIN_WAIT_1", "FIN_WAIT_2", "TIME_WAIT", "CLOSE_WAIT", "CLOSING", "LAST_ACK"};
 
 __attribute__((noinline))
@@ -226,11 +294,12 @@ void tcp_init_connection(tcp_connection *conn, unsigned int eth_tx_addr, unsigne
 	conn->send_buffer_size = send_buffer_size;
 	memset(conn->recv_buffer, '0', recv_buffer_size);
 	conn->recv_buffer_size = recv_buffer_size;
+	tcp_stream_init(conn, NULL, 0, NULL, 0);
 }
 
 __attribute__((noinline))
 int tcp_connect(tcp_connection* conn){
-	if(tcp_send(conn, SYN, (unsigned char[]){'0'}, 1)){
+	if(tcp_send(conn, SYN, (unsigned char[]){'0'}, 0)){
 		conn->status = SYN_SENT;
 		if(eth_mac_receive(conn->eth_rx_addr, 1)){
 			if(mac_packet_type(conn->eth_rx_addr)==TCP) {
@@ -243,7 +312,7 @@ int tcp_connect(tcp_connection* conn){
 
 __attribute__((noinline))
 int tcp_listen(tcp_connection* conn){
-	if(tcp_send(conn, SYN, (unsigned char[]){'0'}, 1)){
+	if(tcp_send(conn, SYN, (unsigned char[]){'0'}, 0)){
 		conn->status = LISTEN;
 		if(eth_mac_receive(conn->eth_rx_addr, 1)){
 			if(mac_packet_type(conn->eth_rx_addr)==TCP) {
@@ -259,11 +328,13 @@ int tcp_close(tcp_connection* conn){
 	switch(conn->status){
 		case SYN_RCVD:
 		case ESTABLISHED:
-			tcp_send(conn, FIN, (unsigned char[]){'0'}, 0);
+			tcp_send(conn, (FIN|ACK), (unsigned char[]){'0'}, 0);
+			conn->seqNum++;
 			conn->status = FIN_WAIT_1;
 			break;
 		case CLOSE_WAIT:
-			tcp_send(conn, FIN, (unsigned char[]){'0'}, 0);
+			tcp_send(conn, (FIN|ACK), (unsigned char[]){'0'}, 0);
+			conn->seqNum++;
 			conn->status = LAST_ACK;
 			break;
 		case FIN_WAIT_1:
@@ -333,6 +404,8 @@ int tcp_handle(tcp_connection* conn){
 				break;
 			case LISTEN:
 				if((flags & SYN)==SYN){
+					conn->ackNum = seqNum + 1;
+					conn->mss = tcp_get_mss(conn->eth_rx_addr);
 					tcp_send(conn, (SYN|ACK), (unsigned char[]){'0'}, 0);
 					conn->status = SYN_RCVD;
 				}
@@ -342,10 +415,18 @@ int tcp_handle(tcp_connection* conn){
 				if(flags==(SYN|ACK)){
 					conn->seqNum = tcp_get_acknum(conn->eth_rx_addr);
 					conn->ackNum = tcp_get_seqnum(conn->eth_rx_addr) + 1;
+					conn->mss = tcp_get_mss(conn->eth_rx_addr);
+					conn->snd_una = conn->seqNum;
+					conn->snd_max = conn->seqNum;
+					conn->snd_wnd = tcp_get_window(conn->eth_rx_addr);
+					conn->snd_wl1 = seqNum;
+					conn->snd_wl2 = conn->seqNum;
 					tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
 					conn->status = ESTABLISHED;
 					resolved = 1;
 				} else if (flags==(SYN)){
+					conn->ackNum = seqNum + 1;
+					conn->mss = tcp_get_mss(conn->eth_rx_addr);
 					tcp_send(conn, (SYN|ACK), (unsigned char[]){'0'}, 0);
 					conn->status = SYN_RCVD;
 					resolved = 0;
@@ -360,6 +441,12 @@ int tcp_handle(tcp_connection* conn){
 				break;
 			case SYN_RCVD:
 				if((flags & ACK)==ACK){
+					conn->seqNum = tcp_get_acknum(conn->eth_rx_addr);
+					conn->snd_una = conn->seqNum;
+					conn->snd_max = conn->seqNum;
+					conn->snd_wnd = tcp_get_window(conn->eth_rx_addr);
+					conn->snd_wl1 = seqNum;
+					conn->snd_wl2 = conn->seqNum;
 					conn->status = ESTABLISHED;
 					resolved = 1;
 				} else {
@@ -367,24 +454,21 @@ int tcp_handle(tcp_connection* conn){
 				}
 				break;
 			case ESTABLISHED:
-				resolved = 1;
-				if(flags==FIN){
-					conn->status = CLOSE_WAIT;
-					resolved = 0;
-				}		
-				tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
+				tcp_input(conn);
+				resolved = (conn->status == ESTABLISHED);
 				break;
 			case FIN_WAIT_1:
-				if(flags==(FIN|ACK)){
-					tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
-					conn->status = TIME_WAIT;
-					resolved = 0;
-				} else if(flags==FIN){
+				//Our FIN is acknowledged when the peer acknowledges all we sent
+				if((flags & FIN)==FIN){
+					conn->ackNum = seqNum + tcp_get_data_length(conn->eth_rx_addr) + 1;
 					tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
-					conn->status = CLOSING;
+					if((flags & ACK)==ACK && tcp_get_acknum(conn->eth_rx_addr)==conn->seqNum){
+						conn->status = TIME_WAIT;
+					} else {
+						conn->status = CLOSING;
+					}
 					resolved = 0;
-				} else if(flags==ACK){
-					tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
+				} else if((flags & ACK)==ACK && tcp_get_acknum(conn->eth_rx_addr)==conn->seqNum){
 					conn->status = FIN_WAIT_2;
 					resolved = 0;
 				} else {
@@ -393,8 +477,9 @@ int tcp_handle(tcp_connection* conn){
 				break;
 			case FIN_WAIT_2:
 				if((flags & FIN)==FIN){
+					conn->ackNum = seqNum + tcp_get_data_length(conn->eth_rx_addr) + 1;
 					tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
-					conn->status = CLOSING;
+					conn->status = TIME_WAIT;
 					resolved = 0;
 				} else {
 					resolved = 0;
@@ -405,7 +490,7 @@ int tcp_handle(tcp_connection* conn){
 				resolved = 0;
 				break;
 			case CLOSING:
-				if(flags==ACK){
+				if((flags & ACK)==ACK){
 					conn->status = TIME_WAIT;
 				}
 				resolved = 0;
@@ -430,4 +515,260 @@ int tcp_handle(tcp_connection* conn){
 #endif
 	}
 	return resolved;
-}
\ No newline at end of file
+}
+
+/*
+ * TCP byte streams
+ */
+__attribute__((noinline))
+void tcp_stream_init(tcp_connection *conn, unsigned char snd_buf[], unsigned int snd_size, unsigned char rcv_buf[], unsigned int rcv_size){
+	conn->snd_buf = snd_buf;
+	conn->snd_size = snd_size;
+	conn->snd_head = 0;
+	conn->snd_len = 0;
+	conn->snd_una = conn->seqNum;
+	conn->snd_max = conn->seqNum;
+	conn->snd_wnd = 0;
+	conn->snd_wl1 = 0;
+	conn->snd_wl2 = conn->seqNum;
+	conn->rcv_buf = rcv_buf;
+	conn->rcv_size = rcv_size;
+	conn->rcv_head = 0;
+	conn->rcv_len = 0;
+	conn->mss = TCP_DEFAULT_MSS;
+	conn->rto = TCP_RTO_INIT;
+	conn->srtt = 0;
+	conn->rttvar = 0;
+	conn->rto_start = 0;
+	conn->rtt_seq = 0;
+	conn->rtt_start = 0;
+	conn->retransmits = 0;
+}
+
+//Updates the smoothed round-trip time and the retransmission timeout (RFC 6298)
+static void tcp_rtt_update(tcp_connection *conn, unsigned int rtt){
+	if(rtt == 0){
+		rtt = 1;
+	}
+	if(conn->srtt == 0){
+		conn->srtt = rtt;
+		conn->rttvar = rtt / 2;
+	} else {
+		unsigned int delta = (conn->srtt > rtt) ? conn->srtt - rtt : rtt - conn->srtt;
+		conn->rttvar = (3 * conn->rttvar + delta) / 4;
+		conn->srtt = (7 * conn->srtt + rtt) / 8;
+	}
+	conn->rto = conn->srtt + 4 * conn->rttvar;
+	if(conn->rto < TCP_RTO_MIN){
+		conn->rto = TCP_RTO_MIN;
+	} else if(conn->rto > TCP_RTO_MAX){
+		conn->rto = TCP_RTO_MAX;
+	}
+}
+
+//Sends the queued data that fits into the peer's window in segments of at most one MSS.
+//At most TCP_OUTPUT_SEGMENTS segments are sent, the rest is left to the next call.
+static void tcp_output(tcp_connection *conn){
+	unsigned int in_flight = conn->seqNum - conn->snd_una;
+	unsigned int segments = 0;
+	if(conn->status != ESTABLISHED && conn->status != CLOSE_WAIT){
+		return;
+	}
+	#pragma loopbound min 0 max TCP_OUTPUT_SEGMENTS
+	while(in_flight < conn->snd_len && in_flight < conn->snd_wnd && segments < TCP_OUTPUT_SEGMENTS){
+		unsigned int length = conn->snd_len - in_flight;
+		if(length > conn->snd_wnd - in_flight){
+			length = conn->snd_wnd - in_flight;
+		}
+		//Our frames never exceed the MSS we announce
+		if(length > conn->mss || length > TCP_MSS){
+			length = (conn->mss < TCP_MSS) ? conn->mss : TCP_MSS;
+		}
+		unsigned long long now = get_cpu_usecs();
+		tcp_send_segment(conn, (in_flight + length == conn->snd_len) ? (PSH|ACK) : ACK, conn->seqNum, length);
+		//Time new data only, not retransmissions (Karn)
+		if(conn->rtt_start == 0 && (int)(conn->seqNum - conn->snd_max) >= 0){
+			conn->rtt_seq = conn->seqNum + length;
+			conn->rtt_start = now;
+		}
+		if(conn->rto_start == 0){
+			conn->rto_start = now;
+		}
+		conn->seqNum += length;
+		if((int)(conn->seqNum - conn->snd_max) > 0){
+			conn->snd_max = conn->seqNum;
+		}
+		in_flight += length;
+		segments++;
+	}
+	//Probe a zero window with the timer
+	if(conn->snd_len > 0 && conn->rto_start == 0){
+		conn->rto_start = get_cpu_usecs();
+	}
+}
+
+//Retransmits from the oldest unacknowledged byte when the timer expires
+static void tcp_timer(tcp_connection *conn){
+	if(conn->rto_start == 0 || get_cpu_usecs() - conn->rto_start < conn->rto){
+		return;
+	}
+	if(conn->snd_len == 0){
+		conn->rto_start = 0;
+		return;
+	}
+	conn->retransmits++;
+	conn->rto = (2 * conn->rto > TCP_RTO_MAX) ? TCP_RTO_MAX : 2 * conn->rto;
+	conn->rtt_start = 0;
+	conn->seqNum = conn->snd_una;
+	if(conn->snd_wnd == 0){
+		tcp_send_segment(conn, ACK, conn->snd_una, 1);
+		//The peer may accept the probe byte and acknowledge it
+		if((int)(conn->snd_una + 1 - conn->snd_max) > 0){
+			conn->snd_max = conn->snd_una + 1;
+		}
+	}
+	conn->rto_start = get_cpu_usecs();
+}
+
+//Copies the data of the received segment to the end of the receive ring
+static void tcp_copy_data(tcp_connection* conn, unsigned short data_length){
+	unsigned int data_addr = conn->eth_rx_addr + 34 + tcp_get_header_length(conn->eth_rx_addr);
+	unsigned int offset = (conn->rcv_head + conn->rcv_len) % conn->rcv_size;
+	unsigned int first = conn->rcv_size - offset;
+	if(first >= data_length){
+		mem_iord_bytes(data_addr, conn->rcv_buf + offset, data_length);
+	} else {
+		mem_iord_bytes(data_addr, conn->rcv_buf + offset, first);
+		mem_iord_bytes(data_addr + first, conn->rcv_buf, data_length - first);
+	}
+}
+
+//Handles a segment received in the ESTABLISHED or CLOSE_WAIT state
+static void tcp_input(tcp_connection* conn){
+	unsigned int rx_addr = conn->eth_rx_addr;
+	unsigned char flags = tcp_get_flags(rx_addr);
+	unsigned int seqNum = tcp_get_seqnum(rx_addr);
+	if((flags & RST)==RST){
+		conn->status = CLOSED;
+		return;
+	}
+	if((flags & ACK)==ACK){
+		unsigned int ackNum = tcp_get_acknum(rx_addr);
+		unsigned int acked = ackNum - conn->snd_una;
+		//Cumulative acknowledgment, the peer may acknowledge more than we resent after a timeout.
+		if((int)(ackNum - conn->snd_max) <= 0){
+			if((int)acked > 0){
+				if(conn->rtt_start != 0 && (int)(ackNum - conn->rtt_seq) >= 0){
+					tcp_rtt_update(conn, get_cpu_usecs() - conn->rtt_start);
+					conn->rtt_start = 0;
+				}
+				conn->snd_head = (conn->snd_head + acked) % conn->snd_size;
+				conn->snd_len -= acked;
+				conn->snd_una = ackNum;
+				if((int)(conn->seqNum - ackNum) < 0){
+					conn->seqNum = ackNum;
+				}
+				conn->rto_start = (conn->seqNum == conn->snd_una) ? 0 : get_cpu_usecs();
+			}
+			//Only the newest segment updates the window, not stale or reordered ACKs (SND.WL1/WL2)
+			if((int)acked >= 0 && ((int)(conn->snd_wl1 - seqNum) < 0 || (conn->snd_wl1 == seqNum && (int)(conn->snd_wl2 - ackNum) <= 0))){
+				conn->snd_wnd = tcp_get_window(rx_addr);
+				conn->snd_wl1 = seqNum;
+				conn->snd_wl2 = ackNum;
+			}
+		}
+	}
+	unsigned short data_length = tcp_get_data_length(rx_addr);
+	if(data_length > 0 || (flags & FIN)==FIN){
+		//Only in-order data that fits is accepted, anything else gets a duplicate ACK
+		if(seqNum == conn->ackNum && data_length <= conn->rcv_size - conn->rcv_len){
+			if(data_length > 0){
+				tcp_copy_data(conn, data_length);
+			}
+			conn->rcv_len += data_length;
+			conn->ackNum += data_length;
+			if((flags & FIN)==FIN){
+				conn->ackNum++;
+				conn->status = CLOSE_WAIT;
+			}
+		}
+		tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
+	}
+}
+
+//Queues up to length bytes for sending and returns how many were queued.
+__attribute__((noinline))
+unsigned int tcp_write(tcp_connection* conn, const unsigned char data[], unsigned int length){
+	unsigned int free = conn->snd_size - conn->snd_len;
+	if(length > free){
+		length = free;
+	}
+	if(length > 0){
+		unsigned int offset = (conn->snd_head + conn->snd_len) % conn->snd_size;
+		unsigned int first = conn->snd_size - offset;
+		if(first >= length){
+			memcpy(conn->snd_buf + offset, data, length);
+		} else {
+			memcpy(conn->snd_buf + offset, data, first);
+			memcpy(conn->snd_buf, data + first, length - first);
+		}
+		conn->snd_len += length;
+		tcp_output(conn);
+	}
+	return length;
+}
+
+//Copies up to length received bytes to data and returns how many were copied.
+__attribute__((noinline))
+unsigned int tcp_read(tcp_connection* conn, unsigned char data[], unsigned int length){
+	unsigned short window = tcp_rcv_window(conn);
+	if(length > conn->rcv_len){
+		length = conn->rcv_len;
+	}
+	if(length > 0){
+		unsigned int first = conn->rcv_size - conn->rcv_head;
+		if(first >= length){
+			memcpy(data, conn->rcv_buf + conn->rcv_head, length);
+		} else {
+			memcpy(data, conn->rcv_buf + conn->rcv_head, first);
+			memcpy(data + first, conn->rcv_buf, length - first);
+		}
+		conn->rcv_head = (conn->rcv_head + length) % conn->rcv_size;
+		conn->rcv_len -= length;
+		//Tell the peer when the window opens again
+		if(window < conn->mss && tcp_rcv_window(conn) >= conn->mss && conn->status == ESTABLISHED){
+			tcp_send(conn, ACK, (unsigned char[]){'0'}, 0);
+		}
+	}
+	return length;
+}
+
+//Handles at most one received frame, the retransmission timer and pending data.
+__attribute__((noinline))
+int tcp_poll(tcp_connection* conn, unsigned long long timeout){
+	if(eth_mac_receive(conn->eth_rx_addr, timeout)){
+		switch(mac_packet_type(conn->eth_rx_addr)){
+			case ARP:
+				tcp_wait_tx();
+				arp_process_received(conn->eth_rx_addr, conn->eth_tx_addr);
+				break;
+			case TCP:
+				if(tcp_get_destination_port(conn->eth_rx_addr)==conn->srcport && tcp_verify_checksum(conn->eth_rx_addr)){
+					if(conn->status == ESTABLISHED || conn->status == CLOSE_WAIT){
+						tcp_input(conn);
+					} else {
+						tcp_handle(conn);
+					}
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	tcp_timer(conn);
+	tcp_output(conn);
+	if(conn->status == CLOSED){
+		return -1;
+	}
+	return conn->rcv_len;
+}
@@ -48,6 +48,20 @@
  */
 #define TCP_SYN_RETRIES 5   //times
 #define TCP_SYNACK_RETRIES 5    //times
+#define TCP_MSS 1460            //bytes, announced in our SYN segments
+#define TCP_DEFAULT_MSS 536     //bytes, if the peer announces no MSS
+#ifndef TCP_OUTPUT_SEGMENTS
+#define TCP_OUTPUT_SEGMENTS 16  //segments sent per tcp_poll at most
+#endif
+#ifndef TCP_RTO_INIT
+#define TCP_RTO_INIT 1000000    //us
+#endif
+#ifndef TCP_RTO_MIN
+#define TCP_RTO_MIN 200000      //us
+#endif
+#ifndef TCP_RTO_MAX
+#define TCP_RTO_MAX 60000000    //us
+#endif
 
 enum tcpstate{CLOSED, LISTEN, SYN_SENT, SYN_RCVD, ESTABLISHED, FIN_WAIT_1, FIN_WAIT_2, TIME_WAIT, CLOSE_WAIT, CLOSING, LAST_ACK};
 
@@ -71,6 +85,28 @@ typedef struct {
     unsigned short send_buffer_size;
     unsigned char* recv_buffer;
     unsigned short recv_buffer_size;
+    //Byte streams, seqNum is the next sequence number to send
+    unsigned char* snd_buf;         //send ring, holds the unacknowledged and unsent data
+    unsigned int snd_size;
+    unsigned int snd_head;          //ring index of snd_una
+    unsigned int snd_len;
+    unsigned int snd_una;           //oldest unacknowledged sequence number
+    unsigned int snd_max;           //highest sequence number sent
+    unsigned int snd_wnd;           //window advertised by the peer
+    unsigned int snd_wl1;           //sequence number of the segment that set snd_wnd
+    unsigned int snd_wl2;           //acknowledgment number of the segment that set snd_wnd
+    unsigned char* rcv_buf;         //receive ring, its free space is the advertised window
+    unsigned int rcv_size;
+    unsigned int rcv_head;
+    unsigned int rcv_len;
+    unsigned short mss;             //announced by the peer
+    unsigned int rto;               //retransmission timeout in us
+    unsigned int srtt;              //smoothed round-trip time in us, 0 before the first sample
+    unsigned int rttvar;
+    unsigned long long rto_start;   //start of the retransmission timer, 0 if stopped
+    unsigned int rtt_seq;           //sequence number acknowledging the timed segment
+    unsigned long long rtt_start;   //send time of the timed segment, 0 if none
+    unsigned int retransmits;
 } tcp_connection;
 
 /*
@@ -84,6 +120,8 @@ unsigned int tcp_get_acknum(unsigned int pkt_addr);
 unsigned char tcp_get_header_length(unsigned int pkt_addr);
 unsigned char tcp_get_flags(unsigned int pkt_addr);
 unsigned short tcp_get_checksum(unsigned int pkt_addr);
+unsigned short tcp_get_window(unsigned int pkt_addr);
+unsigned short tcp_get_mss(unsigned int pkt_addr);
 unsigned short tcp_get_data_length(unsigned int pkt_addr);
 unsigned int tcp_get_data(unsigned int pkt_addr, unsigned char data[], unsigned int data_length);
 unsigned short tcp_compute_checksum(unsigned int pkt_addr, unsigned short tcp_length, unsigned short data_length);
@@ -101,4 +139,19 @@ int tcp_push(tcp_connection* conn);
 int tcp_recv(tcp_connection* conn);
 int tcp_handle(tcp_connection* conn);
 
+/*
+ * TCP byte streams
+ *
+ * tcp_stream_init gives the connection a send and a receive ring. Once the
+ * connection is established, tcp_write queues data and sends what fits into
+ * the peer's window in MSS-sized segments. tcp_poll handles one received
+ * frame, cumulative ACKs and retransmission timeouts, and returns the number
+ * of bytes ready for tcp_read, or -1 when the connection is closed.
+ * Call tcp_close when the send ring is empty (snd_len == 0).
+ */
+void tcp_stream_init(tcp_connection *conn, unsigned char snd_buf[], unsigned int snd_size, unsigned char rcv_buf[], unsigned int rcv_size);
+unsigned int tcp_write(tcp_connection* conn, const unsigned char data[], unsigned int length);
+unsigned int tcp_read(tcp_connection* conn, unsigned char data[], unsigned int length);
+int tcp_poll(tcp_connection* conn, unsigned long long timeout);
+
 #endif
\ No newline at end of file
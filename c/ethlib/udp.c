@@ -85,10 +85,7 @@ unsigned short int udp_get_data_length(unsigned int pkt_addr){
 //This function gets the data field of an UDP packet.
 __attribute__((noinline))
 unsigned char udp_get_data(unsigned int pkt_addr, unsigned char data[], unsigned int data_length){
-	_Pragma("loopbound min 0 max 64")
-	for (int i = 0; i<data_length; i+=1){
-		data[i] = mem_iord_byte(pkt_addr + 42 + i);
-	}
+	mem_iord_bytes(pkt_addr + 42, data, data_length);
 	return 1;
 }
 
@@ -128,74 +125,29 @@ void udp_build_packet(udp_t *packet, unsigned char src_ip[4], unsigned char dst_
 __attribute__((noinline))
 unsigned short int udp_compute_checksum(unsigned int pkt_addr){
 	unsigned short int udp_length;
-	unsigned short int corrected_length;
 	unsigned int checksum;
 	udp_length = mem_iord(pkt_addr + 36) & 0xFFFF;
-	//
-	if ((udp_length & 0x1) == 0){
-		//even
-		corrected_length = udp_length;
-	}else{
-		//odd
-		corrected_length = udp_length + 1;
-		mem_iowr_byte(pkt_addr + udp_length + 34, 0x00);
-	}
-	checksum = 0;
-	_Pragma("loopbound min 0 max 14")
-	for (int i = 0; i<corrected_length; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 34 + i) << 8) + (mem_iord_byte(pkt_addr + 35 + i) & 0xFF);
-	}
-	checksum = checksum - (mem_iord_byte(pkt_addr + 40) << 8) + (mem_iord_byte(pkt_addr + 41) & 0xFF);
-	_Pragma("loopbound min 0 max 2")
-	for (int i = 0; i<4; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 26 + i) << 8) + (mem_iord_byte(pkt_addr + 27 + i) & 0xFF);
-		checksum = checksum + (mem_iord_byte(pkt_addr + 30 + i) << 8) + (mem_iord_byte(pkt_addr + 31 + i) & 0xFF);
+	//Pseudo IP header: IP addrs, protocol and length
+	checksum = eth_checksum_mem(0, pkt_addr + 26, 8);
+	checksum = eth_checksum_add(checksum, 0x0011 + udp_length);
+	//UDP header without the checksum field, and data
+	checksum = eth_checksum_mem(checksum, pkt_addr + 34, 6);
+	if (udp_length > 8){
+		checksum = eth_checksum_mem(checksum, pkt_addr + 42, udp_length - 8);
 	}
-	checksum = checksum + 0x0011 + udp_length;
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	checksum = ((~checksum) & 0xFFFF);
-	return (unsigned short int) checksum;		
+	return eth_checksum_finish(checksum);
 }
 
 //This function compute and returns the UDP checksum. The function ignore the the field checksum.
 __attribute__((noinline))
 int udp_verify_checksum(unsigned int pkt_addr){
 	unsigned short int udp_length;
-	unsigned short int corrected_length;
 	unsigned int checksum;
 	udp_length = mem_iord(pkt_addr + 36) & 0xFFFF;
-	//
-	if ((udp_length & 0x1) == 0){
-		//even
-		corrected_length = udp_length;
-	}else{
-		//odd
-		corrected_length = udp_length + 1;
-		mem_iowr_byte(pkt_addr + udp_length + 34, 0x00);
-	}
-	checksum = 0;
-	_Pragma("loopbound min 0 max 14")
-	for (int i = 0; i<corrected_length; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 34 + i) << 8) + (mem_iord_byte(pkt_addr + 35 + i) & 0xFF);
-	}
-	_Pragma("loopbound min 0 max 2")
-	for (int i = 0; i<4; i=i+2){
-		checksum = checksum + (mem_iord_byte(pkt_addr + 26 + i) << 8) + (mem_iord_byte(pkt_addr + 27 + i) & 0xFF);
-		checksum = checksum + (mem_iord_byte(pkt_addr + 30 + i) << 8) + (mem_iord_byte(pkt_addr + 31 + i) & 0xFF);
-	}
-	checksum = checksum + 0x0011 + udp_length;
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	if ((checksum & 0xFFFF0000) > 0)
-		checksum = (checksum & 0xFFFF) + (checksum >> 16);
-	checksum = ((~checksum) & 0xFFFF);
+	checksum = eth_checksum_mem(0, pkt_addr + 26, 8);
+	checksum = eth_checksum_add(checksum, 0x0011 + udp_length);
+	checksum = eth_checksum_mem(checksum, pkt_addr + 34, udp_length);
+	checksum = eth_checksum_finish(checksum);
 	if (checksum == 0){
 		return 1;
 	}else{
@@ -233,10 +185,7 @@ int udp_send(unsigned int tx_addr, unsigned int rx_addr, unsigned char destinati
 	mem_iowr(tx_addr + 36, (destination_port << 16) | udp_length);
 	mem_iowr(tx_addr + 40, 0x0000);
 	//UDP Data
-	_Pragma("loopbound min 0 max 64")
-	for (int i=0; i<data_length; i++){
-		mem_iowr_byte(tx_addr + 42 + i, data[i]);//Sender myip
-	}
+	mem_iowr_bytes(tx_addr + 42, data, data_length);
 	//IPv4 checksum
 	unsigned short int checksum = ipv4_compute_checksum(tx_addr);
 	mem_iowr_byte(tx_addr + 24, (checksum >> 8));
@@ -274,10 +223,7 @@ int udp_send_mac(unsigned int tx_addr, unsigned int rx_addr, unsigned char desti
 	mem_iowr(tx_addr + 36, (destination_port << 16) | udp_length);
 	mem_iowr(tx_addr + 40, 0x0000);
 	//UDP Data
-	_Pragma("loopbound min 0 max 64")
-	for (int i=0; i<data_length; i++){
-		mem_iowr_byte(tx_addr + 42 + i, data[i]);//Sender myip
-	}
+	mem_iowr_bytes(tx_addr + 42, data, data_length);
 	//IPv4 checksum
 	unsigned short int checksum = ipv4_compute_checksum(tx_addr);
 	mem_iowr_byte(tx_addr + 24, (checksum >> 8));
@@ -320,10 +266,7 @@ int udp_send_packet(unsigned int tx_addr, unsigned int rx_addr, udp_t packet, lo
 	mem_iowr(tx_addr + 36, (packet.udp_head.destination_port << 16) | udp_length);
 	mem_iowr(tx_addr + 40, 0x0000);
 	//UDP Data
-	_Pragma("loopbound min 0 max 64")
-	for (int i=0; i<packet.udp_head.data_length; i++){
-		mem_iowr_byte(tx_addr + 42 + i, packet.data[i]);//Sender myip
-	}
+	mem_iowr_bytes(tx_addr + 42, packet.data, packet.udp_head.data_length);
 	//IPv4 checksum
 	unsigned short int checksum = ipv4_compute_checksum(tx_addr);
 	mem_iowr_byte(tx_addr + 24, (checksum >> 8));
@@ -335,4 +278,121 @@ int udp_send_packet(unsigned int tx_addr, unsigned int rx_addr, udp_t packet, lo
 	eth_mac_send(tx_addr, frame_length);
 	ipv4_id+=0x10000;
 	return 1;
-}
\ No newline at end of file
+}
+
+///////////////////////////////////////////////////////////////
+//Zero-copy UDP sockets
+///////////////////////////////////////////////////////////////
+
+//This function binds the socket to a local port.
+void udp_socket_bind(udp_socket_t *sock, unsigned int rx_addr, unsigned int tx_addr, unsigned short port){
+	sock->rx_addr = rx_addr;
+	sock->tx_addr = tx_addr;
+	sock->port = port;
+	sock->connected = 0;
+	sock->ip_id = 0x1111;
+	return;
+}
+
+//This function sets the destination of the socket and builds the header template.
+__attribute__((noinline))
+int udp_socket_connect(udp_socket_t *sock, unsigned char destination_ip[], unsigned short destination_port, long long timeout){
+	unsigned int tx_addr = sock->tx_addr;
+	unsigned char destination_mac[6] = {0xFF,0xFF,0xFF,0xFF,0xFF,0xFF};
+	unsigned char broadcast_ip[4] = {0xFF,0xFF,0xFF,0xFF};
+	if (!ipv4_compare_ip(destination_ip, broadcast_ip) && arp_table_search(destination_ip, destination_mac) == 0){
+		if (arp_resolve_ip(sock->rx_addr, tx_addr, destination_ip, timeout) == 0 ||
+		    arp_table_search(destination_ip, destination_mac) == 0){
+			sock->connected = 0;
+			return 0;
+		}
+	}
+	for (int i=0; i<4; i++){
+		sock->destination_ip[i] = destination_ip[i];
+	}
+	sock->destination_port = destination_port;
+	//MAC addrs
+	mem_iowr(tx_addr, (destination_mac[0] << 24) | (destination_mac[1] << 16) | (destination_mac[2] << 8) | destination_mac[3]);
+	mem_iowr(tx_addr + 4, (destination_mac[4] << 24) | (destination_mac[5] << 16) | (my_mac[0] << 8) | my_mac[1]);
+	mem_iowr(tx_addr + 8, (my_mac[2] << 24) | (my_mac[3] << 16) | (my_mac[4] << 8) | my_mac[5]);
+	//MAC type + IP version + IP type
+	mem_iowr(tx_addr + 12, 0x08004500);
+	//Flags + TTL + Protocol
+	mem_iowr(tx_addr + 20, 0x40004011);
+	//IP addrs + Ports, the lengths, identification and checksums are set when sending
+	mem_iowr(tx_addr + 24, (my_ip[0] << 8) | my_ip[1]);
+	mem_iowr(tx_addr + 28, (my_ip[2] << 24) | (my_ip[3] << 16) | (destination_ip[0] << 8) | destination_ip[1]);
+	mem_iowr(tx_addr + 32, (destination_ip[2] << 24) | (destination_ip[3] << 16) | sock->port);
+	mem_iowr(tx_addr + 36, destination_port << 16);
+	//Partial checksums: the fixed IP header fields, and the UDP pseudo header without the length plus the ports
+	unsigned int ip_addrs = eth_checksum_mem(0, tx_addr + 26, 8);
+	sock->ip_sum = eth_checksum_add(ip_addrs, 0x4500 + 0x4000 + 0x4011);
+	sock->udp_sum = eth_checksum_add(ip_addrs, 0x0011 + sock->port + destination_port);
+	sock->connected = 1;
+	return 1;
+}
+
+//This function returns the address where the data of the next datagram is written.
+unsigned int udp_send_buffer(udp_socket_t *sock){
+	return sock->tx_addr + UDP_DATA_OFFSET;
+}
+
+//This function sends data_length bytes written at udp_send_buffer().
+__attribute__((noinline))
+int udp_send_zc(udp_socket_t *sock, unsigned short data_length){
+	if (!sock->connected || data_length > UDP_MAX_DATA){
+		return 0;
+	}
+	unsigned int tx_addr = sock->tx_addr;
+	unsigned short udp_length = data_length + 8;
+	unsigned short ip_length = udp_length + 20;
+	unsigned int checksum;
+	//Length + Identification
+	mem_iowr(tx_addr + 16, (ip_length << 16) | sock->ip_id);
+	//IPv4 checksum + source IP
+	checksum = eth_checksum_add(eth_checksum_add(sock->ip_sum, ip_length), sock->ip_id);
+	mem_iowr(tx_addr + 24, (eth_checksum_finish(checksum) << 16) | (my_ip[0] << 8) | my_ip[1]);
+	//Destination port + UDP length
+	mem_iowr(tx_addr + 36, (sock->destination_port << 16) | udp_length);
+	//UDP checksum, the length is in both the pseudo header and the UDP header
+	checksum = eth_checksum_add(sock->udp_sum, udp_length << 1);
+	checksum = eth_checksum_mem(checksum, tx_addr + UDP_DATA_OFFSET, data_length);
+	checksum = eth_checksum_finish(checksum);
+	if (checksum == 0){
+		checksum = 0xFFFF;
+	}
+	mem_iowr(tx_addr + 40, (checksum << 16) | (mem_iord(tx_addr + 40) & 0xFFFF));
+	eth_mac_send(tx_addr, ip_length + 14);
+	sock->ip_id++;
+	return 1;
+}
+
+//This function receives a frame and returns the data of a datagram for the socket in place.
+__attribute__((noinline))
+int udp_recv_zc(udp_socket_t *sock, unsigned int *data_addr, unsigned short *data_length, unsigned long long timeout){
+	unsigned int rx_addr = sock->rx_addr;
+	if (eth_mac_receive(rx_addr, timeout) == 0){
+		return 0;
+	}
+	if (mac_packet_type(rx_addr) != UDP || udp_get_destination_port(rx_addr) != sock->port){
+		return -1;
+	}
+	unsigned char destination_ip[4];
+	unsigned char broadcast_ip[4] = {0xFF,0xFF,0xFF,0xFF};
+	ipv4_get_destination_ip(rx_addr, destination_ip);
+	if (!ipv4_compare_ip(destination_ip, my_ip) && !ipv4_compare_ip(destination_ip, broadcast_ip)){
+		return -1;
+	}
+	//The UDP length must cover the header and fit into the IP packet, which fits into a frame
+	unsigned short ip_length = ipv4_get_length(rx_addr);
+	unsigned short udp_length = udp_get_packet_length(rx_addr);
+	if (ip_length > UDP_MAX_DATA + 28 || udp_length < 8 || udp_length > ip_length - 20){
+		return -1;
+	}
+	if (udp_get_checksum(rx_addr) != 0 && !udp_verify_checksum(rx_addr)){
+		return -1;
+	}
+	*data_addr = rx_addr + UDP_DATA_OFFSET;
+	*data_length = udp_get_data_length(rx_addr);
+	return 1;
+}
@@ -109,4 +109,53 @@ int udp_send_mac(unsigned int tx_addr, unsigned int rx_addr, unsigned char desti
 //This function sends a UDP packet
 int udp_send_packet(unsigned int tx_addr, unsigned int rx_addr, udp_t packet, long long timeout);
 
+///////////////////////////////////////////////////////////////
+//Zero-copy UDP sockets
+///////////////////////////////////////////////////////////////
+
+//Offset of the UDP data in an Ethernet frame
+#define UDP_DATA_OFFSET 42
+//Largest UDP data in one Ethernet frame without fragmentation
+#define UDP_MAX_DATA 1472
+
+//A UDP socket bound to a local port. Received frames are placed at rx_addr
+//and sent frames are built at tx_addr, both in the EthMac buffer. After
+//udp_socket_connect() the buffer at tx_addr holds the Ethernet, IP and UDP
+//headers for the destination, and the partial checksums of the fields that
+//do not change are kept here.
+typedef struct
+{
+   unsigned int rx_addr;
+   unsigned int tx_addr;
+   unsigned short port;
+   unsigned short destination_port;
+   unsigned char destination_ip[4];
+   unsigned char connected;
+   unsigned short ip_id;
+   unsigned int ip_sum;
+   unsigned int udp_sum;
+} udp_socket_t;
+
+//This function binds the socket to a local port.
+void udp_socket_bind(udp_socket_t *sock, unsigned int rx_addr, unsigned int tx_addr, unsigned short port);
+
+//This function sets the destination of the socket. The MAC is resolved with ARP (blocking up to timeout) and the
+//header template is built at tx_addr. It returns 1 on success and 0 if the IP could not be resolved. Call it again
+//to refresh the MAC after the ARP entry has expired.
+int udp_socket_connect(udp_socket_t *sock, unsigned char destination_ip[], unsigned short destination_port, long long timeout);
+
+//This function returns the address in the EthMac buffer where the data of the next datagram is written.
+unsigned int udp_send_buffer(udp_socket_t *sock);
+
+//This function sends data_length bytes written at udp_send_buffer() to the destination of the socket. Only the
+//length, identification and checksum fields of the template are updated. It returns 0 if the socket is not connected
+//or data_length is above UDP_MAX_DATA.
+int udp_send_zc(udp_socket_t *sock, unsigned short data_length);
+
+//This function receives a frame at rx_addr (see eth_mac_receive() for the timeout). If it is a UDP datagram for the
+//port of the socket and our IP (or broadcast), with consistent lengths and a correct checksum, it sets data_addr and data_length to the data in the EthMac buffer and
+//returns 1. The data stays valid until the next receive. It returns 0 on timeout and -1 for any other frame, which
+//is left at rx_addr for the caller (e.g. ARP or ICMP).
+int udp_recv_zc(udp_socket_t *sock, unsigned int *data_addr, unsigned short *data_length, unsigned long long timeout);
+
 #endif
@@ -0,0 +1,126 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Cycle benchmark of the ARP table of ethlib
+ *
+ * The table is filled with a growing number of peers. Then every peer
+ * is looked up (hits), as many unknown IPs are looked up (misses) and
+ * the same number of new peers is inserted, which evicts old entries
+ * once the probed entries are full. The average, minimum and maximum
+ * cycles per operation are printed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include <machine/rtc.h>
+#include "ethlib/arp.h"
+
+#define NUM_LOADS 4
+const int peer_counts[NUM_LOADS] = {ARP_TABLE_SIZE/4, ARP_TABLE_SIZE/2, ARP_TABLE_SIZE, 2*ARP_TABLE_SIZE};
+
+struct stats{
+	unsigned long long sum;
+	unsigned long long min;
+	unsigned long long max;
+	int cnt;
+};
+
+static void stats_add(struct stats *s, unsigned long long cycles){
+	s->sum += cycles;
+	if (s->cnt == 0 || cycles < s->min) s->min = cycles;
+	if (s->cnt == 0 || cycles > s->max) s->max = cycles;
+	s->cnt++;
+}
+
+static void stats_print(const char *name, struct stats *s){
+	printf("  %-8s %8llu %8llu %8llu\n", name, s->cnt ? s->sum / s->cnt : 0, s->min, s->max);
+}
+
+//Peers on 10.x.y.z with the MAC derived from the IP
+static void peer(int n, unsigned char ip[], unsigned char mac[]){
+	ip[0] = 10; ip[1] = n >> 16; ip[2] = n >> 8; ip[3] = n;
+	mac[0] = 0x02; mac[1] = 0x00; mac[2] = ip[0]; mac[3] = ip[1]; mac[4] = ip[2]; mac[5] = ip[3];
+}
+
+int main(){
+	unsigned char ip[4], mac[6], found[6];
+	int errors = 0;
+
+	printf("Cycles per ARP table operation (%d entries, %d probes)\n", ARP_TABLE_SIZE, ARP_TABLE_PROBES);
+	for (int l = 0; l < NUM_LOADS; l++){
+		struct stats hit = {0, 0, 0, 0}, miss = {0, 0, 0, 0}, insert = {0, 0, 0, 0};
+		int peers = peer_counts[l];
+		int hits = 0;
+		unsigned long long t0;
+
+		arp_table_init();
+		for (int i = 0; i < peers; i++){
+			peer(i, ip, mac);
+			arp_table_new_entry(ip, mac);
+		}
+		for (int i = 0; i < peers; i++){
+			peer(i, ip, mac);
+			t0 = get_cpu_cycles();
+			int ans = arp_table_search(ip, found);
+			stats_add(&hit, get_cpu_cycles() - t0);
+			if (ans){
+				hits++;
+				for (int j = 0; j < 6; j++){
+					errors += found[j] != mac[j];
+				}
+			}
+		}
+		for (int i = 0; i < peers; i++){
+			peer(0x10000 + i, ip, mac);
+			t0 = get_cpu_cycles();
+			errors += arp_table_search(ip, found);
+			stats_add(&miss, get_cpu_cycles() - t0);
+		}
+		for (int i = 0; i < peers; i++){
+			peer(0x20000 + i, ip, mac);
+			t0 = get_cpu_cycles();
+			arp_table_new_entry(ip, mac);
+			stats_add(&insert, get_cpu_cycles() - t0);
+			errors += !arp_table_search(ip, found);
+		}
+
+		printf("%d peers, %d found\n", peers, hits);
+		printf("  %-8s %8s %8s %8s\n", "", "avg", "min", "max");
+		stats_print("known", &hit);
+		stats_print("unknown", &miss);
+		stats_print("insert", &insert);
+	}
+	printf("%d errors\n", errors);
+	return errors;
+}
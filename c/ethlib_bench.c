@@ -0,0 +1,130 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Cycle benchmark of the ethlib buffer accessors and checksums
+ *
+ * For UDP frames of growing size, the payload is copied into the
+ * EthMac buffer and back, and the UDP checksum is computed, once
+ * byte by byte (as ethlib did before) and once with the word-wide
+ * accessors. The frame is not sent.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "ethlib/udp.h"
+#include "ethlib/eth_patmos_io.h"
+
+#define NUM_SIZES 6
+const unsigned frame_sizes[NUM_SIZES] = {64, 128, 256, 512, 1024, 1514};
+
+unsigned int tx_addr = 0x800;
+unsigned char payload[1500];
+unsigned char copy[1500];
+
+//The UDP checksum computed with byte accesses only
+unsigned short byte_udp_checksum(unsigned int pkt_addr){
+	unsigned short udp_length = (mem_iord_byte(pkt_addr+38) << 8) | mem_iord_byte(pkt_addr+39);
+	unsigned int checksum = 0;
+	_Pragma("loopbound min 0 max 750")
+	for (int i = 0; i < udp_length; i += 2){
+		if (i == 6) continue; //checksum field
+		checksum += mem_iord_byte(pkt_addr + 34 + i) << 8;
+		if (i + 1 < udp_length)
+			checksum += mem_iord_byte(pkt_addr + 35 + i);
+	}
+	_Pragma("loopbound min 4 max 4")
+	for (int i = 0; i < 8; i += 2){
+		checksum += (mem_iord_byte(pkt_addr + 26 + i) << 8) + mem_iord_byte(pkt_addr + 27 + i);
+	}
+	checksum += 0x0011 + udp_length;
+	checksum = (checksum & 0xFFFF) + (checksum >> 16);
+	checksum = (checksum & 0xFFFF) + (checksum >> 16);
+	return (unsigned short)(~checksum & 0xFFFF);
+}
+
+int main(){
+	int errors = 0;
+
+	for (int i = 0; i < 1500; i++){
+		payload[i] = rand();
+	}
+
+	printf("Cycles per frame\n");
+	printf("%6s %10s %10s %10s %10s %10s %10s\n", "frame",
+	       "copy-in b", "copy-in w", "copy-out b", "copy-out w", "csum b", "csum w");
+	for (int s = 0; s < NUM_SIZES; s++){
+		unsigned data_length = frame_sizes[s] - 42;
+		unsigned long long t0, t1, t2, t3, t4, t5, t6;
+
+		//IP addrs, ports, UDP length and checksum
+		mem_iowr(tx_addr + 24, 0x0000C0A8);
+		mem_iowr(tx_addr + 28, 0x0001C0A8);
+		mem_iowr(tx_addr + 32, 0x000204D2);
+		mem_iowr(tx_addr + 36, (1235 << 16) | (data_length + 8));
+		mem_iowr(tx_addr + 40, 0x0000);
+
+		t0 = get_cpu_cycles();
+		_Pragma("loopbound min 22 max 1472")
+		for (int i = 0; i < data_length; i++){
+			mem_iowr_byte(tx_addr + 42 + i, payload[i]);
+		}
+		t1 = get_cpu_cycles();
+		mem_iowr_bytes(tx_addr + 42, payload, data_length);
+		t2 = get_cpu_cycles();
+		_Pragma("loopbound min 22 max 1472")
+		for (int i = 0; i < data_length; i++){
+			copy[i] = mem_iord_byte(tx_addr + 42 + i);
+		}
+		t3 = get_cpu_cycles();
+		mem_iord_bytes(tx_addr + 42, copy, data_length);
+		t4 = get_cpu_cycles();
+		unsigned short ref = byte_udp_checksum(tx_addr);
+		t5 = get_cpu_cycles();
+		unsigned short checksum = udp_compute_checksum(tx_addr);
+		t6 = get_cpu_cycles();
+
+		for (int i = 0; i < data_length; i++){
+			errors += copy[i] != payload[i];
+		}
+		errors += checksum != ref;
+		//A frame with its checksum filled in sums up to zero
+		mem_iowr(tx_addr + 40, (checksum << 16) | (mem_iord(tx_addr + 40) & 0xFFFF));
+		errors += !udp_verify_checksum(tx_addr);
+
+		printf("%6u %10llu %10llu %10llu %10llu %10llu %10llu\n", frame_sizes[s],
+		       t1-t0, t2-t1, t3-t2, t4-t3, t5-t4, t6-t5);
+	}
+	printf("%d errors\n", errors);
+	return errors;
+}
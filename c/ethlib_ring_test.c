@@ -0,0 +1,160 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Test of the descriptor rings of the EthMac driver
+ *
+ * The EthMac is put into loopback mode and NUM_FRAMES numbered frames of
+ * varying length are sent in bursts through the TX ring, while the RX
+ * ring is drained in bursts. Each received frame is checked against the
+ * frame that was sent with its number. Frames that do not come back,
+ * because the RX ring was full, are counted as lost, frames with errors
+ * or wrong contents as bad. The loop is timed in cycles per frame.
+ *
+ * The test needs the EthMac hardware, the emulator does not model the
+ * descriptor rings.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include "ethlib/eth_mac_driver.h"
+#include "ethlib/eth_patmos_io.h"
+
+#define NUM_FRAMES 1000
+#define BURST 4
+#define TX_NUM 8
+#define RX_NUM 8
+#define TX_BUFF_ADDR 0x0000
+#define RX_BUFF_ADDR (TX_BUFF_ADDR + TX_NUM * ETH_MAC_FRAME_SIZE)
+//Local experimental EtherType
+#define ETH_TYPE_TEST 0x88B5
+//Cycles to wait for the last frames to come back
+#define DRAIN_CYCLES 1000000
+
+//Frame lengths without the CRC, from the minimum to the maximum
+static unsigned frame_length(unsigned seq){
+	return 60 + (seq * 97) % (1514 - 60 + 1);
+}
+
+//Broadcast frame with the sequence number after the header and a pattern
+static void build_frame(unsigned addr, unsigned seq){
+	unsigned length = frame_length(seq);
+	mem_iowr(addr, 0xFFFFFFFF);
+	mem_iowr(addr + 4, 0xFFFF0200);
+	mem_iowr(addr + 8, 0x00000001);
+	mem_iowr(addr + 12, (ETH_TYPE_TEST << 16) | (seq >> 16));
+	mem_iowr(addr + 16, seq << 16);
+	_Pragma("loopbound min 11 max 374")
+	for (unsigned i = 20; i < length; i += 4){
+		mem_iowr(addr + i, seq + i);
+	}
+}
+
+//Returns 1 if the frame at addr is the frame with number seq
+static int check_frame(unsigned addr, unsigned length, unsigned seq){
+	//The received length includes the CRC
+	if (length < frame_length(seq) || (mem_iord(addr + 12) >> 16) != ETH_TYPE_TEST){
+		return 0;
+	}
+	_Pragma("loopbound min 11 max 374")
+	for (unsigned i = 20; i + 4 <= frame_length(seq); i += 4){
+		if (mem_iord(addr + i) != seq + i){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static unsigned frame_seq(unsigned addr){
+	return ((mem_iord(addr + 12) & 0xFFFF) << 16) | (mem_iord(addr + 16) >> 16);
+}
+
+int main(){
+	unsigned tx_addr[TX_NUM];
+	unsigned tx_length[TX_NUM];
+	unsigned rx_addr[RX_NUM];
+	unsigned rx_length[RX_NUM];
+	unsigned sent = 0, reaped = 0, received = 0, lost = 0, bad = 0;
+	unsigned next = 0;  //sequence number expected next
+	unsigned tx_slot = 0;
+
+	eth_mac_initialize();
+	eth_iowr(MODER_ADDR, eth_iord(MODER_ADDR) | LOOPBCK_BIT);
+	if (!eth_mac_ring_init(RX_BUFF_ADDR, TX_NUM, RX_NUM)){
+		printf("Rings do not fit\n");
+		return 1;
+	}
+
+	unsigned long long start = get_cpu_cycles();
+	unsigned long long last = start;
+	_Pragma("loopbound min 0 max 100000")
+	while (next < NUM_FRAMES && get_cpu_cycles() - last < DRAIN_CYCLES){
+		//Fill the free TX descriptors, a buffer is reused once it is reaped
+		reaped += eth_mac_tx_reap();
+		unsigned n = 0;
+		_Pragma("loopbound min 0 max 4")
+		while (n < BURST && sent + n < NUM_FRAMES && sent + n - reaped < TX_NUM){
+			tx_addr[n] = TX_BUFF_ADDR + tx_slot * ETH_MAC_FRAME_SIZE;
+			tx_length[n] = frame_length(sent + n);
+			build_frame(tx_addr[n], sent + n);
+			tx_slot = tx_slot == TX_NUM-1 ? 0 : tx_slot+1;
+			n++;
+		}
+		sent += eth_mac_tx_burst(tx_addr, tx_length, n);
+
+		//Check and release the received frames
+		unsigned cnt = eth_mac_rx_burst(rx_addr, rx_length, BURST);
+		_Pragma("loopbound min 0 max 4")
+		for (unsigned i = 0; i < cnt; i++){
+			unsigned seq = frame_seq(rx_addr[i]);
+			if (rx_length[i] == 0 || seq < next || seq >= sent || !check_frame(rx_addr[i], rx_length[i], seq)){
+				bad++;
+				continue;
+			}
+			lost += seq - next;
+			next = seq + 1;
+			received++;
+		}
+		eth_mac_rx_release(cnt);
+		if (cnt > 0){
+			last = get_cpu_cycles();
+		}
+	}
+	unsigned long long cycles = get_cpu_cycles() - start;
+	lost += NUM_FRAMES - next;
+
+	printf("%d frames sent in bursts of %d, %d TX and %d RX descriptors\n", sent, BURST, TX_NUM, RX_NUM);
+	printf("%d received, %d lost, %d bad, %d RX errors\n", received, lost, bad, eth_mac_rx_errors());
+	printf("%llu cycles per frame\n", sent ? cycles / sent : 0);
+	return (sent != NUM_FRAMES || bad != 0);
+}
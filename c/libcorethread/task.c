@@ -0,0 +1,298 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Task runtime with work stealing on top of the corethreads
+ *
+ */
+
+#include "corethread.h"
+#include "task.h"
+
+#if defined(TASK_HARDLOCK)
+
+#define HARDLOCK_BASE ((_iodev_ptr_t) PATMOS_IO_HARDLOCK)
+#define deque_lock_init(id)
+#define deque_lock(id) do {asm volatile ("" : : : "memory"); *HARDLOCK_BASE = ((id) << 1) + 1; asm volatile ("" : : : "memory");} while(0)
+#define deque_unlock(id) do {asm volatile ("" : : : "memory"); *HARDLOCK_BASE = ((id) << 1) + 0; asm volatile ("" : : : "memory");} while(0)
+
+#elif defined(TASK_CASPM)
+
+#define CASPM_BASE ((_iodev_ptr_t) PATMOS_IO_CASPM)
+#define deque_lock_init(id)
+#define deque_lock(id) do {asm volatile ("" : : : "memory"); *CASPM_BASE = 0; *(CASPM_BASE+1) = 1; while(*(CASPM_BASE+(id)) != 0){asm("");} asm volatile ("" : : : "memory");} while(0)
+#define deque_unlock(id) do {asm volatile ("" : : : "memory"); *CASPM_BASE = 1; *(CASPM_BASE+1) = 0; while(*(CASPM_BASE+(id)) != 1){asm("");} asm volatile ("" : : : "memory");} while(0)
+
+#else
+
+#include <pthread.h>
+static pthread_mutex_t deque_mutex[MAX_CORES];
+#define deque_lock_init(id) pthread_mutex_init(&deque_mutex[id], NULL)
+#define deque_lock(id) pthread_mutex_lock(&deque_mutex[id])
+#define deque_unlock(id) pthread_mutex_unlock(&deque_mutex[id])
+
+#endif
+
+// A task, either a function call or a part of a parallel loop
+typedef struct {
+  void (*func)(void *);
+  void (*body)(int, int, void *);
+  void *arg;
+  task_group_t *group;
+  int first;
+  int last;
+  int grain;
+} task_t;
+
+typedef struct {
+  task_t tasks[TASK_DEQUE_SIZE];
+  unsigned top;
+  unsigned bottom;
+} deque_t;
+
+static volatile _UNCACHED deque_t deques[MAX_CORES];
+
+static volatile _UNCACHED int task_stop;
+
+#define UNCACHED_GROUP(G) ((volatile task_group_t _UNCACHED *)(G))
+
+static void store_task(volatile _UNCACHED task_t *dst, const task_t *src) {
+  dst->func = src->func;
+  dst->body = src->body;
+  dst->arg = src->arg;
+  dst->group = src->group;
+  dst->first = src->first;
+  dst->last = src->last;
+  dst->grain = src->grain;
+}
+
+static void load_task(task_t *dst, volatile _UNCACHED task_t *src) {
+  dst->func = src->func;
+  dst->body = src->body;
+  dst->arg = src->arg;
+  dst->group = src->group;
+  dst->first = src->first;
+  dst->last = src->last;
+  dst->grain = src->grain;
+}
+
+// Push a task to the bottom of the own deque
+static int push_task(const task_t *t) {
+  unsigned id = get_cpuid();
+  volatile _UNCACHED deque_t *d = &deques[id];
+  int ret = 0;
+  deque_lock(id);
+  if (d->bottom - d->top < TASK_DEQUE_SIZE) {
+    store_task(&d->tasks[d->bottom % TASK_DEQUE_SIZE], t);
+    d->bottom++;
+    ret = 1;
+  }
+  deque_unlock(id);
+  return ret;
+}
+
+// Pop a task from the bottom of the own deque
+static int pop_task(task_t *t) {
+  unsigned id = get_cpuid();
+  volatile _UNCACHED deque_t *d = &deques[id];
+  int ret = 0;
+  // Do not take the lock if the deque is empty
+  if (d->bottom == d->top) {
+    return 0;
+  }
+  deque_lock(id);
+  if (d->bottom != d->top) {
+    d->bottom--;
+    load_task(t, &d->tasks[d->bottom % TASK_DEQUE_SIZE]);
+    ret = 1;
+  }
+  deque_unlock(id);
+  return ret;
+}
+
+// Steal a task from the top of the deque of another core
+static int steal_task(unsigned victim, task_t *t) {
+  volatile _UNCACHED deque_t *d = &deques[victim];
+  int ret = 0;
+  if (d->bottom == d->top) {
+    return 0;
+  }
+  deque_lock(victim);
+  if (d->bottom != d->top) {
+    load_task(t, &d->tasks[d->top % TASK_DEQUE_SIZE]);
+    d->top++;
+    ret = 1;
+  }
+  deque_unlock(victim);
+  return ret;
+}
+
+static void spawn_task(const task_t *t);
+
+static void run_task(const task_t *t) {
+  if (t->body != NULL) {
+    // Split the range and keep the lower half
+    int first = t->first;
+    int last = t->last;
+    while (last - first > t->grain) {
+      int mid = first + (last - first) / 2;
+      task_t upper = *t;
+      upper.first = mid;
+      upper.last = last;
+      spawn_task(&upper);
+      last = mid;
+    }
+    t->body(first, last, t->arg);
+  } else {
+    t->func(t->arg);
+  }
+  UNCACHED_GROUP(t->group)->done[get_cpuid()]++;
+}
+
+static void spawn_task(const task_t *t) {
+  // Count the task before it can be stolen and finished
+  UNCACHED_GROUP(t->group)->spawned[get_cpuid()]++;
+  if (!push_task(t)) {
+    run_task(t);
+  }
+}
+
+// Run one task from the own deque or stolen from another core
+static int run_one(void) {
+  unsigned id = get_cpuid();
+  unsigned cnt = get_cpucnt();
+  task_t t;
+  if (pop_task(&t)) {
+    run_task(&t);
+    return 1;
+  }
+  for (unsigned i = 1; i < cnt; i++) {
+    unsigned victim = id + i < cnt ? id + i : id + i - cnt;
+    if (steal_task(victim, &t)) {
+      // The task may read data written by other cores
+      inval_dcache();
+      run_task(&t);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int group_done(task_group_t *group) {
+  unsigned cnt = get_cpucnt();
+  int done = 0;
+  int spawned = 0;
+  // Read the done counters first, a task that is counted as done has
+  // been counted as spawned before
+  for (unsigned i = 0; i < cnt; i++) {
+    done += UNCACHED_GROUP(group)->done[i];
+  }
+  for (unsigned i = 0; i < cnt; i++) {
+    spawned += UNCACHED_GROUP(group)->spawned[i];
+  }
+  return done == spawned;
+}
+
+static void task_worker(void *arg) {
+  while (!task_stop) {
+    run_one();
+  }
+  corethread_exit(NULL);
+}
+
+int task_init(void) {
+  unsigned cnt = get_cpucnt();
+  for (unsigned i = 0; i < cnt; i++) {
+    deque_lock_init(i);
+    deques[i].top = 0;
+    deques[i].bottom = 0;
+  }
+  task_stop = 0;
+  for (unsigned i = 0; i < cnt; i++) {
+    if (i != NOC_MASTER && corethread_create(i, &task_worker, NULL) != 0) {
+      // Stop the workers that have been started
+      task_stop = 1;
+      for (unsigned j = 0; j < i; j++) {
+        if (j != NOC_MASTER) {
+          void *ret;
+          corethread_join(j, &ret);
+        }
+      }
+      return EAGAIN;
+    }
+  }
+  return 0;
+}
+
+void task_exit(void) {
+  unsigned cnt = get_cpucnt();
+  task_stop = 1;
+  for (unsigned i = 0; i < cnt; i++) {
+    if (i != NOC_MASTER) {
+      void *ret;
+      corethread_join(i, &ret);
+    }
+  }
+}
+
+void task_group_init(task_group_t *group) {
+  for (unsigned i = 0; i < MAX_CORES; i++) {
+    UNCACHED_GROUP(group)->spawned[i] = 0;
+    UNCACHED_GROUP(group)->done[i] = 0;
+  }
+}
+
+void task_spawn(task_group_t *group, void (*func)(void *), void *arg) {
+  task_t t = { func, NULL, arg, group, 0, 0, 0 };
+  spawn_task(&t);
+}
+
+void task_sync(task_group_t *group) {
+  while (!group_done(group)) {
+    run_one();
+  }
+  // The results may have been written by other cores
+  inval_dcache();
+}
+
+void parallel_for(int first, int last, int grain,
+                  void (*body)(int, int, void *), void *arg) {
+  task_group_t group;
+  task_group_init(&group);
+  if (grain < 1) {
+    grain = 1;
+  }
+  task_t t = { NULL, body, arg, &group, first, last, grain };
+  UNCACHED_GROUP(&group)->spawned[get_cpuid()]++;
+  run_task(&t);
+  task_sync(&group);
+}
@@ -0,0 +1,128 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/** \addtogroup libcorethread
+ *  @{
+ */
+
+/**
+ * \file task.h Definitions for the task runtime of libcorethread.
+ *
+ * \brief A task runtime with persistent workers and work stealing.
+ *
+ * #task_init() starts a worker on every core except #NOC_MASTER. Each
+ * core has a deque of tasks in uncached shared memory. A core pushes and
+ * pops tasks at the bottom of its own deque, and an idle core steals
+ * from the top of the deques of the others. A core that waits in
+ * #task_sync() runs tasks itself until its group is done.
+ *
+ * The data cache is write-through but not coherent. A core invalidates
+ * its data cache before it runs a task spawned by another core and when
+ * a #task_sync() returns, so tasks can use cached shared data as long as
+ * tasks that run at the same time do not write to the same cache line.
+ *
+ * The deques are protected by pthread mutexes. Define TASK_HARDLOCK or
+ * TASK_CASPM when building the library to use the Hardlock or the CASPM
+ * device instead, with one hardware lock per core.
+ */
+
+#ifndef _TASK_H_
+#define _TASK_H_
+
+#include <machine/patmos.h>
+#include <machine/boot.h>
+
+/// \brief The number of tasks that fit into the deque of a core, a power
+/// of two. A task that does not fit is run by the spawning core at once.
+#ifndef TASK_DEQUE_SIZE
+#define TASK_DEQUE_SIZE 32
+#endif
+
+/// \brief A group of tasks that is waited for with #task_sync().
+///
+/// Every core counts the tasks it spawned and the tasks it finished, so
+/// the counters are updated without a lock.
+typedef struct {
+  /// \cond PRIVATE
+  volatile int spawned[MAX_CORES];
+  volatile int done[MAX_CORES];
+  /// \endcond
+} task_group_t;
+
+/// \brief Start the workers on all cores except #NOC_MASTER.
+///
+/// The function is called once by #NOC_MASTER before the first task is
+/// spawned. The slave cores are not available for #corethread_create()
+/// until #task_exit() is called.
+///
+/// \retval 0 The workers were started.
+/// \retval EAGAIN A core is already running a corethread.
+int task_init(void);
+
+/// \brief Stop the workers and wait for them to terminate.
+///
+/// All groups must have been synchronized before.
+void task_exit(void);
+
+/// \brief Initialize an empty task group.
+void task_group_init(task_group_t *group);
+
+/// \brief Spawn a task in a group.
+///
+/// \param group The group of the task.
+/// \param func The function of the task.
+/// \param arg The argument passed to func.
+void task_spawn(task_group_t *group, void (*func)(void *), void *arg);
+
+/// \brief Wait until all tasks of a group are done.
+///
+/// The calling core runs tasks while it waits.
+void task_sync(task_group_t *group);
+
+/// \brief Run a loop in parallel.
+///
+/// The range is split in halves until a part has at most grain
+/// iterations. The parts are run as tasks, body(first, last, arg) runs the
+/// iterations first to last-1. The function returns when all iterations
+/// are done.
+///
+/// \param first The first iteration.
+/// \param last One past the last iteration.
+/// \param grain The largest number of iterations in one task, at least 1.
+/// \param body The function running a part of the loop.
+/// \param arg The argument passed to body.
+void parallel_for(int first, int last, int grain,
+                  void (*body)(int, int, void *), void *arg);
+
+#endif /* _TASK_H_ */
+
+/** @}*/
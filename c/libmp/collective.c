@@ -39,174 +39,364 @@
 
 #include "mp.h"
 #include "mp_internal.h"
+#include "mp_loopbound.h"
 #include "include/debug.h"
 
+////////////////////////////////////////////////////////////////////////////
+// Layout of the communication area of a member
+////////////////////////////////////////////////////////////////////////////
+
+// Each member allocates one area in its own communication SPM:
+//
+//   epoch               The number of collective operations started so far
+//   flag[rounds]        Barrier flags, written by the dissemination partners
+//   buf                 The message buffer of the member
+//   red[rounds]         Partial results from the children in the reduction
+//   gather[count]       The all-gather slots, one per member
+//
+// Each message slot is msg_size bytes followed by a flag, which holds the
+// epoch of the operation that wrote the slot. A transfer writes the message
+// and its flag in one DMA, so the flag is the last word to arrive.
+
+static inline unsigned comm_slot_size(const communicator_t* comm) {
+  return comm->msg_size + FLAG_SIZE;
+}
+
+static inline volatile barrier_t _SPM * comm_epoch(volatile void _SPM * area) {
+  return (volatile barrier_t _SPM *)area;
+}
+
+static inline volatile barrier_t _SPM * comm_flag(volatile void _SPM * area,
+                                                  const unsigned round) {
+  return (volatile barrier_t _SPM *)((unsigned)area + (1+round)*BARRIER_SIZE);
+}
+
+static inline volatile void _SPM * comm_buf(const communicator_t* comm,
+                                            volatile void _SPM * area) {
+  return (volatile void _SPM *)((unsigned)area + (1+comm->rounds)*BARRIER_SIZE);
+}
+
+static inline volatile void _SPM * comm_red(const communicator_t* comm,
+                                            volatile void _SPM * area,
+                                            const unsigned round) {
+  return (volatile void _SPM *)((unsigned)comm_buf(comm,area)
+                                + (1+round)*comm_slot_size(comm));
+}
+
+static inline volatile void _SPM * comm_gather(const communicator_t* comm,
+                                               volatile void _SPM * area,
+                                               const unsigned index) {
+  return (volatile void _SPM *)((unsigned)comm_buf(comm,area)
+                                + (1+comm->rounds+index)*comm_slot_size(comm));
+}
+
+// The flag at the end of a message slot
+static inline volatile barrier_t _SPM * comm_slot_flag(const communicator_t* comm,
+                                                       volatile void _SPM * slot) {
+  return (volatile barrier_t _SPM *)((unsigned)slot + comm->msg_size);
+}
+
+static inline size_t comm_area_size(const communicator_t* comm) {
+  return (1+comm->rounds)*BARRIER_SIZE
+         + (1+comm->rounds+comm->count)*comm_slot_size(comm);
+}
+
 ////////////////////////////////////////////////////////////////////////////
 // Function for initializing collective behavior
 ////////////////////////////////////////////////////////////////////////////
 
 int mp_communicator_init(communicator_t* comm, const unsigned int count,
               const coreid_t member_ids [], const unsigned int msg_size) {
-  return 0;
-}
-
-// Communicator cannot be initialized, initialization scheme needs to be re-written
-//int mp_communicator_init(communicator_t* comm, unsigned count,
-//              const coreid_t member_ids [], unsigned msg_size) {
-//  if (get_cpuid() != NOC_MASTER) {
-//    return 0;
-//  }
-//  comm->count = count;
-//  comm->msg_size = msg_size;
-//  comm->addr = (volatile void _SPM **) malloc(sizeof(void*)*count);
-//
-//  TRACE(INFO,TRUE,"mp_communicator_init(): malloc size %lu\n",sizeof(void*)*count);
-//  
-//  coreset_clearall(&comm->barrier_set);
-//  for (int i = 0; i < count; ++i) {
-//    coreset_add(member_ids[i],&comm->barrier_set);
-//    comm->addr[i] = (volatile void _SPM *) mp_alloc(member_ids[i],count*BARRIER_SIZE+msg_size+FLAG_SIZE);
-//
-//
-//    if (get_cpuid() == member_ids[i]) {
-//      for (int j = 0; j < count; ++j) {
-//        *((volatile unsigned long long _SPM *)((unsigned)comm->addr[i] + (j*BARRIER_SIZE))) = BARRIER_INITIALIZED;
-//      }
-//      *((volatile unsigned long long _SPM *)((unsigned)comm->addr[i] + (count*BARRIER_SIZE) + msg_size)) = FLAG_INVALID;
-//    } else {      
-//      for (int j = 0; j < count; ++j) {
-//        noc_write(member_ids[i],
-//                (volatile int _SPM *)((unsigned)comm->addr[i] + (j*BARRIER_SIZE)),
-//                NOC_SPM_BASE,
-//                BARRIER_SIZE);
-//      }
-//      noc_write(member_ids[i],
-//              (volatile int _SPM *)((unsigned)comm->addr[i] + (count*BARRIER_SIZE) + msg_size),
-//              NOC_SPM_BASE,
-//              BARRIER_SIZE);
-//    }  
-//  }
-//  
-//  return 1;
-//}
+  // The communicator is shared by all members and written before the
+  // members know about each other, so it is only accessed uncached here.
+  volatile communicator_t _UNCACHED * ucomm = (volatile communicator_t _UNCACHED *)comm;
+  unsigned cpuid = get_cpuid();
+  unsigned index = count;
+
+  if (count == 0 || count > MAX_CORES) {
+    TRACE(FAILURE,TRUE,"mp_communicator_init(): bad member count %u\n",count);
+    return 0;
+  }
+
+  coreset_t set;
+  coreset_clearall(&set);
+  for (unsigned i = 0; i < count; ++i) {
+    coreset_add(member_ids[i],&set);
+    if ((unsigned)member_ids[i] == cpuid) {
+      index = i;
+    }
+  }
+  if (index == count) {
+    TRACE(FAILURE,TRUE,"mp_communicator_init(): core %u is not a member\n",cpuid);
+    return 0;
+  }
+
+  unsigned rounds = 0;
+  while ((1U << rounds) < count) {
+    rounds++;
+  }
+
+  // All members write the same values
+  ucomm->barrier_set = set;
+  ucomm->count = count;
+  ucomm->msg_size = WALIGN(msg_size);
+  ucomm->rounds = rounds;
+  for (unsigned i = 0; i < count; ++i) {
+    ucomm->member[i] = member_ids[i];
+    ucomm->index[(unsigned)member_ids[i]] = i;
+  }
+
+  size_t size = comm_area_size((const communicator_t *)comm);
+  volatile void _SPM * area = (volatile void _SPM *)mp_alloc(size);
+  if (area == NULL) {
+    TRACE(FAILURE,TRUE,"mp_communicator_init(): SPM out of memory\n");
+    return 0;
+  }
+  for (unsigned i = 0; i < size/sizeof(unsigned); ++i) {
+    ((volatile unsigned _SPM *)area)[i] = 0;
+  }
+  TRACE(INFO,TRUE,"mp_communicator_init(): index %u, area %x, size %lu\n",
+                                                index,(unsigned)area,size);
+
+  // Publish the area, the other members may write to it from now on
+  ucomm->addr[index] = area;
+  for (unsigned i = 0; i < count; ++i) {
+    while (ucomm->addr[i] == NULL) {
+      /* Spin until all members have registered */
+    }
+  }
+  // Drop any stale copy of the communicator from the data cache
+  inval_dcache();
+  return 1;
+}
 
 ////////////////////////////////////////////////////////////////////////////
 // Functions for collective behaviour
 ////////////////////////////////////////////////////////////////////////////
 
-//static void mp_barrier_int(communicator_t* comm, const unsigned int index){
-//  coreset_t barrier_set = comm->barrier_set;
-//  volatile void _SPM **addr_arr = (volatile void _SPM **)&comm->addr[0];
-//  unsigned local_addr = (unsigned)addr_arr[index];
-//  unsigned count = comm->count;
-//  volatile barrier_t _SPM * addr = (volatile barrier_t _SPM *)(local_addr +
-//                               index*BARRIER_SIZE);
-//  unsigned phase;
-//  switch(*addr){
-//    case BARRIER_PHASE_0:
-//      *addr = BARRIER_PHASE_1;
-//      phase = 1;
-//      break;
-//    case BARRIER_PHASE_1:
-//      *addr = BARRIER_PHASE_2;
-//      phase = 2;
-//      break;
-//    case BARRIER_PHASE_2:
-//      *addr = BARRIER_PHASE_3;
-//      phase = 3;
-//      break;
-//    case BARRIER_PHASE_3:
-//      *addr = BARRIER_PHASE_0;
-//      phase = 0;
-//      break;
-//  }
-//  unsigned local_val = (unsigned)addr + (phase & 1)*sizeof(unsigned);
-//  TRACE(INFO,TRUE,"\tBarrier phase\t%016llx\n\tPhase\t%d\n\tLocal val\t%08x@%08x\n",
-//            *addr,
-//            phase,
-//            *(volatile unsigned _SPM *)local_val,
-//            local_val);
-//  noc_multisend_cs(&barrier_set,addr_arr,index*BARRIER_SIZE,addr,BARRIER_SIZE);
-//  
-//  void * addr_a = (void*)local_addr;
-//  _Pragma("loopbound min 0 max 9")
-//  for(unsigned cpu_index = 0; cpu_index < count; cpu_index++) {
-//    unsigned remote_val = (unsigned)addr_a + cpu_index*BARRIER_SIZE+ (phase & 1)*sizeof(unsigned);
-//    TRACE(INFO,TRUE,"\t--------\n\tCPUIDX\t%u\n\tRemote val\t%08x@%08x\n",
-//              cpu_index,
-//              *(volatile unsigned _SPM *)remote_val,
-//              remote_val);
-//    unsigned comp = *(volatile unsigned _SPM *)local_val;
-//
-//    _Pragma("loopbound min 1 max 1")
-//    while (!(*(volatile unsigned _SPM *)remote_val == comp)) {
-//    }
-//    TRACE(INFO,TRUE,"\tBarrier reached\n");
-//    
-//  }
-//  return;
-//}
-
-//void mp_barrier(communicator_t* comm){
-//  //if(coreset_contains(get_cpuid(),&comm->barrier_set) == 0) {
-//  //  if(get_cpuid() == 0) {
-//  //    printf("mp_barrier(): Bad barrier call!!");
-//  //  }
-//  //}
-//  //DEBUG_CORECHECK(coreset_contains(get_cpuid(),&comm->barrier_set) != 0);
-//  // Something bad happens if mp_barrier() is called by a core
-//  // that is not in the communicator.
-//  unsigned index = 0;
-//  unsigned cpuid = get_cpuid();
-//  coreset_t barrier_set = comm->barrier_set;
-//  for (unsigned i = 0; i < get_cpucnt(); ++i) {
-//    if(coreset_contains(i,&barrier_set) != 0 && i < cpuid) {
-//      index++;
-//    }
-//  }
-//  DEBUGGER("mp_barrier():\n\tIndex\t%d\n",index);
-//  mp_barrier_int(comm,index);
-//  return;
-//}
-//
-//void mp_broadcast(communicator_t* comm, coreid_t root) {
-//  unsigned index = 0;
-//  for (unsigned i = 0; i < get_cpucnt(); ++i) {
-//    if(coreset_contains(i,&comm->barrier_set) != 0 && i < get_cpuid()) {
-//      index++;
-//    }
-//  }
-//  mp_barrier_int(comm,index);
-//  
-//
-//  volatile unsigned _SPM * flag_addr = (volatile unsigned _SPM*)(
-//                                  (unsigned)comm->addr[index]
-//                                           +comm->count*BARRIER_SIZE
-//                                           +comm->msg_size);
-//
-//  DEBUGGER("mp_broadcast():\n\tindex\t%d\n",index);
-//  DEBUGGER("\tflag_addr\t%x\n",(unsigned)flag_addr);
-//  
-//  if (get_cpuid() == root) {
-//    *flag_addr = FLAG_VALID;
-//    volatile unsigned _SPM * src_addr = (volatile unsigned _SPM*)(
-//                                  (unsigned)comm->addr[index]
-//                                           +comm->count*BARRIER_SIZE);
-//    DEBUGGER("\tsrc addr\t%08x\n\tflag val\t%08x\n",(unsigned)src_addr,(unsigned)(*flag_addr));
-//    noc_multisend_cs(&comm->barrier_set,
-//                     (volatile void _SPM **)comm->addr,
-//                     comm->count*BARRIER_SIZE,
-//                     (volatile void _SPM *)src_addr,
-//                     comm->msg_size+BARRIER_SIZE);
-//    noc_wait_dma(comm->barrier_set);
-//  } else {
-//
-//    _Pragma("loopbound min 1 max 1")
-//    while(!(*flag_addr == FLAG_VALID)) {
-//      /* Spin */
-//      DEBUGGER("\tflag value %08x\n",(unsigned)*flag_addr);
-//    }
-//  }
-//  *flag_addr = FLAG_INVALID;
-//  return;
-//}
\ No newline at end of file
+// Dissemination barrier. In round r each member signals the member 2^r
+// positions ahead and waits for the one 2^r positions behind, so all members
+// have arrived after ceil(log2(count)) rounds. The flags are never reset,
+// each barrier writes the next epoch. Returns the epoch of the barrier.
+static barrier_t mp_barrier_int(const communicator_t* comm, const unsigned index,
+                                volatile void _SPM * area) {
+  unsigned count = comm->count;
+  unsigned rounds = comm->rounds;
+  volatile barrier_t _SPM * epoch = comm_epoch(area);
+
+  // The signals of the previous barrier read the epoch, so they must be
+  // sent before it changes
+  #pragma loopbound min 0 max COMM_ROUNDS
+  for (unsigned r = 0; r < rounds; ++r) {
+    unsigned peer = index + (1U << r);
+    if (peer >= count) {
+      peer -= count;
+    }
+    _Pragma("loopbound min 1 max 1")
+    while (!noc_dma_done((unsigned char)comm->member[peer])) {
+      /* Spin */
+    }
+  }
+
+  barrier_t e = *epoch + 1;
+  *epoch = e;
+
+  #pragma loopbound min 0 max COMM_ROUNDS
+  for (unsigned r = 0; r < rounds; ++r) {
+    unsigned peer = index + (1U << r);
+    if (peer >= count) {
+      peer -= count;
+    }
+    noc_write((unsigned char)comm->member[peer], comm_flag(comm->addr[peer],r),
+              epoch, BARRIER_SIZE, 0);
+    // A fast partner may already be in the next barrier
+    volatile barrier_t _SPM * flag = comm_flag(area,r);
+    _Pragma("loopbound min 1 max 1")
+    while ((int)(*flag - e) < 0) {
+      /* Spin */
+    }
+  }
+  return e;
+}
+
+// Wait until all transfers to a member have finished
+static inline void comm_wait_dma(const communicator_t* comm, const unsigned index) {
+  _Pragma("loopbound min 1 max 1")
+  while (!noc_dma_done((unsigned char)comm->member[index])) {
+    /* Spin */
+  }
+}
+
+static inline unsigned comm_index(const communicator_t* comm) {
+  return comm->index[get_cpuid()];
+}
+
+void mp_barrier(communicator_t* comm) {
+  unsigned index = comm_index(comm);
+  mp_barrier_int(comm,index,comm->addr[index]);
+}
+
+// Broadcast along a binomial tree rooted in the root core. The member with
+// relative index rel receives from rel - lsb(rel) and forwards to rel + 2^k
+// for all 2^k < lsb(rel). The barrier in front makes sure that no member
+// still uses the message of the previous operation.
+void mp_broadcast(communicator_t* comm, const coreid_t root) {
+  unsigned index = comm_index(comm);
+  unsigned count = comm->count;
+  unsigned root_index = comm->index[(unsigned)root];
+  volatile void _SPM * area = comm->addr[index];
+  volatile void _SPM * buf = comm_buf(comm,area);
+  volatile barrier_t _SPM * flag = comm_slot_flag(comm,buf);
+
+  barrier_t e = mp_barrier_int(comm,index,area);
+
+  unsigned rel = index >= root_index ? index - root_index : index + count - root_index;
+  unsigned mask;
+  if (rel == 0) {
+    mask = 1U << comm->rounds;
+    *flag = e;
+  } else {
+    mask = rel & -rel;
+    _Pragma("loopbound min 1 max 1")
+    while (*flag != e) {
+      /* Spin until the message from the parent has arrived */
+    }
+  }
+
+  unsigned first = mask >> 1;
+  #pragma loopbound min 0 max COMM_ROUNDS
+  for (mask = first; mask > 0; mask >>= 1) {
+    if (rel + mask < count) {
+      unsigned child = index + mask;
+      if (child >= count) {
+        child -= count;
+      }
+      noc_write((unsigned char)comm->member[child], comm_buf(comm,comm->addr[child]),
+                buf, comm_slot_size(comm), 0);
+    }
+  }
+  // The caller may change the buffer after the return
+  #pragma loopbound min 0 max COMM_ROUNDS
+  for (mask = first; mask > 0; mask >>= 1) {
+    if (rel + mask < count) {
+      unsigned child = index + mask;
+      if (child >= count) {
+        child -= count;
+      }
+      comm_wait_dma(comm,child);
+    }
+  }
+}
+
+static inline void comm_combine(volatile int _SPM * acc, volatile int _SPM * val,
+                                const unsigned words, const reduce_op_t op) {
+  #pragma loopbound min 0 max MSG_SIZE_WORDS
+  for (unsigned i = 0; i < words; ++i) {
+    int a = acc[i];
+    int b = val[i];
+    switch (op) {
+      case REDUCE_SUM: a = a + b; break;
+      case REDUCE_MIN: a = b < a ? b : a; break;
+      case REDUCE_MAX: a = b > a ? b : a; break;
+      case REDUCE_AND: a = a & b; break;
+      case REDUCE_OR:  a = a | b; break;
+    }
+    acc[i] = a;
+  }
+}
+
+// Reduction along the binomial tree of #mp_broadcast(), in the opposite
+// direction. In round r the members with bit r set in rel send their partial
+// result to rel - 2^r and are done, the others combine the partial result of
+// rel + 2^r into their buffer.
+void mp_reduce(communicator_t* comm, const coreid_t root, const reduce_op_t op) {
+  unsigned index = comm_index(comm);
+  unsigned count = comm->count;
+  unsigned root_index = comm->index[(unsigned)root];
+  volatile void _SPM * area = comm->addr[index];
+  volatile void _SPM * buf = comm_buf(comm,area);
+  unsigned words = comm->msg_size / sizeof(int);
+
+  barrier_t e = mp_barrier_int(comm,index,area);
+
+  unsigned rel = index >= root_index ? index - root_index : index + count - root_index;
+  #pragma loopbound min 0 max COMM_ROUNDS
+  for (unsigned r = 0; r < comm->rounds; ++r) {
+    unsigned mask = 1U << r;
+    if (rel & mask) {
+      unsigned parent = index >= mask ? index - mask : index + count - mask;
+      *comm_slot_flag(comm,buf) = e;
+      noc_write((unsigned char)comm->member[parent],
+                comm_red(comm,comm->addr[parent],r),
+                buf, comm_slot_size(comm), 0);
+      comm_wait_dma(comm,parent);
+      break;
+    }
+    if (rel + mask < count) {
+      volatile void _SPM * part = comm_red(comm,area,r);
+      volatile barrier_t _SPM * part_flag = comm_slot_flag(comm,part);
+      _Pragma("loopbound min 1 max 1")
+      while (*part_flag != e) {
+        /* Spin until the partial result of the child has arrived */
+      }
+      comm_combine((volatile int _SPM *)buf,(volatile int _SPM *)part,words,op);
+    }
+  }
+}
+
+// Every member writes its buffer directly into its slot at all other
+// members. The NoC has a dedicated channel between each pair of cores, so
+// the count-1 transfers of a member proceed in parallel.
+void mp_allgather(communicator_t* comm) {
+  unsigned index = comm_index(comm);
+  unsigned count = comm->count;
+  volatile void _SPM * area = comm->addr[index];
+  volatile void _SPM * buf = comm_buf(comm,area);
+  unsigned words = comm_slot_size(comm) / sizeof(int);
+
+  barrier_t e = mp_barrier_int(comm,index,area);
+  *comm_slot_flag(comm,buf) = e;
+
+  // Start with the next member, so not all members send to the same
+  // member first
+  #pragma loopbound min 0 max COMM_MEMBERS
+  for (unsigned i = 1; i < count; ++i) {
+    unsigned peer = index + i;
+    if (peer >= count) {
+      peer -= count;
+    }
+    noc_write((unsigned char)comm->member[peer], comm_gather(comm,comm->addr[peer],index),
+              buf, comm_slot_size(comm), 0);
+  }
+
+  volatile int _SPM * own = (volatile int _SPM *)comm_gather(comm,area,index);
+  #pragma loopbound min 0 max MSG_SIZE_WORDS
+  for (unsigned i = 0; i < words; ++i) {
+    own[i] = ((volatile int _SPM *)buf)[i];
+  }
+
+  #pragma loopbound min 0 max COMM_MEMBERS
+  for (unsigned i = 0; i < count; ++i) {
+    volatile barrier_t _SPM * flag = comm_slot_flag(comm,comm_gather(comm,area,i));
+    _Pragma("loopbound min 1 max 1")
+    while (*flag != e) {
+      /* Spin until the message of member i has arrived */
+    }
+  }
+  #pragma loopbound min 0 max COMM_MEMBERS
+  for (unsigned i = 1; i < count; ++i) {
+    unsigned peer = index + i;
+    if (peer >= count) {
+      peer -= count;
+    }
+    comm_wait_dma(comm,peer);
+  }
+}
+
+volatile void _SPM * mp_comm_buf(communicator_t* comm) {
+  return comm_buf(comm,comm->addr[comm_index(comm)]);
+}
+
+volatile void _SPM * mp_allgather_slot(communicator_t* comm, const unsigned index) {
+  return comm_gather(comm,comm->addr[comm_index(comm)],index);
+}
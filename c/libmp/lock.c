@@ -41,63 +41,147 @@
 #include "mp_internal.h"
 #include "mp_loopbound.h"
 
-LOCK_T * initialize_lock(unsigned remote) {
-    LOCK_T * lock = (LOCK_T *)mp_alloc(sizeof(LOCK_T));
-    lock->remote_entering = 0;
-    lock->remote_number = 0;
+// Allocate a copy of the lock with count member entries
+static LOCK_T * lock_alloc(unsigned count) {
+    LOCK_T * lock = (LOCK_T *)mp_alloc(sizeof(LOCK_T) + count*sizeof(lock_member_t));
+    if (lock == NULL) {
+      return NULL;
+    }
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      lock->member[i].entering = 0;
+      lock->member[i].number = 0;
+      lock->member[i].ptr = NULL;
+      lock->member[i].cpuid = 0;
+    }
     lock->local_entering = 0;
-    lock->local_number = 0;  
-    lock->remote_cpuid = remote;
+    lock->local_number = 0;
+    lock->count = count;
+    return lock;
+}
+
+LOCK_T * initialize_lock(unsigned remote) {
+    LOCK_T * lock = lock_alloc(2);
+    if (lock == NULL) {
+      return NULL;
+    }
+    lock_set_remote(lock, remote, NULL);
+    return lock;
+}
+
+void lock_set_remote(LOCK_T * lock, unsigned remote, LOCK_T * remote_ptr) {
+    // The core with the lower id has rank 0
+    unsigned id = get_cpuid();
+    unsigned rank = id < remote ? 0 : 1;
+    lock->rank = rank;
+    lock->member[rank].cpuid = id;
+    lock->member[rank].ptr = lock;
+    lock->member[1-rank].cpuid = remote;
+    lock->member[1-rank].ptr = remote_ptr;
+}
+
+LOCK_T * initialize_lock_group(lock_group_t * group, const unsigned int count,
+                               const coreid_t member_ids []) {
+    // The group is written before the members know about each other,
+    // so it is only accessed uncached
+    LOCK_T * volatile _UNCACHED * addr = (LOCK_T * volatile _UNCACHED *)group->addr;
+    unsigned id = get_cpuid();
+    unsigned rank = count;
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      if ((unsigned)member_ids[i] == id) {
+        rank = i;
+      }
+    }
+    if (count > LOCK_MAX_CORES || rank == count) {
+      TRACE(FAILURE,TRUE,"initialize_lock_group(): core %u is not a member\n",id);
+      return NULL;
+    }
+    LOCK_T * lock = lock_alloc(count);
+    if (lock == NULL) {
+      return NULL;
+    }
+    lock->rank = rank;
+
+    // Publish the local copy and wait for the others
+    addr[rank] = lock;
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      while (addr[i] == NULL) {
+        /* Spin until all members have created their copy */
+      }
+      lock->member[i].ptr = addr[i];
+      lock->member[i].cpuid = member_ids[i];
+    }
     return lock;
 }
 
+// Write a word of the local copy to the same field of the copy at all
+// other cores. The writes to different cores use different DMAs and
+// proceed in parallel. The function returns when all writes are sent.
+static void lock_multicast(LOCK_T * lock, volatile unsigned int _SPM * field,
+                           volatile unsigned int _SPM * src) {
+    unsigned offset = (unsigned)field - (unsigned)lock;
+    unsigned count = lock->count;
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      if (i != lock->rank) {
+        noc_write(lock->member[i].cpuid,
+                  (void _SPM *)((unsigned)lock->member[i].ptr + offset),
+                  (void _SPM *)src,
+                  sizeof(unsigned int),
+                  0);
+      }
+    }
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      if (i != lock->rank) {
+        #pragma loopbound min PKT_TRANS_WAIT max PKT_TRANS_WAIT
+        while(!noc_dma_done(lock->member[i].cpuid));
+      }
+    }
+}
+
 void acquire_lock(LOCK_T * lock){
+    unsigned rank = lock->rank;
+    unsigned count = lock->count;
+
     /* Write Entering true */
-    /* Write Number */
-    unsigned remote = lock->remote_cpuid;
-    unsigned id = get_cpuid();
     lock->local_entering = 1;
-    
-    noc_write(remote,
-              (void _SPM *)&(lock->remote_ptr->remote_entering),
-              (void _SPM *)&lock->local_entering,
-              sizeof(lock->local_entering),
-              0);
-
-    //#pragma loopbound min 1 max 2
-    #pragma loopbound min PKT_TRANS_WAIT max PKT_TRANS_WAIT
-    while(!noc_dma_done(remote));
-    unsigned n = (unsigned)lock->remote_number + 1;
+    lock_multicast(lock, &lock->member[rank].entering, &lock->local_entering);
+
+    /* Take a ticket larger than all others */
+    unsigned n = 0;
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      unsigned m = lock->member[i].number;
+      if (i != rank && m > n) {
+        n = m;
+      }
+    }
+    n++;
     lock->local_number = n;
-    /* Enforce memory barrier */
-    noc_write(remote,
-              (void _SPM *)&(lock->remote_ptr->remote_number),
-              (void _SPM *)&lock->local_number,
-              sizeof(lock->local_number),
-              0);
-
-//    /* Enforce memory barrier */
-    #pragma loopbound min PKT_TRANS_WAIT max PKT_TRANS_WAIT
-    while(!noc_dma_done(remote)); // noc_write() also waits for the dma to be
-                                // free, so no need to do it here as well
+    lock_multicast(lock, &lock->member[rank].number, &lock->local_number);
 
     /* Write Entering false */
     lock->local_entering = 0;
-    noc_write(remote,
-              (void _SPM *)&(lock->remote_ptr->remote_entering),
-              (void _SPM *)&lock->local_entering,
-              sizeof(lock->local_entering),
-              0);
-
-    /* Wait for remote core not to change number */
-    #pragma loopbound min 1 max 2
-    while(lock->remote_entering == 1);
-    /* Wait to be the first in line to the bakery queue */
-    unsigned m = lock->remote_number;
-    #pragma loopbound min 1 max 2
-    while( (m != 0) &&
-            ( (m < n) || ((m == n) && ( remote < id)))) {
-      m = lock->remote_number;
+    lock_multicast(lock, &lock->member[rank].entering, &lock->local_entering);
+
+    /* Wait for all cores with a smaller ticket, in order of the ranks */
+    #pragma loopbound min 2 max LOCK_MAX_CORES
+    for (unsigned i = 0; i < count; ++i) {
+      if (i == rank) {
+        continue;
+      }
+      /* Wait for the core not to change its number */
+      #pragma loopbound min 1 max 2
+      while(lock->member[i].entering == 1);
+      unsigned m = lock->member[i].number;
+      #pragma loopbound min 1 max 2
+      while( (m != 0) &&
+              ( (m < n) || ((m == n) && (i < rank)))) {
+        m = lock->member[i].number;
+      }
     }
     /* Lock is grabbed */  
     return;
@@ -106,14 +190,7 @@ void acquire_lock(LOCK_T * lock){
 void release_lock(LOCK_T * lock) {
     /* Write Number */
     lock->local_number = 0;
-    noc_write(lock->remote_cpuid,
-              (void _SPM *)&(lock->remote_ptr->remote_number),
-              (void _SPM *)&lock->local_number,
-              sizeof(lock->local_number),
-              0);
-    /* Enforce memory barrier */
-    #pragma loopbound min PKT_TRANS_WAIT max PKT_TRANS_WAIT
-    while(!noc_dma_done(lock->remote_cpuid));
+    lock_multicast(lock, &lock->member[lock->rank].number, &lock->local_number);
     /* Lock is freed */  
     return;
 }
@@ -148,8 +148,8 @@ int mp_init_ports() {
         chan_info[chan_id].src_qpd_ptr->remote = chan_info[chan_id].sink_id;
       } else if (chan_info[chan_id].port_type == SAMPLING) {
         chan_info[chan_id].src_spd_ptr->remote = chan_info[chan_id].sink_id;
-        chan_info[chan_id].src_spd_ptr->lock->remote_cpuid = chan_info[chan_id].sink_id;
-        chan_info[chan_id].src_spd_ptr->lock->remote_ptr = (LOCK_T *)chan_info[chan_id].sink_lock;
+        lock_set_remote(chan_info[chan_id].src_spd_ptr->lock, chan_info[chan_id].sink_id,
+                        (LOCK_T *)chan_info[chan_id].sink_lock);
         chan_info[chan_id].src_spd_ptr->read_bufs = chan_info[chan_id].sink_addr;
         chan_info[chan_id].src_spd_ptr->remote_spd = chan_info[chan_id].sink_spd_ptr;
         TRACE(INFO,TRUE,"SRC spd ptr: %#08x\n",(int)chan_info[chan_id].src_spd_ptr);
@@ -168,8 +168,8 @@ int mp_init_ports() {
         chan_info[chan_id].sink_qpd_ptr->remote = chan_info[chan_id].src_id;
       } else if (chan_info[chan_id].port_type == SAMPLING) {
         chan_info[chan_id].sink_spd_ptr->remote = chan_info[chan_id].src_id;
-        chan_info[chan_id].sink_spd_ptr->lock->remote_cpuid = chan_info[chan_id].src_id;
-        chan_info[chan_id].sink_spd_ptr->lock->remote_ptr = (LOCK_T *)chan_info[chan_id].src_lock;
+        lock_set_remote(chan_info[chan_id].sink_spd_ptr->lock, chan_info[chan_id].src_id,
+                        (LOCK_T *)chan_info[chan_id].src_lock);
         chan_info[chan_id].sink_spd_ptr->read_shm_buf = (volatile void * _SPM)chan_info[chan_id].src_addr;
         chan_info[chan_id].sink_spd_ptr->remote_spd = chan_info[chan_id].src_spd_ptr;
         TRACE(INFO,TRUE,"SINK spd ptr: %#08x\n",(int)chan_info[chan_id].sink_spd_ptr);
@@ -80,21 +80,71 @@ typedef char coreid_t;
 
 typedef enum {SOURCE, SINK} direction_t;
 
+/// \brief The maximum number of cores that can share a lock.
+#ifndef LOCK_MAX_CORES
+#define LOCK_MAX_CORES 16
+#endif
+
 /// \struct LOCK_T
 /// \brief Lock type placed in local scratchpad memory
+///
+/// The lock is a bakery lock between the cores that share it. Each core
+/// has a copy of the lock in its own scratchpad, the other cores write
+/// their entering flags and ticket numbers into it, so all waiting is
+/// done on local memory. A copy is allocated with one member entry per
+/// core that shares the lock.
 struct _SPM_LOCK_T; // forward decl
 typedef struct _SPM_LOCK_T _SPM LOCK_T;
+
+/// \struct lock_member_t
+/// \brief The state of one core sharing a lock
+typedef struct {
+  /** Entering flag and ticket number of the core */
+  volatile unsigned int entering;
+  volatile unsigned int number;
+  /** The copy of the lock at the core */
+  LOCK_T * ptr;
+  /** The core id */
+  unsigned int cpuid;
+} lock_member_t;
+
 struct _SPM_LOCK_T {
-  volatile unsigned int remote_entering;
-  volatile unsigned int remote_number;
   unsigned int local_entering;
   unsigned int local_number;
-  //struct _SPM_LOCK_T _SPM * remote_ptr;
-  LOCK_T * remote_ptr;
-  unsigned char remote_cpuid;
+  /** The number of cores sharing the lock */
+  unsigned char count;
+  /** The rank of the local core, ties between equal tickets are broken
+   * by the rank */
+  unsigned char rank;
+  /** The cores sharing the lock, indexed by rank */
+  lock_member_t member[];
 };
 
+/// \struct lock_group_t
+/// \brief Struct for exchanging the lock addresses of the cores that
+/// share a lock. It must be a zero-initialized global variable.
+typedef struct {
+  LOCK_T * addr[LOCK_MAX_CORES];
+} lock_group_t;
+
+/// \brief Create a lock shared with one remote core. The address of the
+/// remote copy is exchanged by #mp_init_ports().
 LOCK_T * initialize_lock(unsigned remote);
+
+/// \brief Create a lock shared by a group of cores.
+///
+/// All members call the function with the same arguments.
+///
+/// \param group A pointer to the shared group struct.
+/// \param count The number of members, at most #LOCK_MAX_CORES.
+/// \param member_ids An array of member ids.
+///
+/// \returns The local copy of the lock when all members have created
+/// theirs, or NULL if the calling core is not a member or the SPM is out
+/// of memory.
+LOCK_T * initialize_lock_group(lock_group_t * group, const unsigned int count,
+                               const coreid_t member_ids []);
+
 void acquire_lock(LOCK_T * lock) INLINING;
 void release_lock(LOCK_T * lock) INLINING;
 
@@ -120,6 +170,9 @@ struct _qpd_t {
   unsigned int buf_size;
   /** The number of buffers at the receiver */
   unsigned int num_buf;
+  /** The port in the opposite direction to the same remote core, whose
+   * acknowledgements travel in the flags of this port, see #mp_pair_qports() */
+  qpd_t * credit_port;
   /** The following fields depend on the direction of the port */
   union {
     /** Sender specific fields */
@@ -132,6 +185,20 @@ struct _qpd_t {
       unsigned int send_count;
       /** A pointer to the tail of the receiving queue */
       unsigned int send_ptr;
+      /** The number of buffers in the local send ring */
+      unsigned int num_send_buf;
+      /** The first buffer of the local send ring */
+      volatile void _SPM * send_ring;
+      /** The number of buffers reserved and committed by the sender */
+      unsigned int reserve_count;
+      unsigned int commit_count;
+      /** Local ring indices of the next buffer to reserve, commit and send */
+      unsigned int reserve_ptr;
+      unsigned int commit_ptr;
+      unsigned int dma_ptr;
+      /** The receive count of the receiver as carried by the flags of
+       * the paired port */
+      unsigned int piggy_recv_count;
     };
     /** Recevier specific fields */
     struct {
@@ -141,11 +208,72 @@ struct _qpd_t {
       volatile unsigned int _SPM * recv_count;
       /** A pointer to the head of the receiving queue */
       unsigned int recv_ptr;
+      /** The number of messages received */
+      unsigned int recv_msgs;
+      /** The number of acknowledgements not yet sent to the sender */
+      unsigned int ack_pending;
+      /** Acknowledgements are sent when this many are pending */
+      unsigned int ack_batch;
+      /** Acknowledgements are sent when the sender sees at most this many
+       * free buffers */
+      unsigned int ack_watermark;
     };
   };
 
 };
 
+/// \brief The implementations of the sampling ports.
+///
+/// The values are the same as those of the former compile time option
+/// IMPL, which now only selects the default of #mp_create_sport().
+typedef enum {
+  /** One buffer in shared memory, read and written under the lock */
+  SPORT_SINGLE_SHM            = 0,
+  /** One buffer at the reader, written under the lock */
+  SPORT_SINGLE_NOC            = 1,
+  /** Two buffers at the reader, the sample is written before the lock is
+   * taken */
+  SPORT_DOUBLE_NOC            = 2,
+  /** Three buffers at the reader, the lock is only held while the newest
+   * buffer is updated */
+  SPORT_TRIPLE_NOC            = 3,
+  /** Three buffers at the reader, without a lock */
+  SPORT_MULTI_NOC_NONBLOCKING = 4,
+  /** A queuing port with three buffers */
+  SPORT_MULTI_NOC_MP          = 5,
+  /** Two buffers at the reader, the writer writes the buffer not being
+   * read under the lock */
+  SPORT_DOUBLE_NOC_WR         = 6,
+  /** Chosen by #mp_sport_impl() from the sample size */
+  SPORT_AUTO                  = 7
+} sport_impl_t;
+
+/// \brief The largest sample in bytes for which #mp_sport_impl() chooses
+/// #SPORT_SINGLE_NOC.
+#ifndef SPORT_SMALL_SAMPLE
+#define SPORT_SMALL_SAMPLE 32
+#endif
+
+/// \brief The names of the former compile time option IMPL, aliases of
+/// the #sport_impl_t values that can be used in preprocessor conditions.
+#define SINGLE_SHM              0
+#define SINGLE_NOC              1
+#define DOUBLE_NOC              2
+#define TRIPLE_NOC              3
+#define MULTI_NOC_NONBLOCKING   4
+#define MULTI_NOC_MP            5
+#define DOUBLE_NOC_WR           6
+
+#ifndef IMPL
+#define IMPL DOUBLE_NOC
+#endif
+
+/// \brief The implementation used by #mp_create_sport(). It is IMPL
+/// unless a build opts in to #SPORT_AUTO or another implementation.
+#ifndef SPORT_DEFAULT_IMPL
+#define SPORT_DEFAULT_IMPL ((sport_impl_t)IMPL)
+#endif
+
 /// \struct spd_t
 /// \brief Sample port descriptor.
 ///
@@ -170,6 +298,10 @@ struct _spd_t {
   unsigned int sample_size;
   /** Pointer to lock*/
   LOCK_T * lock;
+  /** The implementation of the port */
+  sport_impl_t impl;
+  /** The queuing port carrying the samples of #SPORT_MULTI_NOC_MP */
+  qpd_t * qport;
 
   int padding;
   /** The following fields depend on the direction of the port */
@@ -200,15 +332,29 @@ struct _spd_t {
 /// \brief Describes at set of communicating processors.
 ///
 /// The struct is used to store all necessary information on the set of
-/// communicating processors.
-typedef struct {
+/// communicating processors. The struct is padded to a multiple of 16
+/// bytes, so communicators can be placed in arrays.
+typedef struct __attribute__((aligned(16))) {
+  /** The set of member cores */
   coreset_t barrier_set;
+  /** The number of members */
   unsigned int count;
+  /** The size of the message buffer of each member, in bytes */
   unsigned int msg_size;
-  volatile void _SPM ** addr;
-} communicator_t __attribute__((aligned(16)));
+  /** The number of rounds of the barrier, ceil(log2(count)) */
+  unsigned int rounds;
+  /** The core id of each member, indexed by member index */
+  coreid_t member[MAX_CORES];
+  /** The member index of each core, indexed by core id */
+  unsigned char index[MAX_CORES];
+  /** The communication area of each member, indexed by member index */
+  volatile void _SPM * addr[MAX_CORES];
+} communicator_t;
 /// \endcond
 
+/// \brief The operations supported by #mp_reduce(). They operate on the
+/// message buffers as arrays of int.
+typedef enum {REDUCE_SUM, REDUCE_MIN, REDUCE_MAX, REDUCE_AND, REDUCE_OR} reduce_op_t;
 
 ////////////////////////////////////////////////////////////////////////////
 // Functions for memory management in the communication SPM
@@ -243,6 +389,23 @@ void _SPM * mp_alloc(const size_t size) __attribute__ ((noinline));
 qpd_t * mp_create_qport( const unsigned int chan_id, const direction_t direction_type,
                          const size_t msg_size, const size_t num_buf);
 
+/// \brief Initialize the state of a communication channel with a ring of
+/// send buffers for #mp_reserve() and #mp_commit().
+///
+/// At the SINK this is the same as #mp_create_qport().
+///
+/// \param qpd_ptr A pointer the the message passing descriptor
+/// \param remote The core id of the remote processor
+/// \param buf_size The size of the message buffer
+/// \param num_buf The number of buffers in the receiving scratchpad
+/// \param num_send_buf The number of buffers in the sending scratchpad
+///
+/// \return The function returns a pointer to the created message passing
+/// descriptor #qpd_t. If the function fails, the pointer is NULL.
+qpd_t * mp_create_qport_ring(const unsigned int chan_id, const direction_t direction_type,
+                         const size_t msg_size, const size_t num_buf,
+                         const size_t num_send_buf);
+
 /// \brief Initialize the state of a communication channel
 ///
 /// \param qpd_ptr A pointer the the message passing descriptor
@@ -256,24 +419,50 @@ qpd_t * mp_create_qport( const unsigned int chan_id, const direction_t direction
 spd_t * mp_create_sport(const unsigned int chan_id, const direction_t direction_type,
                         const size_t sample_size);
 
+/// \brief Create a sampling port with a given implementation.
+///
+/// Both ends of the channel must use the same implementation. The
+/// implementations differ in the number of buffers at the reader and in
+/// the work done while the lock is held, the benchmark in
+/// cmp/mp_sport_bench.c measures them for different sample sizes.
+///
+/// \param impl The implementation, #SPORT_AUTO lets #mp_sport_impl()
+/// choose from the sample size.
+///
+/// \return The function returns a pointer to the created sampling port
+/// descriptor #spd_t. If the function fails, the pointer is NULL.
+spd_t * mp_create_sport_impl(const unsigned int chan_id, const direction_t direction_type,
+                        const size_t sample_size, sport_impl_t impl);
+
+/// \brief The implementation chosen for #SPORT_AUTO.
+///
+/// The choice only depends on the sample size, so both ends of a channel
+/// make the same choice. The remote core is not known before
+/// #mp_init_ports().
+sport_impl_t mp_sport_impl(const size_t sample_size);
+
 /// \breif Initializing all the channels that have been registered.
 ///
 /// \retval 0 The initialization of one or more communication channels failed.
 /// \retval 1 The initialization of all the communication channels succeeded.
 int mp_init_ports();
 
-/// \cond PRIVATE
 /// \brief Initialize the communicator
 ///
+/// All members call the function with the same arguments on the same
+/// communicator, which must be a zero-initialized global variable. Each
+/// member allocates its communication area in its own communication SPM.
+///
 /// \param comm A pointer to the communicator structure
+/// \param count The number of members.
 /// \param member_ids An array of member ids.
-/// \param member_addrs An array of COM SPM addresses for the members.
+/// \param msg_size The size of the message buffer of each member, in bytes.
 ///
-/// \retval 0 The address is not aligned  to words.
+/// \retval 0 The calling core is not a member or the SPM is out of memory.
 /// \retval 1 The initialization of the communicator_t succeeded.
+/// \returns The function returns when all members have been initialized.
 int mp_communicator_init(communicator_t* comm, const unsigned int count,
               const coreid_t member_ids [], const unsigned int msg_size);
-/// \endcond
 ////////////////////////////////////////////////////////////////////////////
 // Functions for queuing point-to-point transmission of data
 ////////////////////////////////////////////////////////////////////////////
@@ -305,6 +494,53 @@ int mp_nbsend(qpd_t * qpd_ptr) INLINING  ;
 /// \retval 1 The function succeeded sending the message.
 int mp_send(qpd_t * qpd_ptr, const unsigned int time_usecs) INLINING ;
 
+/// \brief Non-blocking function for reserving a send buffer of a port
+/// created with #mp_create_qport_ring(). The message is written in place
+/// into the returned buffer and handed to the NoC with #mp_commit().
+/// Buffers are committed in the order they were reserved. The function
+/// must not be mixed with #mp_nbsend() on the same port.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+///
+/// \returns A pointer to a buffer of buf_size bytes, or NULL if all
+/// buffers of the send ring are reserved or in flight.
+volatile void _SPM * mp_reserve(qpd_t * qpd_ptr);
+
+/// \brief Non-blocking function for committing the oldest reserved buffer.
+/// The transfer starts at once if the DMA is free and the receiver has
+/// space, otherwise it is started by a later call to #mp_reserve(),
+/// #mp_commit() or #mp_nbflush(). The function does not wait for the
+/// transfer of the previous message.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+///
+/// \retval 0 No buffer was reserved.
+/// \retval 1 The buffer has been committed.
+int mp_commit(qpd_t * qpd_ptr);
+
+/// \brief Non-blocking function for starting the transfer of the next
+/// committed buffer.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+///
+/// \retval 0 There are committed buffers that have not been sent yet.
+/// \retval 1 All committed buffers have been sent.
+int mp_nbflush(qpd_t * qpd_ptr);
+
+/// \brief A function for sending all committed buffers.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+/// \param time_usecs The time out time in microseconds, if parameter is 0
+/// the timeout is infinite
+///
+/// \retval 0 The function timed out.
+/// \retval 1 All committed buffers have been sent.
+int mp_flush(qpd_t * qpd_ptr, const unsigned int time_usecs);
+
 /// \brief Non-blocking function for receiving a message from a remote processor
 /// under flow control. The data that is received is placed in a message buffer
 /// in the communication scratch pad, when the received message is no
@@ -319,6 +555,18 @@ int mp_send(qpd_t * qpd_ptr, const unsigned int time_usecs) INLINING ;
 /// followed by a call to #mp_ack() when the data is no longer used.
 int mp_nbrecv(qpd_t * qpd_ptr)  INLINING ;
 
+/// \brief Non-blocking function for receiving a message like #mp_nbrecv(),
+/// but returning a pointer to the message in the receiving buffer.
+/// Several messages can be held at the same time and released together
+/// with #mp_ack_n().
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+///
+/// \returns A pointer to the message, or NULL if no message has been
+/// received yet.
+volatile void _SPM * mp_nbrecv_ptr(qpd_t * qpd_ptr);
+
 /// \brief A function for receiving a message from a remote processor under
 /// flow control. The data that is received is placed in a message buffer
 /// in the communication scratch pad, when the received message is no
@@ -334,6 +582,48 @@ int mp_nbrecv(qpd_t * qpd_ptr)  INLINING ;
 /// \retval 1 The function succeeded receiving the message.
 int mp_recv(qpd_t * qpd_ptr, const unsigned int time_usecs)  INLINING ;
 
+/// \brief Set when the acknowledgements of a receiving port are sent.
+///
+/// By default each #mp_ack() sends the acknowledgement at once. With
+/// batching the acknowledgements are collected and sent with one transfer
+/// when batch of them are pending, or earlier when the sender sees at
+/// most watermark free buffers. The sender can only be blocked by missing
+/// acknowledgements when it sees no free buffer, so any watermark keeps
+/// the channel going.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// of a receiving port.
+/// \param batch The number of acknowledgements collected, at least 1.
+/// \param watermark The number of free buffers seen by the sender below
+/// which the acknowledgements are sent, at most num_buf.
+void mp_set_ack_batch(qpd_t * qpd_ptr, const unsigned int batch,
+                      const unsigned int watermark);
+
+/// \brief Pair a receiving and a sending port of a bidirectional channel.
+///
+/// The acknowledgements of the receiving port are carried in the flags of
+/// the messages of the sending port, so with batching most of them need no
+/// transfer of their own. Both cores of the channel have to pair their
+/// ports before any message is sent.
+///
+/// \param sink The receiving port.
+/// \param source The sending port to the same remote core.
+///
+/// \retval 0 The ports are not a pair to the same remote core.
+/// \retval 1 The ports have been paired.
+int mp_pair_qports(qpd_t * sink, qpd_t * source);
+
+/// \brief A function for sending the pending acknowledgements of a port.
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// of a receiving port.
+/// \param time_usecs The time out time in microseconds, if parameter is 0
+/// the timeout is infinite
+///
+/// \retval 0 The function timed out.
+/// \retval 1 No acknowledgements are pending.
+int mp_ack_flush(qpd_t * qpd_ptr, const unsigned int time_usecs);
+
 /// \brief Non-blocking function for acknowledging the reception of a message.
 /// This function should be used with extra care, if no acknowledgement is sent
 /// the communication channel will be blocked until an acknowledgement is sent.
@@ -365,6 +655,18 @@ int mp_nback(qpd_t * qpd_ptr) INLINING ;
 /// \retval 0 The function timed out.
 /// \retval 1 The function succeeded acknowledging the message.
 int mp_ack(qpd_t * qpd_ptr, const unsigned int time_usecs) INLINING ;
+
+/// \brief A function for acknowledging the reception of several messages
+/// with one transfer, see #mp_ack().
+///
+/// \param qpd_ptr A pointer to the message passing data structure
+/// for the given message passing channel.
+/// \param time_usecs The time out time in microseconds, if parameter is 0
+/// the timeout is infinite
+/// \param num_acks The number of messages to acknowledge.
+///
+/// \retval 0 The function timed out.
+/// \retval 1 The function succeeded acknowledging the messages.
 int mp_ack_n(qpd_t * qpd_ptr, const unsigned int time_usecs, unsigned int num_acks) INLINING ;
 
 ////////////////////////////////////////////////////////////////////////////
@@ -391,13 +693,18 @@ int mp_read(spd_t * sport, volatile void _SPM * sample)   __attribute__ ((noinli
 
 ////////////////////////////////////////////////////////////////////////////
 // Functions for collective communication
+//
+// All members of a communicator have to call the collective functions in
+// the same order. Each operation starts with a barrier, so the message
+// buffer of a member is not overwritten before the member has entered the
+// next operation.
 ////////////////////////////////////////////////////////////////////////////
-/// \cond PRIVATE
+
 /// \brief A function to synchronize the cores described in the communicator
 /// to a barrier.
 ///
 /// \param comm A pointer to the communicator struct that describes 
-/// the group of processing cores involved in the broadcast.
+/// the group of processing cores involved in the barrier.
 ///
 /// \returns The function returns after all processing cores has
 /// called at the barrier function.
@@ -406,17 +713,65 @@ void mp_barrier(communicator_t* comm);
 /// \brief A function for broadcasting a message to all members of
 /// a communicator
 ///
+/// The root places the message in its buffer, see #mp_comm_buf(),
+/// before the call.
+///
 /// \param comm A pointer to the communicator struct that describes 
 /// the group of processing cores involved in the broadcast.
 /// \param root The core ID of the processing core that should broadcast
 /// data. All processing cores in the communicator group has to call the
 /// #mp_broadcast() and specify the same #root core ID.
 ///
-/// \returns The function returns in the root when the root has sent all the data to
-/// the other cores and in the other cores when each core has received the data
-/// from the #root core
+/// \returns The function returns when the message is in the buffer of the
+/// calling core and the calling core has forwarded it to its children
+/// in the broadcast tree.
 void mp_broadcast(communicator_t* comm, const coreid_t root);
-/// \endcond
+
+/// \brief A function for reducing the messages of all members of a
+/// communicator into the buffer of the root.
+///
+/// Each member places its message in its buffer, see #mp_comm_buf(),
+/// before the call. The buffers of the members that are not the root
+/// contain partial results after the call.
+///
+/// \param comm A pointer to the communicator struct that describes 
+/// the group of processing cores involved in the reduction.
+/// \param root The core ID of the processing core that receives the result.
+/// \param op The operation applied element-wise to the messages.
+///
+/// \returns The function returns in the root when the result is in its
+/// buffer and in the other cores when they have sent their partial result.
+void mp_reduce(communicator_t* comm, const coreid_t root, const reduce_op_t op);
+
+/// \brief A function for gathering the messages of all members of a
+/// communicator in all members.
+///
+/// Each member places its message in its buffer, see #mp_comm_buf(),
+/// before the call. After the call the message of the member with index i
+/// is available at #mp_allgather_slot() with index i.
+///
+/// \param comm A pointer to the communicator struct that describes 
+/// the group of processing cores involved in the all-gather.
+///
+/// \returns The function returns when the messages of all members
+/// have arrived.
+void mp_allgather(communicator_t* comm);
+
+/// \brief Get the message buffer of the calling core.
+///
+/// \param comm A pointer to the communicator struct.
+///
+/// \returns A pointer to a buffer of msg_size bytes in the communication SPM.
+volatile void _SPM * mp_comm_buf(communicator_t* comm);
+
+/// \brief Get the message of a member after #mp_allgather().
+///
+/// \param comm A pointer to the communicator struct.
+/// \param index The index of the member in the member_ids array passed to
+/// #mp_communicator_init().
+///
+/// \returns A pointer to a buffer of msg_size bytes in the communication SPM.
+volatile void _SPM * mp_allgather_slot(communicator_t* comm, const unsigned index);
 
 #endif /* _MP_H_ */
 
@@ -49,18 +49,6 @@
 /// \brief Aligns X to word size
 #define WALIGN(X) (((X)+0x3) & ~0x3)
 
-#define SINGLE_SHM              0
-#define SINGLE_NOC              1
-#define DOUBLE_NOC              2
-#define TRIPLE_NOC              3
-#define MULTI_NOC_NONBLOCKING   4
-#define MULTI_NOC_MP            5
-#define DOUBLE_NOC_WR           6
-
-#ifndef IMPL
-#define IMPL DOUBLE_NOC
-#endif
-
 /*! \def FLAG_SIZE
  * \brief The size of the flag used to detect completion of a received message.
  *
@@ -73,6 +61,10 @@
 // Possible Flag types
 #define FLAG_VALID   0xFFFFFFFF
 #define FLAG_INVALID 0x00000000
+// A valid flag that carries the receive count of the paired port
+#define FLAG_CREDIT      0x80000000
+#define FLAG_CREDIT_TYPE 0xC0000000
+#define FLAG_CREDIT_MASK 0x3FFFFFFF
 /// \endcond
 
 /// \brief The type of the synchronization flag of a barrier.
@@ -141,6 +133,9 @@ struct _chan_info_t {
 
 extern volatile _UNCACHED chan_info_t chan_info[MAX_CHANNELS];
 
+/// \brief Set the remote core of a lock created with #initialize_lock().
+void lock_set_remote(LOCK_T * lock, unsigned remote, LOCK_T * remote_ptr);
+
 size_t mp_send_alloc_size(qpd_t * qpd_ptr);
 
 size_t mp_recv_alloc_size(qpd_t * qpd_ptr);
@@ -58,6 +58,13 @@
 #define NUM_BUFMONE 2
 #endif
 
+#ifndef COMM_MEMBERS
+#define COMM_MEMBERS 16
+#endif
+#ifndef COMM_ROUNDS
+#define COMM_ROUNDS 4
+#endif
+
 #ifndef PKT_TRANS_WAIT
 #define PKT_TRANS_WAIT 12
 #endif
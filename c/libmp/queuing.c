@@ -47,6 +47,14 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
                         const direction_t direction_type,
                         const size_t msg_size,
                         const size_t num_buf) {
+  return mp_create_qport_ring(chan_id, direction_type, msg_size, num_buf, NUM_WRITE_BUF);
+}
+
+qpd_t * mp_create_qport_ring(const unsigned int chan_id,
+                        const direction_t direction_type,
+                        const size_t msg_size,
+                        const size_t num_buf,
+                        const size_t num_send_buf) {
   if (chan_id >= MAX_CHANNELS) {
     TRACE(FAILURE,TRUE,"Channel id is out of range: chan_id %d\n",chan_id);
     return NULL;
@@ -60,6 +68,7 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
   }
 
   qpd_ptr->direction_type = direction_type;
+  qpd_ptr->credit_port = NULL;
   // Align the buffer size to words and add the flag size
   qpd_ptr->buf_size = WALIGN(msg_size);
   qpd_ptr->num_buf = num_buf;
@@ -67,6 +76,11 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
   chan_info[chan_id].port_type = QUEUING;
 
   if (direction_type == SOURCE) {
+    if (num_send_buf < NUM_WRITE_BUF) {
+      TRACE(FAILURE,TRUE,"At least %d send buffers are needed\n",NUM_WRITE_BUF);
+      return NULL;
+    }
+    qpd_ptr->num_send_buf = num_send_buf;
     unsigned int _SPM * send_addr = (unsigned int _SPM *)mp_alloc(mp_send_alloc_size(qpd_ptr));
     TRACE(INFO,TRUE,"Initializing SOURCE port addr : %#08x\n",(unsigned int)send_addr);
     
@@ -75,7 +89,7 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
       return NULL;
     }
 
-    int send_recv_count_offset = (qpd_ptr->buf_size + FLAG_SIZE) * NUM_WRITE_BUF;
+    int send_recv_count_offset = (qpd_ptr->buf_size + FLAG_SIZE) * num_send_buf;
     qpd_ptr->send_recv_count = (volatile unsigned int _SPM *)((char*)send_addr + send_recv_count_offset);
 
     // src_desc_ptr must be set first inorder for
@@ -98,6 +112,15 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
     qpd_ptr->write_buf = (volatile void _SPM *)send_addr;
     qpd_ptr->shadow_write_buf = (volatile void _SPM *)((char*)send_addr + (qpd_ptr->buf_size + FLAG_SIZE));
 
+    // The send ring for mp_reserve() and mp_commit()
+    qpd_ptr->send_ring = (volatile void _SPM *)send_addr;
+    qpd_ptr->reserve_count = 0;
+    qpd_ptr->commit_count = 0;
+    qpd_ptr->reserve_ptr = 0;
+    qpd_ptr->commit_ptr = 0;
+    qpd_ptr->dma_ptr = 0;
+    qpd_ptr->piggy_recv_count = 0;
+
 
   } else if (direction_type == SINK) {
     qpd_ptr->recv_addr = mp_alloc(mp_recv_alloc_size(qpd_ptr));
@@ -117,6 +140,12 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
 
     qpd_ptr->read_buf = qpd_ptr->recv_addr;
     qpd_ptr->recv_ptr = 0;
+    qpd_ptr->recv_msgs = 0;
+
+    // Send each acknowledgement at once
+    qpd_ptr->ack_pending = 0;
+    qpd_ptr->ack_batch = 1;
+    qpd_ptr->ack_watermark = num_buf;
 
     int recv_count_offset = (qpd_ptr->buf_size + FLAG_SIZE) * num_buf;
     qpd_ptr->recv_count = (volatile unsigned _SPM *)((char*)qpd_ptr->recv_addr + recv_count_offset);
@@ -149,14 +178,47 @@ qpd_t * mp_create_qport(const unsigned int chan_id,
 // Functions for point-to-point transmission of data
 ////////////////////////////////////////////////////////////////////////////
 
+// The number of messages the sender has not seen acknowledged, either by
+// an acknowledgement transfer or in the flag of a message of the paired port
+static inline unsigned int send_outstanding(qpd_t * qpd_ptr) {
+  unsigned int outstanding = qpd_ptr->send_count - *(qpd_ptr->send_recv_count);
+  if (qpd_ptr->credit_port != NULL) {
+    unsigned int piggy = (qpd_ptr->send_count - qpd_ptr->piggy_recv_count) & FLAG_CREDIT_MASK;
+    if (piggy < outstanding) {
+      outstanding = piggy;
+    }
+  }
+  return outstanding;
+}
+
+// The flag of an outgoing message. A paired port carries the receive
+// count of its receiving port, including the pending acknowledgements.
+static inline unsigned int send_flag(qpd_t * qpd_ptr) {
+  qpd_t * sink = qpd_ptr->credit_port;
+  if (sink == NULL) {
+    return FLAG_VALID;
+  }
+  return FLAG_CREDIT | ((*(sink->recv_count) + sink->ack_pending) & FLAG_CREDIT_MASK);
+}
+
+// Called when a message with the flag from send_flag() has been handed
+// to the NoC, the pending acknowledgements are on their way.
+static inline void send_flag_done(qpd_t * qpd_ptr) {
+  qpd_t * sink = qpd_ptr->credit_port;
+  if (sink != NULL) {
+    *(sink->recv_count) += sink->ack_pending;
+    sink->ack_pending = 0;
+  }
+}
+
 int mp_nbsend(qpd_t * qpd_ptr) {
 
   // Calculate the address of the remote receiving buffer
   int rmt_addr_offset = (qpd_ptr->buf_size + FLAG_SIZE) * qpd_ptr->send_ptr;
   volatile void _SPM * calc_rmt_addr = &qpd_ptr->recv_addr[rmt_addr_offset];
-  *(volatile int _SPM *)((char*)qpd_ptr->write_buf + qpd_ptr->buf_size) = FLAG_VALID;
+  *(volatile int _SPM *)((char*)qpd_ptr->write_buf + qpd_ptr->buf_size) = send_flag(qpd_ptr);
 
-  if ((qpd_ptr->send_count) - *(qpd_ptr->send_recv_count) == qpd_ptr->num_buf) {
+  if (send_outstanding(qpd_ptr) == qpd_ptr->num_buf) {
     TRACE(INFO,TRUE,"NO room in queue\n");
     return 0;
   }
@@ -164,6 +226,7 @@ int mp_nbsend(qpd_t * qpd_ptr) {
     TRACE(INFO,TRUE,"NO DMA free\n");
     return 0;
   }
+  send_flag_done(qpd_ptr);
 
   // Increment the send counter
   qpd_ptr->send_count++;
@@ -197,6 +260,87 @@ int mp_send(qpd_t * qpd_ptr, const unsigned int time_usecs) {
   return retval;
 }
 
+// Move a ring index forward
+static inline unsigned int ring_next(unsigned int ptr, unsigned int size) {
+  return ptr == size-1 ? 0 : ptr+1;
+}
+
+static inline volatile void _SPM * send_ring_buf(qpd_t * qpd_ptr, unsigned int ptr) {
+  return (volatile void _SPM *)((char*)qpd_ptr->send_ring
+                                + (qpd_ptr->buf_size + FLAG_SIZE) * ptr);
+}
+
+int mp_nbflush(qpd_t * qpd_ptr) {
+  if (qpd_ptr->send_count == qpd_ptr->commit_count) {
+    return 1;
+  }
+  if (send_outstanding(qpd_ptr) == qpd_ptr->num_buf) {
+    TRACE(INFO,TRUE,"NO room in queue\n");
+    return 0;
+  }
+  // Calculate the address of the remote receiving buffer
+  int rmt_addr_offset = (qpd_ptr->buf_size + FLAG_SIZE) * qpd_ptr->send_ptr;
+  volatile void _SPM * calc_rmt_addr = &qpd_ptr->recv_addr[rmt_addr_offset];
+  volatile void _SPM * buf = send_ring_buf(qpd_ptr,qpd_ptr->dma_ptr);
+  // The flag is written when the transfer starts, so it carries the
+  // latest acknowledgements of a paired port
+  *(volatile int _SPM *)((char*)buf + qpd_ptr->buf_size) = send_flag(qpd_ptr);
+  if (!noc_nbwrite(qpd_ptr->remote,calc_rmt_addr,buf,qpd_ptr->buf_size + FLAG_SIZE, 1)) {
+    TRACE(INFO,TRUE,"NO DMA free\n");
+    return 0;
+  }
+  send_flag_done(qpd_ptr);
+  qpd_ptr->send_count++;
+  qpd_ptr->send_ptr = ring_next(qpd_ptr->send_ptr,qpd_ptr->num_buf);
+  qpd_ptr->dma_ptr = ring_next(qpd_ptr->dma_ptr,qpd_ptr->num_send_buf);
+  return qpd_ptr->send_count == qpd_ptr->commit_count;
+}
+
+volatile void _SPM * mp_reserve(qpd_t * qpd_ptr) {
+  // Make progress on the committed buffers first
+  mp_nbflush(qpd_ptr);
+  // Buffers that are reserved or committed but not sent yet
+  unsigned int busy = qpd_ptr->reserve_count - qpd_ptr->send_count;
+  // The buffer of the last transfer is in use until the DMA is done. The
+  // DMA is shared with other transfers to the same core, so this may be
+  // pessimistic.
+  if (qpd_ptr->send_count != 0 && !noc_dma_done(qpd_ptr->remote)) {
+    busy++;
+  }
+  if (busy >= qpd_ptr->num_send_buf) {
+    return NULL;
+  }
+  volatile void _SPM * buf = send_ring_buf(qpd_ptr,qpd_ptr->reserve_ptr);
+  qpd_ptr->reserve_count++;
+  qpd_ptr->reserve_ptr = ring_next(qpd_ptr->reserve_ptr,qpd_ptr->num_send_buf);
+  return buf;
+}
+
+int mp_commit(qpd_t * qpd_ptr) {
+  if (qpd_ptr->commit_count == qpd_ptr->reserve_count) {
+    TRACE(ERROR,TRUE,"mp_commit() without mp_reserve()\n");
+    return 0;
+  }
+  qpd_ptr->commit_count++;
+  qpd_ptr->commit_ptr = ring_next(qpd_ptr->commit_ptr,qpd_ptr->num_send_buf);
+  mp_nbflush(qpd_ptr);
+  return 1;
+}
+
+int mp_flush(qpd_t * qpd_ptr, const unsigned int time_usecs) {
+  unsigned long long int timeout = get_cpu_usecs() + time_usecs;
+  int retval = 0;
+  // REM: The worst case waiting time of the mp_nbflush() must
+  // be added after the WCET analysis
+  _Pragma("loopbound min 1 max 1")
+  // while messages pending and ( timeout infinite or now is before timeout)
+  while(retval == 0 && ( time_usecs == 0 || get_cpu_usecs() < timeout ) ) {
+    retval = mp_nbflush(qpd_ptr);
+  }
+  TRACE(FAULT,retval == 0,"mp_flush() timed out");
+  return retval;
+}
+
 int mp_nbrecv(qpd_t * qpd_ptr) {
 
   // Calculate the address of the local receiving buffer
@@ -205,10 +349,16 @@ int mp_nbrecv(qpd_t * qpd_ptr) {
 
   volatile int _SPM * recv_flag = (volatile int _SPM *)((char*)calc_locl_addr + qpd_ptr->buf_size);
 
-  if (*recv_flag == FLAG_INVALID) {
-    TRACE(INFO,TRUE,"Recv flag %x\n",*recv_flag);
+  unsigned int flag = *recv_flag;
+  if (flag == FLAG_INVALID) {
+    TRACE(INFO,TRUE,"Recv flag %x\n",flag);
     return 0;
   }
+  // The message carries the receive count for the paired sending port
+  if ((flag & FLAG_CREDIT_TYPE) == FLAG_CREDIT && qpd_ptr->credit_port != NULL) {
+    qpd_ptr->credit_port->piggy_recv_count = flag & FLAG_CREDIT_MASK;
+  }
+  qpd_ptr->recv_msgs++;
 
   // Move the receive pointer
   if (qpd_ptr->recv_ptr == qpd_ptr->num_buf - 1) {
@@ -226,6 +376,13 @@ int mp_nbrecv(qpd_t * qpd_ptr) {
   return 1;
 }
 
+volatile void _SPM * mp_nbrecv_ptr(qpd_t * qpd_ptr) {
+  if (!mp_nbrecv(qpd_ptr)) {
+    return NULL;
+  }
+  return qpd_ptr->read_buf;
+}
+
 int mp_recv(qpd_t * qpd_ptr, const unsigned int time_usecs) {
   unsigned long long int timeout = get_cpu_usecs() + time_usecs;
   int retval = 0;
@@ -253,8 +410,48 @@ int mp_nback(qpd_t * qpd_ptr){
   return success;
 }
 
+void mp_set_ack_batch(qpd_t * qpd_ptr, const unsigned int batch,
+                      const unsigned int watermark) {
+  qpd_ptr->ack_batch = batch == 0 ? 1 : batch;
+  qpd_ptr->ack_watermark = watermark > qpd_ptr->num_buf ? qpd_ptr->num_buf : watermark;
+}
+
+int mp_pair_qports(qpd_t * sink, qpd_t * source) {
+  if (sink->direction_type != SINK || source->direction_type != SOURCE
+      || sink->remote != source->remote) {
+    TRACE(FAILURE,TRUE,"mp_pair_qports(): ports are not a pair\n");
+    return 0;
+  }
+  sink->credit_port = source;
+  source->credit_port = sink;
+  return 1;
+}
+
+int mp_ack_flush(qpd_t * qpd_ptr, const unsigned int time_usecs){
+  if (qpd_ptr->ack_pending == 0) {
+    return 1;
+  }
+  if (!mp_ack_n(qpd_ptr, time_usecs, qpd_ptr->ack_pending)) {
+    return 0;
+  }
+  qpd_ptr->ack_pending = 0;
+  return 1;
+}
+
 int mp_ack(qpd_t * qpd_ptr, const unsigned int time_usecs){
-  return mp_ack_n(qpd_ptr, time_usecs, 1);
+  qpd_ptr->ack_pending++;
+  // The number of buffers that the sender sees in use
+  unsigned int used = qpd_ptr->recv_msgs - *(qpd_ptr->recv_count);
+  if (qpd_ptr->ack_pending < qpd_ptr->ack_batch
+      && qpd_ptr->num_buf - used > qpd_ptr->ack_watermark) {
+    return 1;
+  }
+  if (!mp_ack_flush(qpd_ptr, time_usecs)) {
+    // Leave the acknowledgement to the caller, as without batching
+    qpd_ptr->ack_pending--;
+    return 0;
+  }
+  return 1;
 }
 
 int mp_ack_n(qpd_t * qpd_ptr, const unsigned int time_usecs, unsigned int num_acks){
@@ -41,120 +41,155 @@
 #include "mp_internal.h"
 #include "mp_loopbound.h"
 
+sport_impl_t mp_sport_impl(const size_t sample_size) {
+  // Small samples are written within the critical section, larger
+  // samples are written outside it, so the lock is only held while the
+  // index of the newest buffer is updated.
+  if (WALIGN(sample_size) <= SPORT_SMALL_SAMPLE) {
+    return SPORT_SINGLE_NOC;
+  }
+  return SPORT_TRIPLE_NOC;
+}
+
 spd_t * mp_create_sport(const unsigned int chan_id,
                         const direction_t direction_type,
                         const size_t sample_size) {
+  return mp_create_sport_impl(chan_id,direction_type,sample_size,SPORT_DEFAULT_IMPL);
+}
+
+spd_t * mp_create_sport_impl(const unsigned int chan_id,
+                        const direction_t direction_type,
+                        const size_t sample_size,
+                        sport_impl_t impl) {
   if (chan_id >= MAX_CHANNELS) {
     TRACE(FAILURE,TRUE,"Channel id out of range: chan_id %d\n",chan_id);
     return NULL;
   }
+  if (impl == SPORT_AUTO) {
+    impl = mp_sport_impl(sample_size);
+  }
+
+  spd_t * spd_ptr = mp_alloc(sizeof(spd_t));
+  if (spd_ptr == NULL) {
+    TRACE(FAILURE,TRUE,"Sampling port descriptor could not be allocated, SPM out of memory.\n");
+    return NULL;
+  }
 
-  #if IMPL != MULTI_NOC_MP
-    
-    spd_t * spd_ptr = mp_alloc(sizeof(spd_t));
-    if (spd_ptr == NULL) {
+  spd_ptr->impl = impl;
+  spd_ptr->direction_type = direction_type;
+  // Align the buffer size to words and add the flag size
+  spd_ptr->sample_size = WALIGN(sample_size);
+
+  if (impl == SPORT_MULTI_NOC_MP) {
+    // The samples are sent through a queuing port with three buffers
+    size_t num_buf = 3;
+    spd_ptr->qport = mp_create_qport(chan_id,direction_type,sample_size,num_buf);
+    if (spd_ptr->qport == NULL) {
       TRACE(FAILURE,TRUE,"Sampling port descriptor could not be allocated, SPM out of memory.\n");
       return NULL;
     }
+    return spd_ptr;
+  }
 
-    spd_ptr->direction_type = direction_type;
-    // Align the buffer size to words and add the flag size
-    spd_ptr->sample_size = WALIGN(sample_size);
+  // the lock is initialized to core zero,
+  // this is fixed in the mp_init_ports() function.
+  spd_ptr->lock = initialize_lock(0);
+  TRACE(INFO,TRUE,"Initializing lock : %#08x\n",(unsigned int)spd_ptr->lock);
 
-    // the lock is initialized to core zero,
-    // this is fixed in the mp_init_ports() function.
-    spd_ptr->lock = initialize_lock(0);
-    TRACE(INFO,TRUE,"Initializing lock : %#08x\n",(unsigned int)spd_ptr->lock);
+  if (spd_ptr->lock == NULL) {
+    TRACE(FAILURE,TRUE,"Lock initialization failed\n");
+    return NULL;
+  }
 
-    if (spd_ptr->lock == NULL) {
-      TRACE(FAILURE,TRUE,"Lock initialization failed\n");
+  chan_info[chan_id].port_type = SAMPLING;
+  if (direction_type == SOURCE) {
+    switch (impl) {
+    case SPORT_DOUBLE_NOC:
+      spd_ptr->next = 0;
+      break;
+    case SPORT_DOUBLE_NOC_WR:
+      spd_ptr->reading = 1;
+      spd_ptr->next = 0;
+      break;
+    case SPORT_TRIPLE_NOC:
+      spd_ptr->reading = -1;
+      spd_ptr->next = 0;
+      break;
+    case SPORT_MULTI_NOC_NONBLOCKING:
+      spd_ptr->reading = 0;
+      spd_ptr->next = 0;
+      break;
+    default:
+      break;
+    }
+    // src_desc_ptr must be set first inorder for
+    // core 0 to see which cores are absent in debug mode
+    chan_info[chan_id].src_spd_ptr = spd_ptr;
+    if (chan_info[chan_id].src_spd_ptr == NULL) {
+      TRACE(ERROR,TRUE,"src_spd_ptr written incorrectly\n");
       return NULL;
     }
+    chan_info[chan_id].src_lock = spd_ptr->lock;
 
-    chan_info[chan_id].port_type = SAMPLING;
-    if (direction_type == SOURCE) {
-      #if IMPL == DOUBLE_NOC
-        spd_ptr->next = 0;
-      #elif IMPL == DOUBLE_NOC_WR
-        spd_ptr->reading = 1;
-        spd_ptr->next = 0;
-      #elif IMPL == TRIPLE_NOC
-        spd_ptr->reading = -1;
-        spd_ptr->next = 0;
-      #elif IMPL == MULTI_NOC_NONBLOCKING
-        spd_ptr->reading = 0;
-        spd_ptr->next = 0;
-      #endif
-      // src_desc_ptr must be set first inorder for
-      // core 0 to see which cores are absent in debug mode
-      chan_info[chan_id].src_spd_ptr = spd_ptr;
-      if (chan_info[chan_id].src_spd_ptr == NULL) {
-        TRACE(ERROR,TRUE,"src_spd_ptr written incorrectly\n");
-        return NULL;
-      }
-      chan_info[chan_id].src_lock = spd_ptr->lock;
-
-      #if IMPL == SINGLE_SHM
-        // For shared memory buffer
-        spd_ptr->read_shm_buf = malloc(WALIGN(sample_size));
-        chan_info[chan_id].src_addr = (volatile void _SPM *)spd_ptr->read_shm_buf;
-        TRACE(ERROR,chan_info[chan_id].src_addr == NULL,"src_addr written incorrectly\n");
-      #endif
-
-      chan_info[chan_id].src_id = (char) get_cpuid();    
-      TRACE(INFO,TRUE,"Initialization at sender done.\n");
-
-    } else if (direction_type == SINK) {
-      #if IMPL == SINGLE_NOC
-        spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size));
-      #elif IMPL == DOUBLE_NOC
-        spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*2);
-        spd_ptr->newest = -1;
-      #elif IMPL == DOUBLE_NOC_WR
-        spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*2);
-        spd_ptr->newest = -1;
-      #elif IMPL == TRIPLE_NOC
-        spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*3);
-        spd_ptr->newest = -1;
-      #elif IMPL == MULTI_NOC_NONBLOCKING
-        spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*3);
-        spd_ptr->newest = -1;
-        spd_ptr->next_reading = 0;
-      #endif
-      TRACE(INFO,TRUE,"Initializing SINK port buf_addr: %#08x\n",(unsigned int)spd_ptr->read_bufs);
-      // sink_desc_ptr must be set first inorder for
-      // core 0 to see which cores are absent in debug mode
-      TRACE(INFO,TRUE,"SINK spd ptr: %#08x\n",(unsigned int)spd_ptr);
-      chan_info[chan_id].sink_spd_ptr = spd_ptr;
-      if (chan_info[chan_id].sink_spd_ptr == NULL) {
-        TRACE(ERROR,TRUE,"src_spd_ptr written incorrectly\n");
-        return NULL;
-      }
-      chan_info[chan_id].sink_lock = spd_ptr->lock;
-      chan_info[chan_id].sink_addr = (volatile void _SPM *)spd_ptr->read_bufs;
-      
-
-      TRACE(ERROR,chan_info[chan_id].sink_addr == NULL,"sink_addr written incorrectly\n");
-      if (spd_ptr->read_bufs == NULL) {
-        TRACE(FAILURE,TRUE,"SPM allocation failed at SINK\n");
-        return NULL;
-      }
-      chan_info[chan_id].sink_id = (char)get_cpuid();
-      TRACE(INFO,TRUE,"Initialization at receiver done.\n");
+    if (impl == SPORT_SINGLE_SHM) {
+      // For shared memory buffer
+      spd_ptr->read_shm_buf = malloc(WALIGN(sample_size));
+      chan_info[chan_id].src_addr = (volatile void _SPM *)spd_ptr->read_shm_buf;
+      TRACE(ERROR,chan_info[chan_id].src_addr == NULL,"src_addr written incorrectly\n");
+    }
 
+    chan_info[chan_id].src_id = (char) get_cpuid();    
+    TRACE(INFO,TRUE,"Initialization at sender done.\n");
+
+  } else if (direction_type == SINK) {
+    switch (impl) {
+    case SPORT_SINGLE_SHM:
+      // The reader reads the shared memory buffer of the writer
+      spd_ptr->read_bufs = NULL;
+      break;
+    case SPORT_SINGLE_NOC:
+      spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size));
+      break;
+    case SPORT_DOUBLE_NOC:
+    case SPORT_DOUBLE_NOC_WR:
+      spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*2);
+      spd_ptr->newest = -1;
+      break;
+    case SPORT_TRIPLE_NOC:
+      spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*3);
+      spd_ptr->newest = -1;
+      break;
+    case SPORT_MULTI_NOC_NONBLOCKING:
+      spd_ptr->read_bufs = mp_alloc(WALIGN(sample_size)*3);
+      spd_ptr->newest = -1;
+      spd_ptr->next_reading = 0;
+      break;
+    default:
+      TRACE(FAILURE,TRUE,"Unknown sampling port implementation %d\n",impl);
+      return NULL;
     }
-    return spd_ptr;
+    TRACE(INFO,TRUE,"Initializing SINK port buf_addr: %#08x\n",(unsigned int)spd_ptr->read_bufs);
+    // sink_desc_ptr must be set first inorder for
+    // core 0 to see which cores are absent in debug mode
+    TRACE(INFO,TRUE,"SINK spd ptr: %#08x\n",(unsigned int)spd_ptr);
+    chan_info[chan_id].sink_spd_ptr = spd_ptr;
+    if (chan_info[chan_id].sink_spd_ptr == NULL) {
+      TRACE(ERROR,TRUE,"src_spd_ptr written incorrectly\n");
+      return NULL;
+    }
+    chan_info[chan_id].sink_lock = spd_ptr->lock;
+    chan_info[chan_id].sink_addr = (volatile void _SPM *)spd_ptr->read_bufs;
+    
 
-  #elif IMPL == MULTI_NOC_MP
-    size_t num_buf = 3;
-    qpd_t * spd_ptr = mp_create_qport(chan_id,direction_type,sample_size,num_buf);
-    if (spd_ptr == NULL) {
-      TRACE(FAILURE,TRUE,"Sampling port descriptor could not be allocated, SPM out of memory.\n");
+    if (impl != SPORT_SINGLE_SHM && spd_ptr->read_bufs == NULL) {
+      TRACE(FAILURE,TRUE,"SPM allocation failed at SINK\n");
       return NULL;
     }
+    chan_info[chan_id].sink_id = (char)get_cpuid();
+    TRACE(INFO,TRUE,"Initialization at receiver done.\n");
 
-    return (spd_t *)spd_ptr;
-  #endif
+  }
+  return spd_ptr;
 }
 
 static inline void mem_copy(int _SPM * to, int _SPM * from, int bytes){
@@ -166,10 +201,12 @@ static inline void mem_copy(int _SPM * to, int _SPM * from, int bytes){
   }
 }
 
-#if IMPL == SINGLE_SHM
+////////////////////////////////////////////////////////////////////////////
+// SPORT_SINGLE_SHM
+////////////////////////////////////////////////////////////////////////////
 
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
+static void single_shm_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void single_shm_read_cs(spd_t * sport, volatile void _SPM * sample) {
   // Since sample_size is in bytes and we want to copy 32 bit at the time we divide sample_size by 4
   unsigned itteration_count = (sport->sample_size + 4 - 1) / 4; // equal to ceil(sport->sample_size/4)
   inval_dcache();
@@ -180,17 +217,17 @@ void mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
   }
 }
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int single_shm_read(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_read_cs(sport,sample);
+  single_shm_read_cs(sport,sample);
   release_lock(sport->lock);
 
   return 1;
 
 } 
 
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
+static void single_shm_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void single_shm_write_cs(spd_t * sport, volatile void _SPM * sample) {
   // Since sample_size is in bytes and we want to copy 32 bit at the time we divide sample_size by 4
   unsigned itteration_count = (sport->sample_size + 4 - 1) / 4; // equal to ceil(sport->sample_size/4)
   int * buf = (int *)sport->read_shm_buf;
@@ -201,62 +238,67 @@ void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
   
 }
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int single_shm_write(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_write_cs(sport,sample);
+  single_shm_write_cs(sport,sample);
   release_lock(sport->lock);
   return 1;
 } 
 
-#elif IMPL == SINGLE_NOC
+////////////////////////////////////////////////////////////////////////////
+// SPORT_SINGLE_NOC
+////////////////////////////////////////////////////////////////////////////
 
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
+static void single_noc_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void single_noc_read_cs(spd_t * sport, volatile void _SPM * sample) {
   int _SPM * buf = ((int _SPM *)sport->read_bufs);
   mem_copy((int _SPM *)sample,buf,sport->sample_size);
 }
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int single_noc_read(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_read_cs(sport,sample);
+  single_noc_read_cs(sport,sample);
   release_lock(sport->lock);
   return 1;
 
 } 
 
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
+static void single_noc_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void single_noc_write_cs(spd_t * sport, volatile void _SPM * sample) {
   noc_write(sport->remote,sport->read_bufs,sample,sport->sample_size,0);
   #pragma loopbound min SAMPLE_TRANS_WAIT max SAMPLE_TRANS_WAIT
   while(!noc_dma_done(sport->remote));
 }
 
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int single_noc_write(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_write_cs(sport,sample);
+  single_noc_write_cs(sport,sample);
   release_lock(sport->lock);
 
   return 1;
 } 
 
-#elif IMPL == DOUBLE_NOC
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
+////////////////////////////////////////////////////////////////////////////
+// SPORT_DOUBLE_NOC
+////////////////////////////////////////////////////////////////////////////
+
+static void double_noc_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void double_noc_read_cs(spd_t * sport, volatile void _SPM * sample) {
   int newest = (int)sport->newest;
   int _SPM * buf = (int _SPM *)((char _SPM *)sport->read_bufs+(newest*(sport->sample_size)));
   mem_copy((int _SPM *)sample,buf,sport->sample_size);
 }
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int double_noc_read(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_read_cs(sport, sample);
+  double_noc_read_cs(sport, sample);
   release_lock(sport->lock);
   return 1;
 } 
 
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
+static void double_noc_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void double_noc_write_cs(spd_t * sport, volatile void _SPM * sample) {
     // Update newest
   noc_write( sport->remote,
             (void _SPM *)&(sport->remote_spd->newest),
@@ -267,7 +309,7 @@ void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
   while(!noc_dma_done(sport->remote));
 }
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int double_noc_write(spd_t * sport, volatile void _SPM * sample) {
   // Send the sample to the next buffer
   noc_write( sport->remote,
             (void _SPM *)( ((unsigned int)sport->read_bufs)+(((unsigned int)sport->next)*sport->sample_size) ),
@@ -277,9 +319,8 @@ int mp_write(spd_t * sport, volatile void _SPM * sample) {
   #pragma loopbound min SAMPLE_TRANS_WAIT max SAMPLE_TRANS_WAIT
   while(!noc_dma_done(sport->remote));
   // When the sample is sent take the lock
-  unsigned int reading;
   acquire_lock(sport->lock);
-  mp_write_cs(sport, sample);
+  double_noc_write_cs(sport, sample);
   release_lock(sport->lock);
 
   // Move the next pointer to the other buffer
@@ -288,9 +329,12 @@ int mp_write(spd_t * sport, volatile void _SPM * sample) {
   return 1;
 } 
 
-#elif IMPL == DOUBLE_NOC_WR
-int mp_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-int mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
+////////////////////////////////////////////////////////////////////////////
+// SPORT_DOUBLE_NOC_WR
+////////////////////////////////////////////////////////////////////////////
+
+static int double_noc_wr_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static int double_noc_wr_read_cs(spd_t * sport, volatile void _SPM * sample) {
   int newest = (int)sport->newest;
   noc_write( sport->remote,
             (void _SPM *)(((int)&(sport->remote_spd->reading)) ),
@@ -302,18 +346,18 @@ int mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
   return newest;
 }
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int double_noc_wr_read(spd_t * sport, volatile void _SPM * sample) {
   int newest = 0;
   acquire_lock(sport->lock);
-  newest = mp_read_cs(sport, sample);
+  newest = double_noc_wr_read_cs(sport, sample);
   release_lock(sport->lock);
   int _SPM * buf = (int _SPM *)((char _SPM *)sport->read_bufs+(newest*(sport->sample_size)));
   mem_copy((int _SPM *)sample,buf,sport->sample_size);
   return 1;
 } 
 
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
+static void double_noc_wr_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static void double_noc_wr_write_cs(spd_t * sport, volatile void _SPM * sample) {
   unsigned int reading = sport->reading;
   // Move the next pointer to the free buffer
   sport->next = reading ^ 1;
@@ -335,22 +379,23 @@ void mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
   while(!noc_dma_done(sport->remote));
 }
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int double_noc_wr_write(spd_t * sport, volatile void _SPM * sample) {
   acquire_lock(sport->lock);
-  mp_write_cs(sport, sample);
+  double_noc_wr_write_cs(sport, sample);
   release_lock(sport->lock);
  
   return 1;
 } 
 
+////////////////////////////////////////////////////////////////////////////
+// SPORT_TRIPLE_NOC
+////////////////////////////////////////////////////////////////////////////
 
-#elif IMPL == TRIPLE_NOC
-int mp_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-int mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
+static int triple_noc_read_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static int triple_noc_read_cs(spd_t * sport, volatile void _SPM * sample) {
   // Read newest
   int newest = (int)sport->newest;
   // Update reading
-//  if (newest >= 0) {
   noc_write( sport->remote,
             (void _SPM *)(((int)&(sport->remote_spd->reading)) ),
             (void _SPM *)&sport->newest,
@@ -358,21 +403,15 @@ int mp_read_cs(spd_t * sport, volatile void _SPM * sample) {
             0);
   #pragma loopbound min PKT_TRANS_WAIT max PKT_TRANS_WAIT
     while(!noc_dma_done(sport->remote));
-//  }
   return newest;
 }
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int triple_noc_read(spd_t * sport, volatile void _SPM * sample) {
   int newest = 0;
   acquire_lock(sport->lock);
-  newest = mp_read_cs(sport, sample);
+  newest = triple_noc_read_cs(sport, sample);
   release_lock(sport->lock);
-//  DEBUGD(newest);
 
-  /*if (newest < 0) {
-    // No sample value has been written yet.
-    return 0;
-  }*/
   int _SPM * buf = (int _SPM *)((char _SPM *)sport->read_bufs+(newest*(sport->sample_size)));
   mem_copy((int _SPM *)sample,buf,sport->sample_size);
 
@@ -380,8 +419,8 @@ int mp_read(spd_t * sport, volatile void _SPM * sample) {
 
 } 
 
-unsigned int mp_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
-unsigned int mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
+static unsigned int triple_noc_write_cs(spd_t * sport, volatile void _SPM * sample) INLINING;
+static unsigned int triple_noc_write_cs(spd_t * sport, volatile void _SPM * sample) {
     // Update newest
   noc_write( sport->remote,
             (void _SPM *)&(sport->remote_spd->newest),
@@ -395,7 +434,7 @@ unsigned int mp_write_cs(spd_t * sport, volatile void _SPM * sample) {
   
 }
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int triple_noc_write(spd_t * sport, volatile void _SPM * sample) {
   // Send the sample to the next buffer
   noc_write( sport->remote,
             (void _SPM *)( ((unsigned int)sport->read_bufs)+(((unsigned int)sport->next)*sport->sample_size) ),
@@ -407,7 +446,7 @@ int mp_write(spd_t * sport, volatile void _SPM * sample) {
   // When the sample is sent take the lock
   unsigned int reading;
   acquire_lock(sport->lock);
-  reading = mp_write_cs(sport, sample);
+  reading = triple_noc_write_cs(sport, sample);
   release_lock(sport->lock);
 
   sport->next++;
@@ -425,9 +464,11 @@ int mp_write(spd_t * sport, volatile void _SPM * sample) {
   return 1;
 } 
 
-#elif IMPL == MULTI_NOC_NONBLOCKING
+////////////////////////////////////////////////////////////////////////////
+// SPORT_MULTI_NOC_NONBLOCKING
+////////////////////////////////////////////////////////////////////////////
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int multi_noc_nonblocking_read(spd_t * sport, volatile void _SPM * sample) {
   // Read newest
   int newest = *((volatile int _SPM *)&sport->newest);
   if (newest < 0) {
@@ -464,7 +505,7 @@ int mp_read(spd_t * sport, volatile void _SPM * sample) {
 
 } 
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
+static int multi_noc_nonblocking_write(spd_t * sport, volatile void _SPM * sample) {
   // Send the sample to the next buffer
   unsigned int reading = *((volatile unsigned int _SPM *)&sport->reading);
   noc_write( sport->remote,
@@ -488,38 +529,82 @@ int mp_write(spd_t * sport, volatile void _SPM * sample) {
   return 1;
 } 
 
-#elif IMPL == MULTI_NOC_MP
+////////////////////////////////////////////////////////////////////////////
+// SPORT_MULTI_NOC_MP
+////////////////////////////////////////////////////////////////////////////
 
-int mp_read(spd_t * sport, volatile void _SPM * sample) {
+static int multi_noc_mp_read(spd_t * sport, volatile void _SPM * sample) {
+  qpd_t * qport = sport->qport;
   int msg_rev = 0;
-  int num_buf = ((qpd_t *)sport)->num_buf;
+  int num_buf = qport->num_buf;
   #pragma loopbound min NUM_BUF max NUM_BUF
   for (int i = 0; i < num_buf; ++i) {
-    if(mp_nbrecv((qpd_t *)sport) != 0){
+    if(mp_nbrecv(qport) != 0){
       msg_rev++;
     }
   }
-/*  if (msg_rev == 0) {
-    return 0;
-  }*/
   
-  int _SPM * buf = (int _SPM *)(((qpd_t *)sport)->read_buf);
-  mem_copy((int _SPM *)sample,buf,((qpd_t *)sport)->buf_size);
-  mp_ack_n((qpd_t *)sport,0,msg_rev);
+  int _SPM * buf = (int _SPM *)(qport->read_buf);
+  mem_copy((int _SPM *)sample,buf,qport->buf_size);
+  mp_ack_n(qport,0,msg_rev);
 
   return 1;
 
 } 
 
-int mp_write(spd_t * sport, volatile void _SPM * sample) {
-  // Since we do not return from the function before the message is completely sent,
-  // we send the buffer pointet to by the sample pointer.
-  ((qpd_t *)sport)->write_buf = sample;
-  mp_send((qpd_t *)sport,10000);
+static int multi_noc_mp_write(spd_t * sport, volatile void _SPM * sample) {
+  qpd_t * qport = sport->qport;
+  // The sample is copied into the send buffer, the flag behind the
+  // message must not be written into the buffer of the caller.
+  mem_copy((int _SPM *)qport->write_buf,(int _SPM *)sample,qport->buf_size);
+  mp_send(qport,10000);
   #pragma loopbound min SAMPLE_TRANS_WAIT max SAMPLE_TRANS_WAIT
-  while(!noc_dma_done(((qpd_t *)sport)->remote));
+  while(!noc_dma_done(qport->remote));
   return 1;
 } 
 
-#endif
+////////////////////////////////////////////////////////////////////////////
+// Dispatch on the implementation of the port
+////////////////////////////////////////////////////////////////////////////
+
+int mp_read(spd_t * sport, volatile void _SPM * sample) {
+  switch (sport->impl) {
+  case SPORT_SINGLE_SHM:
+    return single_shm_read(sport,sample);
+  case SPORT_SINGLE_NOC:
+    return single_noc_read(sport,sample);
+  case SPORT_DOUBLE_NOC:
+    return double_noc_read(sport,sample);
+  case SPORT_TRIPLE_NOC:
+    return triple_noc_read(sport,sample);
+  case SPORT_MULTI_NOC_NONBLOCKING:
+    return multi_noc_nonblocking_read(sport,sample);
+  case SPORT_MULTI_NOC_MP:
+    return multi_noc_mp_read(sport,sample);
+  case SPORT_DOUBLE_NOC_WR:
+    return double_noc_wr_read(sport,sample);
+  default:
+    return 0;
+  }
+}
 
+int mp_write(spd_t * sport, volatile void _SPM * sample) {
+  switch (sport->impl) {
+  case SPORT_SINGLE_SHM:
+    return single_shm_write(sport,sample);
+  case SPORT_SINGLE_NOC:
+    return single_noc_write(sport,sample);
+  case SPORT_DOUBLE_NOC:
+    return double_noc_write(sport,sample);
+  case SPORT_TRIPLE_NOC:
+    return triple_noc_write(sport,sample);
+  case SPORT_MULTI_NOC_NONBLOCKING:
+    return multi_noc_nonblocking_write(sport,sample);
+  case SPORT_MULTI_NOC_MP:
+    return multi_noc_mp_write(sport,sample);
+  case SPORT_DOUBLE_NOC_WR:
+    return double_noc_wr_write(sport,sample);
+  default:
+    return 0;
+  }
+}
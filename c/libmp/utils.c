@@ -42,7 +42,7 @@
 
 
 size_t mp_send_alloc_size(qpd_t * qpd_ptr) {
-  size_t send_size = (qpd_ptr->buf_size + FLAG_SIZE) * NUM_WRITE_BUF
+  size_t send_size = (qpd_ptr->buf_size + FLAG_SIZE) * qpd_ptr->num_send_buf
                                   + WALIGN(sizeof(*(qpd_ptr->send_recv_count)));
   return send_size;
 }
@@ -482,6 +482,37 @@ void noc_multisend(unsigned cnt, unsigned dma_id [], volatile void _SPM *dst [],
   } while(!done);
 }
 
+// Start the transfers to a set of receivers, without waiting for any of
+// them to finish. A receiver whose DMA is busy is skipped and retried
+// in the next round, so all free DMAs work in parallel.
+// If dst is NULL, the data is sent to the source address at all receivers.
+static void multisend_cs(const coreset_t *receivers, volatile void _SPM *dst[],
+                         unsigned offset, volatile void _SPM *src, size_t size,
+                         unsigned irq_enable) {
+  unsigned cpuid = get_cpuid();
+  int done;
+  coreset_t sent;
+  coreset_clearall(&sent);
+  do {
+    done = 1;
+    int index = 0;
+    for (unsigned i = 0; i < NOC_CORES; ++i) {
+      if (coreset_contains(i,receivers)) {
+        if (i != cpuid && !coreset_contains(i,&sent)) {
+          volatile void _SPM *d = dst == NULL ? src
+                                : (volatile void _SPM *)((unsigned)dst[index]+offset);
+          if (noc_nbwrite(i, d, src, size, irq_enable)) {
+            coreset_add(i,&sent);
+          } else {
+            done = 0;
+          }
+        }
+        index++;
+      }
+    }
+  } while(!done);
+}
+
 // Multicast transfer of data via the NoC
 // The addresses and the size are in bytes
 // The receivers are defined in a coreset
@@ -489,20 +520,45 @@ void noc_multisend(unsigned cnt, unsigned dma_id [], volatile void _SPM *dst [],
 void noc_multisend_cs(coreset_t *receivers, volatile void _SPM *dst[],
                       unsigned offset, volatile void _SPM *src, size_t size,
                                                       unsigned irq_enable) {
-  int index = 0;
-  unsigned cpuid = get_cpuid();
-//  for (unsigned i = 0; i < CORESET_SIZE; ++i) {
-  for (unsigned i = 0; i < NOC_CORES; ++i) {
-    if (coreset_contains(i,receivers)){
-      if (i != cpuid) {
-        noc_write(i, (volatile void _SPM *)((unsigned)dst[index]+offset), src,
-                                                            size, irq_enable);
-      }
-      //DEBUGGER("Transmission address: %x+%x at core %i\n",(unsigned)dst[index],offset,i);
-      index++;
+  multisend_cs(receivers, dst, offset, src, size, irq_enable);
+}
+
+// Multicast transfer of data via the NoC, returns when all transfers
+// have finished
+void noc_multicast(coreset_t *receivers, volatile void _SPM *dst[],
+                   unsigned offset, volatile void _SPM *src, size_t size,
+                   unsigned irq_enable) {
+  multisend_cs(receivers, dst, offset, src, size, irq_enable);
+  noc_wait_dma(*receivers);
+}
+
+// Build a tree with the given fanout over the members. The root is
+// first, the other members follow in the order of their ids.
+void noc_tree_init(noc_tree_t *tree, const coreset_t *members,
+                   unsigned root, unsigned fanout) {
+  unsigned order[CORESET_SIZE];
+  unsigned cnt = 0;
+  order[cnt++] = root;
+  for (unsigned i = 0; i < CORESET_SIZE; ++i) {
+    coreset_clearall(&tree->children[i]);
+    if (i != root && coreset_contains(i,members)) {
+      order[cnt++] = i;
     }
   }
+  tree->root = root;
+  for (unsigned j = 1; j < cnt; ++j) {
+    coreset_add(order[j], &tree->children[order[(j-1)/fanout]]);
+  }
 }
+
+// Forward data to the children of the calling core in the tree
+void noc_tree_forward(const noc_tree_t *tree, volatile void _SPM *buf,
+                      size_t size, unsigned irq_enable) {
+  const coreset_t *children = &tree->children[get_cpuid()];
+  multisend_cs(children, NULL, 0, buf, size, irq_enable);
+  noc_wait_dma(*children);
+}
+
 //void noc_multisend_cs(coreset_t receivers, volatile void _SPM *dst[],
 //                                unsigned offset, volatile void _SPM *src, size_t size) {
 //  int index;
@@ -547,16 +603,89 @@ void __remote_irq_handler(void) {
   exc_epilogue();
 }
 
+// Queue of the received transfers of each core, filled by the data
+// interrupt handler and drained by noc_recv_drain()
+static struct {
+  unsigned addr[NOC_RECV_QUEUE_SIZE];
+  volatile unsigned head;
+  volatile unsigned tail;
+  volatile unsigned overflows;
+} recv_queue[CORESET_SIZE];
+
 void __data_recv_handler(void) __attribute__((naked));
 void __data_recv_handler(void) {
   exc_prologue();
   //WRITE("IRQ1\n",5); 
-  int tmp = *(NOC_IRQ_BASE+1);
-  *(NOC_SPM_BASE+(tmp<<2)) = 0;
+  // The FIFO holds the word address of the last word of the transfer
+  unsigned tmp = *(NOC_IRQ_BASE+1);
+  unsigned id = get_cpuid();
+  unsigned tail = recv_queue[id].tail;
+  unsigned next = tail+1 == NOC_RECV_QUEUE_SIZE ? 0 : tail+1;
+  if (next != recv_queue[id].head) {
+    recv_queue[id].addr[tail] = tmp;
+    recv_queue[id].tail = next;
+  } else {
+    recv_queue[id].overflows++;
+  }
   intr_clear_pending(exc_get_source());
   exc_epilogue();
 }
 
+void noc_recv_irq_enable(void) {
+  unsigned id = get_cpuid();
+  recv_queue[id].head = 0;
+  recv_queue[id].tail = 0;
+  recv_queue[id].overflows = 0;
+  intr_unmask(18);
+  intr_enable();
+}
+
+int noc_recv_drain(volatile void _SPM *addr[], unsigned max) {
+  unsigned id = get_cpuid();
+  unsigned head = recv_queue[id].head;
+  unsigned cnt = 0;
+  while (cnt < max && head != recv_queue[id].tail) {
+    addr[cnt++] = (volatile void _SPM *)(NOC_SPM_BASE + recv_queue[id].addr[head]);
+    head = head+1 == NOC_RECV_QUEUE_SIZE ? 0 : head+1;
+  }
+  recv_queue[id].head = head;
+  return cnt;
+}
+
+unsigned noc_recv_overflows(void) {
+  return recv_queue[get_cpuid()].overflows;
+}
+
+void noc_cq_init(noc_cq_t *cq) {
+  coreset_clearall(&cq->pending);
+}
+
+int noc_cq_post(noc_cq_t *cq, unsigned tag, unsigned dma_id,
+                volatile void _SPM *dst, volatile void _SPM *src,
+                size_t size, unsigned irq_enable) {
+  // A DMA holds one transfer, its tag must be drained first
+  if (coreset_contains(dma_id, &cq->pending)) {
+    return 0;
+  }
+  if (!noc_nbwrite(dma_id, dst, src, size, irq_enable)) {
+    return 0;
+  }
+  cq->tag[dma_id] = tag;
+  coreset_add(dma_id, &cq->pending);
+  return 1;
+}
+
+int noc_cq_drain(noc_cq_t *cq, unsigned tags[], unsigned max) {
+  unsigned cnt = 0;
+  for (unsigned i = 0; i < CORESET_SIZE && cnt < max; ++i) {
+    if (coreset_contains(i, &cq->pending) && noc_dma_done(i)) {
+      tags[cnt++] = cq->tag[i];
+      coreset_remove(i, &cq->pending);
+    }
+  }
+  return cnt;
+}
+
 #ifdef TRAP
 
 int _noc_trap_handler(unsigned int op,
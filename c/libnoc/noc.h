@@ -283,6 +283,8 @@ void noc_multisend(unsigned cnt, unsigned dma_id [],
 /// \brief Multi-cast transfer of data like #noc_multisend(), but with coreset
 /// and a single destination address.
 ///
+/// The transfers to all receivers are started without waiting for each
+/// other, the function returns when all of them have been started.
 /// The addresses and the size are absolute and in bytes.
 /// \param receivers The set of receivers.
 /// \param dst An array with pointers to the destinations of the transfer.
@@ -301,6 +303,161 @@ void noc_multisend_cs(coreset_t *receivers,
 /// \param receivers The set of receivers.
 void noc_wait_dma(coreset_t receivers);
 
+/// \brief Multi-cast transfer of data like #noc_multisend_cs(), but returns
+/// when all transfers have finished.
+///
+/// The DMAs of all receivers work in parallel, so the transfer takes
+/// about as long as the slowest unicast, not the sum of them.
+/// \param receivers The set of receivers.
+/// \param dst An array with pointers to the destinations of the transfer.
+/// \param offset Common offset for the destination addresses.
+/// \param src A pointer to the source of the transfer.
+/// \param size The size of data to be transferred, in bytes.
+void noc_multicast(coreset_t *receivers,
+                   volatile void _SPM *dst[],
+                   unsigned offset,
+                   volatile void _SPM *src,
+                   size_t size,
+                   unsigned irq_enable);
+
+/// \brief A multicast tree, in which each core forwards the data to its
+/// children.
+///
+/// The data is placed at the same address in the communication SPM of
+/// all members. A tree can be built with #noc_tree_init() or filled in
+/// from a precomputed table.
+typedef struct {
+  /// The root of the tree
+  unsigned root;
+  /// The children of each core
+  coreset_t children[CORESET_SIZE];
+} noc_tree_t;
+
+/// \brief Build a tree over a set of cores.
+///
+/// The root is followed by the other members in the order of their ids,
+/// member j has the members j*fanout+1 to j*fanout+fanout as children.
+/// \param tree The tree to build.
+/// \param members The set of cores in the tree.
+/// \param root The core that sends the data.
+/// \param fanout The number of children of each core, at least 1.
+void noc_tree_init(noc_tree_t *tree, const coreset_t *members,
+                   unsigned root, unsigned fanout);
+
+/// \brief Send data to the children of the calling core in a tree.
+///
+/// The root calls the function when the data is ready, the other members
+/// when they have received it. The function returns when the transfers
+/// to all children have finished.
+/// \param tree The tree.
+/// \param buf A pointer to the data, the same address is used at the
+/// children.
+/// \param size The size of data to be transferred, in bytes.
+void noc_tree_forward(const noc_tree_t *tree,
+                      volatile void _SPM *buf,
+                      size_t size,
+                      unsigned irq_enable);
+
+///////////////////////////////////////////////////////////////////////////////
+// Fork and join of corethreads
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief Create a corethread like corethread_create(), whose termination
+/// is signaled through the NoC.
+///
+/// When the thread returns, the word at flag in the communication SPM of
+/// the calling core is set through the NoC, so #noc_corethread_join()
+/// spins on the local SPM instead of polling main memory every 10
+/// microseconds. The word at the same address in the SPM of the thread's
+/// core is overwritten.
+/// \param core_id The core to run the thread.
+/// \param start_routine The function of the thread.
+/// \param arg The argument passed to start_routine.
+/// \param flag A word in the communication SPM of the calling core.
+/// \returns The return value of corethread_create().
+int noc_corethread_create(int core_id, void (*start_routine)(void*),
+                          void *arg, volatile void _SPM *flag);
+
+/// \brief Wait for a corethread created with #noc_corethread_create().
+///
+/// Must be called by the core that created the thread.
+/// \returns The return value of corethread_join().
+int noc_corethread_join(int core_id, void **retval);
+
+///////////////////////////////////////////////////////////////////////////////
+// Completion queues
+///////////////////////////////////////////////////////////////////////////////
+
+/// \brief A queue of the transfers started by a core.
+///
+/// A transfer is posted with a tag and runs while the core does other
+/// work. #noc_cq_drain() returns the tags of the finished transfers. Each
+/// receiver has one DMA, so at most one transfer per receiver is in the
+/// queue.
+typedef struct {
+  /// \cond PRIVATE
+  coreset_t pending;
+  unsigned tag[CORESET_SIZE];
+  /// \endcond
+} noc_cq_t;
+
+/// \brief Initialize an empty completion queue.
+void noc_cq_init(noc_cq_t *cq);
+
+/// \brief Start a transfer like #noc_nbwrite() and add it to a completion
+/// queue.
+///
+/// \param cq The completion queue.
+/// \param tag A value returned by #noc_cq_drain() when the transfer has
+/// finished.
+/// \retval 1 The transfer was started.
+/// \retval 0 The DMA of the receiver is busy, or its last transfer in the
+/// queue has not been drained yet.
+int noc_cq_post(noc_cq_t *cq, unsigned tag, unsigned dma_id,
+                volatile void _SPM *dst, volatile void _SPM *src,
+                size_t size, unsigned irq_enable);
+
+/// \brief Remove the finished transfers from a completion queue.
+///
+/// The function does not wait.
+/// \param cq The completion queue.
+/// \param tags An array for the tags of the finished transfers.
+/// \param max The size of the tags array.
+/// \returns The number of tags written to the array.
+int noc_cq_drain(noc_cq_t *cq, unsigned tags[], unsigned max);
+
+/// \brief Check whether all transfers of a completion queue have been
+/// drained.
+static inline int noc_cq_empty(const noc_cq_t *cq) {
+  return coreset_empty(&cq->pending);
+}
+
+/// \brief The number of received transfers that the data interrupt
+/// handler can hold.
+#ifndef NOC_RECV_QUEUE_SIZE
+#define NOC_RECV_QUEUE_SIZE 16
+#endif
+
+/// \brief Enable the data interrupt of the calling core.
+///
+/// Afterwards every transfer sent to the core with irq_enable set is
+/// added to its receive queue, which is read with #noc_recv_drain().
+void noc_recv_irq_enable(void);
+
+/// \brief Remove the received transfers from the receive queue of the
+/// calling core.
+///
+/// The function does not wait.
+/// \param addr An array for the addresses of the last word of each
+/// received transfer.
+/// \param max The size of the addr array.
+/// \returns The number of addresses written to the array.
+int noc_recv_drain(volatile void _SPM *addr[], unsigned max);
+
+/// \brief The number of received transfers that were dropped because the
+/// receive queue of the calling core was full.
+unsigned noc_recv_overflows(void);
+
 ///////////////////////////////////////////////////////////////////////////////
 // Definitions for setting up a transfer
 ///////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,83 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Fork and join of corethreads with notification through the NoC
+ *
+ */
+
+#include "noc.h"
+#include "libcorethread/corethread.h"
+
+// The thread started on each core and where to notify its joiner
+static volatile _UNCACHED struct {
+  void (*start_routine)(void *);
+  void *arg;
+  volatile unsigned _SPM *flag;
+  int joiner;
+} join_info[MAX_CORES];
+
+static void join_trampoline(void *param) {
+  unsigned id = get_cpuid();
+  join_info[id].start_routine(join_info[id].arg);
+  if (boot_info->slave[id].status != STATUS_RETURN) {
+    corethread_exit(NULL);
+  }
+  // The return value is in main memory, the flag only signals that it
+  // has been written
+  volatile unsigned _SPM *flag = join_info[id].flag;
+  int joiner = join_info[id].joiner;
+  *flag = 1;
+  noc_write(joiner, flag, flag, sizeof(unsigned), 0);
+  while (!noc_dma_done(joiner)) {
+    /* spin */
+  }
+}
+
+int noc_corethread_create(int core_id, void (*start_routine)(void*),
+                          void *arg, volatile void _SPM *flag) {
+  *(volatile unsigned _SPM *)flag = 0;
+  join_info[core_id].start_routine = start_routine;
+  join_info[core_id].arg = arg;
+  join_info[core_id].flag = (volatile unsigned _SPM *)flag;
+  join_info[core_id].joiner = get_cpuid();
+  return corethread_create(core_id, &join_trampoline, NULL);
+}
+
+int noc_corethread_join(int core_id, void **retval) {
+  volatile unsigned _SPM *flag = join_info[core_id].flag;
+  while (*flag == 0) {
+    /* spin on the local SPM */
+  }
+  // The thread has returned, corethread_join() does not wait
+  return corethread_join(core_id, retval);
+}
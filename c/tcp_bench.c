@@ -0,0 +1,140 @@
+/*
+   Copyright 2014 Technical University of Denmark, DTU Compute. 
+   All rights reserved.
+   
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Throughput benchmark of the TCP byte streams of ethlib
+ *
+ * Patmos connects to a Linux peer and sends TOTAL_BYTES through a
+ * send ring of growing size, which bounds the data in flight. For each
+ * ring size the time until all data is acknowledged, the throughput and
+ * the number of retransmission timeouts are printed.
+ *
+ * Run it in the emulator with a tap device and a sink on the host:
+ *
+ *   nc -lk 5001 > /dev/null &
+ *   sudo patemu -e 192.168.2.1 tcp_bench.elf
+ *
+ * The times are Patmos times, so in the emulator the numbers say more
+ * about the cycles spent per segment than about the link.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <machine/patmos.h>
+#include <machine/rtc.h>
+#include "ethlib/tcp.h"
+#include "ethlib/arp.h"
+#include "ethlib/eth_mac_driver.h"
+
+#define TOTAL_BYTES (256*1024)
+#define PEER_PORT 5001
+#define POLL_TIMEOUT 100            //us
+#define CONNECT_TIMEOUT 2000000     //us
+#define CLOSE_TIMEOUT 2000000       //us
+
+#define NUM_RINGS 4
+const unsigned ring_sizes[NUM_RINGS] = {TCP_MSS, 2*TCP_MSS, 4*TCP_MSS, 16*TCP_MSS};
+
+unsigned int rx_addr = 0x000;
+unsigned int tx_addr = 0x800;
+unsigned char peer_ip[4] = {192, 168, 2, 1};
+
+tcp_connection conn;
+unsigned char snd_buf[16*TCP_MSS];
+unsigned char rcv_buf[TCP_MSS];
+unsigned char chunk[TCP_MSS];
+
+static int bench_connect(unsigned char peer_mac[], unsigned short port, unsigned ring_size){
+	tcp_init_connection(&conn, tx_addr, rx_addr, my_mac, peer_mac, my_ip, peer_ip, port, PEER_PORT, 0, 0);
+	tcp_stream_init(&conn, snd_buf, ring_size, rcv_buf, sizeof(rcv_buf));
+	for (int i = 0; i < TCP_SYN_RETRIES && conn.status != ESTABLISHED; i++){
+		tcp_connect(&conn);
+		unsigned long long start = get_cpu_usecs();
+		while (conn.status == SYN_SENT && get_cpu_usecs() - start < CONNECT_TIMEOUT){
+			tcp_poll(&conn, POLL_TIMEOUT);
+		}
+	}
+	return conn.status == ESTABLISHED;
+}
+
+static void bench_close(void){
+	unsigned long long start = get_cpu_usecs();
+	tcp_close(&conn);
+	while (conn.status != CLOSED && conn.status != TIME_WAIT && get_cpu_usecs() - start < CLOSE_TIMEOUT){
+		tcp_poll(&conn, POLL_TIMEOUT);
+	}
+}
+
+int main(){
+	unsigned char peer_mac[6];
+
+	eth_mac_initialize();
+	arp_table_init();
+	ipv4_set_my_ip((unsigned char[4]){192, 168, 2, 2});
+	for (int i = 0; i < TCP_MSS; i++){
+		chunk[i] = 'a' + i % 26;
+	}
+
+	if (arp_resolve_ip(rx_addr, tx_addr, peer_ip, 1000000) == 0 || arp_table_search(peer_ip, peer_mac) == 0){
+		printf("Peer %d.%d.%d.%d does not answer ARP\n", peer_ip[0], peer_ip[1], peer_ip[2], peer_ip[3]);
+		return 1;
+	}
+
+	printf("Sending %d bytes to port %d\n", TOTAL_BYTES, PEER_PORT);
+	printf("%8s %10s %10s %8s\n", "ring", "us", "kB/s", "rto");
+	for (int r = 0; r < NUM_RINGS; r++){
+		//A new port each time, the peer may still hold the last connection
+		if (!bench_connect(peer_mac, 40000 + r, ring_sizes[r])){
+			printf("Cannot connect to port %d\n", PEER_PORT);
+			return 1;
+		}
+
+		unsigned sent = 0;
+		unsigned long long start = get_cpu_usecs();
+		while ((sent < TOTAL_BYTES || conn.snd_len > 0) && conn.status == ESTABLISHED){
+			if (sent < TOTAL_BYTES){
+				unsigned length = TOTAL_BYTES - sent < TCP_MSS ? TOTAL_BYTES - sent : TCP_MSS;
+				sent += tcp_write(&conn, chunk, length);
+			}
+			tcp_poll(&conn, POLL_TIMEOUT);
+		}
+		unsigned long long usecs = get_cpu_usecs() - start;
+
+		if (conn.status != ESTABLISHED){
+			printf("Connection lost after %d bytes\n", sent - conn.snd_len);
+			return 1;
+		}
+		printf("%8d %10llu %10llu %8d\n", ring_sizes[r], usecs, usecs ? (unsigned long long)TOTAL_BYTES * 1000000 / 1024 / usecs : 0, conn.retransmits);
+		bench_close();
+	}
+	return 0;
+}
@@ -2,9 +2,9 @@
 NOTES ON STUFF MISSING FROM THE OLD EMULATOR
 - generating the emulator_config. These care hardcoded below for now
 - VCD dump
-- init_extmem - should not be needed as the current state of the new emulator 
-  uses hashmap for memory. Only for testing width of data channel to memory.
-  but i haven't found a way to get signal width from verilator.
+- init_extmem - memory is paged and allocated on first touch, so only the
+  random initialization is left. Only for testing width of data channel to
+  memory, but i haven't found a way to get signal width from verilator.
 
 */
 #include "emulator_config.h"
@@ -18,15 +18,30 @@ NOTES ON STUFF MISSING FROM THE OLD EMULATOR
 #include <fstream>
 #include <iostream>
 #include <string>
-#include <libelf.h>
-#include <gelf.h>
+#include <chrono>
 #include <sys/poll.h>
 #include <fcntl.h>
+#include <getopt.h>
+
+#include "elfload.h"
+#include "extmem.h"
+#include "perfstat.h"
+#include "tracewin.h"
+#include "itrace.h"
 
 #include "VPatmos.h"
 #include "verilated.h"
-#if VM_TRACE
+#if VM_TRACE_FST
+#include "verilated_fst_c.h"
+typedef VerilatedFstC VerilatedTraceC;
+#define TRACE_FILE "Patmos.fst"
+#elif VM_TRACE
 #include "verilated_vcd_c.h"
+typedef VerilatedVcdC VerilatedTraceC;
+#define TRACE_FILE "Patmos.vcd"
+#endif
+#ifdef EMU_SAVABLE
+#include "verilated_save.h"
 #endif
 #if CORE_COUNT > 1
 #include "VPatmos_PatmosCore.h"
@@ -34,6 +49,32 @@ NOTES ON STUFF MISSING FROM THE OLD EMULATOR
 
 #define OCMEM_ADDR_BITS 16
 
+// Exit status when the program is stopped by -l
+#define EXIT_LIMIT 2
+
+// The cores are separate members of the model, only the first 16 are sampled
+#if CORE_COUNT > 16
+#define PERF_CORE_COUNT 16
+#else
+#define PERF_CORE_COUNT CORE_COUNT
+#endif
+#ifdef EXTMEM_SSRAM32CTRL
+#define SRAM_CYCLES 3
+#endif
+#ifdef EXTMEM_MEMBRIDGE
+#define OCP_BURST_LENGTH 4
+#define OCP_CMD_IDLE 0x0
+#define OCP_CMD_WR   0x1
+#define OCP_CMD_RD   0x2
+#define OCP_RESP_NULL 0x0
+#define OCP_RESP_DVA  0x1
+#endif
+#define UART_BUF_SIZE 4096
+
+// Checkpoint file header
+#define CKPT_MAGIC   0x50434b54 // "PCKT"
+#define CKPT_VERSION 2
+
 typedef uint64_t val_t;
 
 using namespace std;
@@ -42,9 +83,10 @@ class Emulator
 {
   unsigned long m_tickcount;
   public: VPatmos *c;
-  VerilatedVcdC	*c_trace;
+  VerilatedTraceC *c_trace;
   // For Uart:
   bool UART_on;
+  unsigned baud_counter;
   int baudrate;
   int freq;
   char in_byte;
@@ -58,18 +100,54 @@ class Emulator
   string write_str;
   int write_cntr;
   int write_len;
+  // Waveforms are only dumped inside the trace window
+  TraceWindow trace_win;
   bool trace;
   ostream *outputTarget = &std::cout;
+  // For batch mode, UART data is buffered instead of doing host I/O per cycle
+  bool batch;
+  unsigned char uart_in_buf[UART_BUF_SIZE];
+  unsigned uart_in_head;
+  unsigned uart_in_tail;
+  unsigned char uart_out_buf[UART_BUF_SIZE];
+  unsigned uart_out_len;
 
   //elf - mem - ram
   #ifdef EXTMEM_SSRAM32CTRL
-  uint32_t *ram_buf; 
+  PagedMemory<uint32_t> ram_buf;
+  // SSRAM burst state
+  uint32_t ssram_addr_cnt;
+  uint32_t ssram_address;
+  uint32_t ssram_counter;
   #endif /* EXTMEM_SSRAM32CTRL */
 
   #ifdef EXTMEM_SRAMCTRL
-  uint16_t *ram_buf; 
+  PagedMemory<uint16_t> ram_buf;
   #endif /* EXTMEM_SRAMCTRL */
 
+  #ifdef EXTMEM_MEMBRIDGE
+  PagedMemory<uint32_t> ram_buf;
+  // OCP burst transaction state
+  enum { OCP_IDLE, OCP_READ, OCP_WRITE } ocp_state;
+  uint32_t ocp_addr;
+  uint32_t ocp_burst[OCP_BURST_LENGTH];
+  unsigned ocp_cnt;
+  unsigned long ocp_ready;  // cycle at which the next word may be transferred
+  unsigned mem_latency;     // cycles from command to first data
+  unsigned mem_interval;    // cycles per data word
+  #endif /* EXTMEM_MEMBRIDGE */
+
+  // Binary instruction trace of core 0
+  InstrTrace itrace;
+  unsigned itrace_base;
+  bool itrace_halted;       // core 0 returned to address 0 in the last tick
+
+  // Per-core performance statistics
+  PerfStats perf;
+  #if CORE_COUNT > 1
+  VPatmos_PatmosCore *perf_cores[PERF_CORE_COUNT];
+  #endif
+
 public:
   Emulator(void)
   {
@@ -79,49 +157,65 @@ public:
 
     //for UART
     UART_on = false;
+    baud_counter = 0;
     c->io_UartCmp_rx = 1; // keep UART tx high when idle
     outputTarget = &cout; // default uart print to terminal
+    batch = false;
+    uart_in_head = uart_in_tail = 0;
+    uart_out_len = 0;
 
     #ifdef EXTMEM_SSRAM32CTRL
-    ram_buf = (uint32_t *)calloc(1 << EXTMEM_ADDR_BITS, sizeof(uint32_t));
+    ram_buf.init(1 << EXTMEM_ADDR_BITS);
+    ssram_addr_cnt = ssram_address = ssram_counter = 0;
     #endif /* EXTMEM_SSRAM32CTRL */
 
     #ifdef EXTMEM_SRAMCTRL
-    ram_buf = (uint16_t *)calloc(1 << EXTMEM_ADDR_BITS, sizeof(uint16_t));
+    ram_buf.init(1 << EXTMEM_ADDR_BITS);
     #endif /* EXTMEM_SRAMCTRL */
 
+    #ifdef EXTMEM_MEMBRIDGE
+    ram_buf.init(EXTMEM_SIZE / 4);
+    ocp_state = OCP_IDLE;
+    ocp_addr = ocp_cnt = 0;
+    ocp_ready = 0;
+    mem_latency = 3;
+    mem_interval = 1;
+    #endif /* EXTMEM_MEMBRIDGE */
+
+    c_trace = NULL;
     trace = false;
+    itrace_base = 0;
+    itrace_halted = false;
     
   }
 
   ~Emulator(void)
   {
+    stopTrace();
+
     delete c;
     c = NULL;
-
-    if (trace){
-      if (c_trace) {
-        c_trace->close();
-        c_trace = NULL;
-      }
-    }
   }
 
   void setTrace(){
-    trace = true;
     if (!c_trace){
-      c_trace = new VerilatedVcdC;
+      c_trace = new VerilatedTraceC;
 			c->trace(c_trace, 99);
-			c_trace->open("Patmos.vcd");
+			c_trace->open(TRACE_FILE);
     }
+    // the window opens in the next tick()
+    trace_win.enable();
+  }
+
+  TraceWindow &traceWindow(void) {
+    return trace_win;
   }
 
   void stopTrace(){
-    if (trace){
-      if (c_trace) {
-        c_trace->close();
-        c_trace = NULL;
-      }
+    if (c_trace) {
+      c_trace->close();
+      delete c_trace;
+      c_trace = NULL;
     }
     trace = false;
   }
@@ -142,6 +236,15 @@ public:
     // Increment our own internal time reference
     m_tickcount++;
 
+    if (trace_win.active()) {
+      bool was_on = trace;
+      trace = trace_win.update(m_tickcount, trace_win.wants_pc() ? get_pc() : 0);
+      // dumps are buffered, write them out when the window closes
+      if (was_on && !trace) {
+        c_trace->flush();
+      }
+    }
+
     // Make sure any combinatorial logic depending upon
     // inputs that may have changed before we called tick()
     // has settled before the rising edge of the clock.
@@ -162,9 +265,19 @@ public:
       emu_uart(uart_in, uart_out);
     }
 
+    // main stops without printing the tick after the halt, skip it too
+    if (itrace.enabled() && !itrace_halted) {
+      trace_instr();
+      itrace_halted = at_halt();
+    }
+
+    if (perf.enabled()) {
+      perf_count();
+      perf.sample(m_tickcount);
+    }
+
     if (trace) {
       c_trace->dump(10*m_tickcount+10);
-      c_trace->flush();
     }
   }
 
@@ -185,15 +298,21 @@ public:
 
 
   void emu_uart(int uart_in,int uart_out) {//int uart_in, int uart_out
-    static unsigned baud_counter = 0;
-
     // Pass on data from UART
     if (c->Patmos__DOT__UartCmp__DOT__uart__DOT__uartOcpEmu_Cmd == 0x1
         && (c->Patmos__DOT__UartCmp__DOT__uart__DOT__uartOcpEmu_Addr & 0xff) == 0x04) {
       unsigned char d = c->Patmos__DOT__UartCmp__DOT__uart__DOT__uartOcpEmu_Data;
-      int w = write(uart_out, &d, 1);
-      if (w != 1) {
-        cerr << "patemu: error: Cannot write UART output" << endl;
+      trace_win.uart_byte(d, m_tickcount);
+      if (batch) {
+        if (uart_out_len == UART_BUF_SIZE) {
+          uart_flush(uart_out);
+        }
+        uart_out_buf[uart_out_len++] = d;
+      } else {
+        int w = write(uart_out, &d, 1);
+        if (w != 1) {
+          cerr << "patemu: error: Cannot write UART output" << endl;
+        }
       }
     }
 
@@ -203,26 +322,99 @@ public:
       baud_counter = (baud_counter + 1) % 10;
     }
     if (baud_tick && baud_counter == 0) {
-      struct pollfd pfd;
-      pfd.fd = uart_in;
-      pfd.events = POLLIN;
-      if (poll(&pfd, 1, 0) > 0) {
-        unsigned char d;
-        int r = read(uart_in, &d, 1);
-        if (r != 0) {
-          if (r != 1) {
-            cerr << "patemu: error: Cannot read UART input" << endl;
-          } else {
-            c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_state = 0x3; // rx_stop_bit
-            c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_baud_tick = 1;
-            c->Patmos__DOT__UartCmp__DOT__uart__DOT__rxd_reg2 = 1;
-            c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_buff = d;
+      unsigned char d;
+      bool avail = false;
+      if (batch) {
+        if (uart_in_head != uart_in_tail) {
+          d = uart_in_buf[uart_in_tail];
+          uart_in_tail = (uart_in_tail + 1) % UART_BUF_SIZE;
+          avail = true;
+        }
+      } else {
+        struct pollfd pfd;
+        pfd.fd = uart_in;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, 0) > 0) {
+          int r = read(uart_in, &d, 1);
+          if (r != 0) {
+            if (r != 1) {
+              cerr << "patemu: error: Cannot read UART input" << endl;
+            } else {
+              avail = true;
+            }
           }
         }
       }
+      if (avail) {
+        c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_state = 0x3; // rx_stop_bit
+        c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_baud_tick = 1;
+        c->Patmos__DOT__UartCmp__DOT__uart__DOT__rxd_reg2 = 1;
+        c->Patmos__DOT__UartCmp__DOT__uart__DOT__rx_buff = d;
+      }
     }
   }
 
+  // Write buffered UART output in one go
+  void uart_flush(int uart_out) {
+    unsigned pos = 0;
+    while (pos < uart_out_len) {
+      int w = write(uart_out, &uart_out_buf[pos], uart_out_len - pos);
+      if (w <= 0) {
+        cerr << "patemu: error: Cannot write UART output" << endl;
+        break;
+      }
+      pos += w;
+    }
+    uart_out_len = 0;
+  }
+
+  // Read whatever UART input is available into the input ring buffer
+  void uart_fill(int uart_in) {
+    struct pollfd pfd;
+    pfd.fd = uart_in;
+    pfd.events = POLLIN;
+    while (((uart_in_head + 1) % UART_BUF_SIZE) != uart_in_tail
+           && poll(&pfd, 1, 0) > 0) {
+      // read up to the end of the buffer or the read position
+      unsigned end = uart_in_tail > uart_in_head ? uart_in_tail - 1 : UART_BUF_SIZE;
+      if (uart_in_tail == 0 && end == UART_BUF_SIZE) {
+        end = UART_BUF_SIZE - 1;
+      }
+      int r = read(uart_in, &uart_in_buf[uart_in_head], end - uart_in_head);
+      if (r <= 0) {
+        if (r < 0) {
+          cerr << "patemu: error: Cannot read UART input" << endl;
+        }
+        break;
+      }
+      uart_in_head = (uart_in_head + r) % UART_BUF_SIZE;
+    }
+  }
+
+  void setBatch(bool on) {
+    batch = on;
+  }
+
+  // Run up to n cycles without host I/O, UART data is exchanged with the
+  // host only before and after the batch. Returns true when halting.
+  bool run_batch(unsigned long n, int uart_in, int uart_out, bool &halt)
+  {
+    bool stop = false;
+    uart_fill(uart_in);
+    for (unsigned long i = 0; i < n; i++) {
+      tick(uart_in, uart_out);
+      emu_extmem();
+      // Return to address 0 halts the execution after one more iteration
+      if (halt) {
+        stop = true;
+        break;
+      }
+      halt = at_halt();
+    }
+    uart_flush(uart_out);
+    return stop;
+  }
+
   void emu_keys(void){
 #ifdef IO_KEYS
     if ((rand() % 0x10000) == 0) {
@@ -246,164 +438,97 @@ public:
     outputTarget = &cout;
   }
 
-  //static val_t readelf(istream &is, Patmos_t *c)
-  val_t readelf(istream &is)
+  // Load an ELF file into external memory, returns the entry point
+  val_t readelf(const char *path, double *load_secs)
   {
-    vector<unsigned char> elfbuf;
-    elfbuf.reserve(1 << 20);
-
-    // read the whole stream.
-    while (!is.eof())
-    {
-      char buf[1024];
-
-      // read into buffer
-      is.read(&buf[0], sizeof(buf));
-
-      // check how much was read
-      streamsize count = is.gcount();
-      assert(count <= 1024);
-
-      // write into main memory
-      for (unsigned i = 0; i < count; i++)
-        elfbuf.push_back(buf[i]);
-    }
-
-    // check libelf version
-    elf_version(EV_CURRENT);
-
-    // open elf binary
-    Elf *elf = elf_memory((char *)&elfbuf[0], elfbuf.size());
-    assert(elf);
-
-    // check file kind
-    Elf_Kind ek = elf_kind(elf);
-    if (ek != ELF_K_ELF)
-    {
-      cerr << "readelf: ELF file must be of kind ELF.\n";
-      exit(EXIT_FAILURE);
-    }
-
-    // get elf header
-    GElf_Ehdr hdr;
-    GElf_Ehdr *tmphdr = gelf_getehdr(elf, &hdr);
-    assert(tmphdr);
+    return elf_load(path, [this](const elf_segment &seg) { load_extmem(seg); },
+                    load_secs);
+  }
 
-    if (hdr.e_machine != 0xBEEB)
-    {
-      cerr << "readelf: unsupported architecture: ELF file is not a Patmos ELF file.\n";
-      exit(EXIT_FAILURE);
+  // Copy a segment into external memory
+  void load_extmem(const elf_segment &seg)
+  {
+    val_t addr = seg.paddr >> 2;
+    size_t full = seg.filesz >> 2;
+    size_t words = elf_segment_words(seg);
+    for (size_t k = 0; k < full; k++) {
+      write_extmem(addr + k, elf_word(seg.data + (k << 2)));
     }
-
-    // check class
-    int ec = gelf_getclass(elf);
-    if (ec != ELFCLASS32)
-    {
-      cerr << "readelf: unsupported architecture: ELF file is not a 32bit Patmos ELF file.\n";
-      exit(EXIT_FAILURE);
+    // partial word at the end of the file image and zero-initialized data
+    for (size_t k = full; k < words; k++) {
+      write_extmem(addr + k, elf_segment_word(seg, k));
     }
-
-    // get program headers
-    size_t n;
-    int ntmp = elf_getphdrnum(elf, &n);
-    assert(ntmp == 0);
-
-    for (size_t i = 0; i < n; i++)
-    {
-      // get program header
-      GElf_Phdr phdr;
-      GElf_Phdr *phdrtmp = gelf_getphdr(elf, i, &phdr);
-      assert(phdrtmp);
-
-      if (phdr.p_type == PT_LOAD)
-      {
-        // some assertions
-        //assert(phdr.p_vaddr == phdr.p_paddr);
-        assert(phdr.p_filesz <= phdr.p_memsz);
-
-        // copy from the buffer into memory
-        for (size_t k = 0; k < phdr.p_memsz; k++)
-        {
-
-          if (((phdr.p_paddr + k) & 0x3) == 0)
-          {
-            // Address maps to SRAM and is at a word boundary
-            val_t word = k >= phdr.p_filesz ? 0 : (((val_t)elfbuf[phdr.p_offset + k + 0] << 24) | ((val_t)elfbuf[phdr.p_offset + k + 1] << 16) | ((val_t)elfbuf[phdr.p_offset + k + 2] << 8) | ((val_t)elfbuf[phdr.p_offset + k + 3] << 0));
-
-            val_t addr = ((phdr.p_paddr + k) >> 2);
-            write_extmem(addr, word);
-          }
-        }
-      }
-    }
-
-    // get entry point
-    val_t entry = hdr.e_entry;
-
-    elf_end(elf);
-
-    return entry;
   }
 
 #ifdef EXTMEM_SSRAM32CTRL // TODO: test this
   void write_extmem(val_t address, val_t word)
   {
-    ram_buf[address] = word; // This gives segmentation fault dumb on second run!
+    ram_buf[address] = word;
   }
 
   void init_extmem() {
-    // only needed for random init
-    for (int i = 0; i < (1 << EXTMEM_ADDR_BITS); i++) {
-      write_extmem(i, rand());
-    }
+    // only needed for random init, pages are filled when first touched
+    ram_buf.set_random(true);
   } 
 
-static void emu_extmem() {
-  static uint32_t addr_cnt;
-  static uint32_t address;
-  static uint32_t counter;
-
-  // Start of request
-  if (c->io_sSRam32CtrlPins_ramOut_nadsc != 1) {
-    address = c->Patmos__io_sSRam32CtrlPins_ramOut_addr.to_ulong();
-    addr_cnt = address;
-    counter = 0;
-  }
+  void emu_extmem() {
+    // Start of request
+    if (c->io_SSRam32Ctrl_ramOut_nadsc != 1) {
+      ssram_address = c->io_SSRam32Ctrl_ramOut_addr;
+      ssram_addr_cnt = ssram_address;
+      ssram_counter = 0;
+    }
 
-  // Advance address for burst
-  if (c->io_sSRam32CtrlPins_ramOut_nadv != 1) {
-    addr_cnt++;
-  }
+    // Advance address for burst
+    if (c->io_SSRam32Ctrl_ramOut_nadv != 1) {
+      ssram_addr_cnt++;
+    }
 
-  // Read from external memory
-  if (c->io_sSRam32CtrlPins_ramOut_noe != 1) {
-    counter++;
-    if (counter >= SRAM_CYCLES) {
-      c->io_sSRam32CtrlPins_ramIn_din = ram_buf[address];
-      if (address <= addr_cnt) {
-        address++;
+    // Read from external memory
+    if (c->io_SSRam32Ctrl_ramOut_noe != 1) {
+      ssram_counter++;
+      if (ssram_counter >= SRAM_CYCLES) {
+        c->io_SSRam32Ctrl_ramIn_din = ram_buf[ssram_address];
+        if (ssram_address <= ssram_addr_cnt) {
+          ssram_address++;
+        }
       }
     }
-  }
 
-  // Write to external memory
-  if (c->io_sSRam32CtrlPins_ramOut_nbwe == 0) {
-    uint32_t nbw = c->io_sSRam32CtrlPins_ramOut_nbw;
-    uint32_t mask = 0x00000000;
-    for (unsigned i = 0; i < 4; i++) {
-      if ((nbw & (1 << i)) == 0) {
-        mask |= 0xff << (i*8);
+    // Write to external memory
+    if (c->io_SSRam32Ctrl_ramOut_nbwe == 0) {
+      uint32_t nbw = c->io_SSRam32Ctrl_ramOut_nbw;
+      uint32_t mask = 0x00000000;
+      for (unsigned i = 0; i < 4; i++) {
+        if ((nbw & (1 << i)) == 0) {
+          mask |= 0xff << (i*8);
+        }
       }
-    }
 
-    ram_buf[address] &= ~mask;
-    ram_buf[address] |= mask & ((unsigned long int) c->io_sSRam32CtrlPins_ramOut_dout);
+      ram_buf[ssram_address] &= ~mask;
+      ram_buf[ssram_address] |= mask & ((unsigned long int) c->io_SSRam32Ctrl_ramOut_dout);
 
-    if (address <= addr_cnt) {
-      address++;
+      if (ssram_address <= ssram_addr_cnt) {
+        ssram_address++;
+      }
     }
   }
-}
+
+#ifdef EMU_SAVABLE
+  void save_extmem(VerilatedSave &os) {
+    os.write(&ssram_addr_cnt, sizeof(ssram_addr_cnt));
+    os.write(&ssram_address, sizeof(ssram_address));
+    os.write(&ssram_counter, sizeof(ssram_counter));
+    ram_buf.save(os);
+  }
+
+  void restore_extmem(VerilatedRestore &is) {
+    is.read(&ssram_addr_cnt, sizeof(ssram_addr_cnt));
+    is.read(&ssram_address, sizeof(ssram_address));
+    is.read(&ssram_counter, sizeof(ssram_counter));
+    ram_buf.restore(is);
+  }
+#endif /* EMU_SAVABLE */
 #elif defined EXTMEM_SRAMCTRL
   void write_extmem(val_t address, val_t word) {
     ram_buf[(address << 1) | 0] = word & 0xffff;
@@ -411,10 +536,8 @@ static void emu_extmem() {
   }
 
   void init_extmem() {
-    // only needed for random init
-    for (int i = 0; i < (1 << EXTMEM_ADDR_BITS)/2; i++) {
-      write_extmem(i, rand());
-    }
+    // only needed for random init, pages are filled when first touched
+    ram_buf.set_random(true);
   }
 
   void emu_extmem() {
@@ -435,10 +558,125 @@ static void emu_extmem() {
       ram_buf[address] |= mask & ((unsigned long int) c->io_SRamCtrl_ramOut_dout);
     }
   }
+
+#ifdef EMU_SAVABLE
+  void save_extmem(VerilatedSave &os) {
+    ram_buf.save(os);
+  }
+
+  void restore_extmem(VerilatedRestore &is) {
+    ram_buf.restore(is);
+  }
+#endif /* EMU_SAVABLE */
+#elif defined EXTMEM_MEMBRIDGE
+  void write_extmem(val_t address, val_t word) {
+    ram_buf[address] = word;
+  }
+
+  void init_extmem() {
+    // only needed for random init, pages are filled when first touched
+    ram_buf.set_random(true);
+  }
+
+  void set_mem_timing(unsigned latency, unsigned interval) {
+    mem_latency = latency;
+    mem_interval = interval;
+  }
+
+  // Transaction-level model of the OCP burst port, whole bursts are
+  // transferred from and to the backing store at once
+  void emu_extmem() {
+    c->io_MemBridge_S_CmdAccept = 0;
+    c->io_MemBridge_S_DataAccept = 0;
+    c->io_MemBridge_S_Resp = OCP_RESP_NULL;
+
+    switch (ocp_state) {
+    case OCP_IDLE:
+      if (c->io_MemBridge_M_Cmd == OCP_CMD_RD) {
+        ocp_addr = (c->io_MemBridge_M_Addr >> 2) & ~(OCP_BURST_LENGTH-1);
+        for (unsigned i = 0; i < OCP_BURST_LENGTH; i++) {
+          ocp_burst[i] = ram_buf[ocp_addr + i];
+        }
+        c->io_MemBridge_S_CmdAccept = 1;
+        ocp_state = OCP_READ;
+        ocp_cnt = 0;
+        ocp_ready = m_tickcount + (mem_latency > 0 ? mem_latency : 1);
+      } else if (c->io_MemBridge_M_Cmd == OCP_CMD_WR) {
+        ocp_addr = (c->io_MemBridge_M_Addr >> 2) & ~(OCP_BURST_LENGTH-1);
+        c->io_MemBridge_S_CmdAccept = 1;
+        ocp_state = OCP_WRITE;
+        ocp_cnt = 0;
+        ocp_ready = m_tickcount;
+        emu_extmem_wrdata();
+      }
+      break;
+    case OCP_READ:
+      if (m_tickcount >= ocp_ready) {
+        c->io_MemBridge_S_Resp = OCP_RESP_DVA;
+        c->io_MemBridge_S_Data = ocp_burst[ocp_cnt++];
+        ocp_ready = m_tickcount + mem_interval;
+        if (ocp_cnt == OCP_BURST_LENGTH) {
+          ocp_state = OCP_IDLE;
+        }
+      }
+      break;
+    case OCP_WRITE:
+      if (ocp_cnt < OCP_BURST_LENGTH) {
+        emu_extmem_wrdata();
+      } else if (m_tickcount >= ocp_ready) {
+        c->io_MemBridge_S_Resp = OCP_RESP_DVA;
+        ocp_state = OCP_IDLE;
+      }
+      break;
+    }
+  }
+
+  // Accept a write data word, the burst is committed with its last word
+  void emu_extmem_wrdata() {
+    if (c->io_MemBridge_M_DataValid != 1 || m_tickcount < ocp_ready) {
+      return;
+    }
+    c->io_MemBridge_S_DataAccept = 1;
+    uint32_t be = c->io_MemBridge_M_DataByteEn;
+    uint32_t mask = 0x00000000;
+    for (unsigned i = 0; i < 4; i++) {
+      if ((be & (1 << i)) != 0) {
+        mask |= 0xff << (i*8);
+      }
+    }
+    uint32_t &word = ram_buf[ocp_addr + ocp_cnt];
+    word = (word & ~mask) | (c->io_MemBridge_M_Data & mask);
+    ocp_cnt++;
+    ocp_ready = m_tickcount + (ocp_cnt < OCP_BURST_LENGTH ? mem_interval : mem_latency);
+  }
+
+#ifdef EMU_SAVABLE
+  void save_extmem(VerilatedSave &os) {
+    os.write(&ocp_state, sizeof(ocp_state));
+    os.write(&ocp_addr, sizeof(ocp_addr));
+    os.write(ocp_burst, sizeof(ocp_burst));
+    os.write(&ocp_cnt, sizeof(ocp_cnt));
+    os.write(&ocp_ready, sizeof(ocp_ready));
+    ram_buf.save(os);
+  }
+
+  void restore_extmem(VerilatedRestore &is) {
+    is.read(&ocp_state, sizeof(ocp_state));
+    is.read(&ocp_addr, sizeof(ocp_addr));
+    is.read(ocp_burst, sizeof(ocp_burst));
+    is.read(&ocp_cnt, sizeof(ocp_cnt));
+    is.read(&ocp_ready, sizeof(ocp_ready));
+    ram_buf.restore(is);
+  }
+#endif /* EMU_SAVABLE */
 #else
 void write_extmem(val_t address, val_t word) {}
 void init_extmem() {}
 void emu_extmem() {}
+#ifdef EMU_SAVABLE
+void save_extmem(VerilatedSave &os) {}
+void restore_extmem(VerilatedRestore &is) {}
+#endif /* EMU_SAVABLE */
 #endif
 
 
@@ -784,6 +1022,225 @@ void emu_extmem() {}
 #endif /* ICACHE_LINE */
     }
   }
+#ifdef EMU_SAVABLE
+  // Checkpoint layout: header, harness state, external memory and
+  // finally the Verilated model itself
+  void save_checkpoint(const char *path)
+  {
+    VerilatedSave os;
+    os.open(path);
+    if (!os.isOpen()) {
+      cerr << "patemu: error: Cannot open checkpoint file " << path << endl;
+      exit(EXIT_FAILURE);
+    }
+    uint32_t hdr[4] = { CKPT_MAGIC, CKPT_VERSION, CORE_COUNT, (uint32_t)EXTMEM_SIZE };
+    os.write(hdr, sizeof(hdr));
+    os.write(&m_tickcount, sizeof(m_tickcount));
+    os.write(&baud_counter, sizeof(baud_counter));
+    save_extmem(os);
+    os << *c;
+    os.close();
+  }
+
+  void restore_checkpoint(const char *path)
+  {
+    VerilatedRestore is;
+    is.open(path);
+    if (!is.isOpen()) {
+      cerr << "patemu: error: Cannot open checkpoint file " << path << endl;
+      exit(EXIT_FAILURE);
+    }
+    uint32_t hdr[4];
+    is.read(hdr, sizeof(hdr));
+    if (hdr[0] != CKPT_MAGIC || hdr[1] != CKPT_VERSION) {
+      cerr << "patemu: error: " << path << " is not a checkpoint file" << endl;
+      exit(EXIT_FAILURE);
+    }
+    if (hdr[2] != CORE_COUNT || hdr[3] != (uint32_t)EXTMEM_SIZE) {
+      cerr << "patemu: error: Checkpoint " << path
+           << " was saved with a different configuration" << endl;
+      exit(EXIT_FAILURE);
+    }
+    is.read(&m_tickcount, sizeof(m_tickcount));
+    is.read(&baud_counter, sizeof(baud_counter));
+    restore_extmem(is);
+    is >> *c;
+    is.close();
+  }
+#endif /* EMU_SAVABLE */
+
+  // Start sampling the performance counters of all cores every
+  // <interval> cycles
+  bool perf_open(const char *path, unsigned long interval)
+  {
+    #if CORE_COUNT > 1
+    perf_cores[0] = c->__PVT__Patmos__DOT__cores_0;
+    perf_cores[1] = c->__PVT__Patmos__DOT__cores_1;
+    #endif
+    #if CORE_COUNT > 2
+    perf_cores[2] = c->__PVT__Patmos__DOT__cores_2;
+    #endif
+    #if CORE_COUNT > 3
+    perf_cores[3] = c->__PVT__Patmos__DOT__cores_3;
+    #endif
+    #if CORE_COUNT > 4
+    perf_cores[4] = c->__PVT__Patmos__DOT__cores_4;
+    #endif
+    #if CORE_COUNT > 5
+    perf_cores[5] = c->__PVT__Patmos__DOT__cores_5;
+    #endif
+    #if CORE_COUNT > 6
+    perf_cores[6] = c->__PVT__Patmos__DOT__cores_6;
+    #endif
+    #if CORE_COUNT > 7
+    perf_cores[7] = c->__PVT__Patmos__DOT__cores_7;
+    #endif
+    #if CORE_COUNT > 8
+    perf_cores[8] = c->__PVT__Patmos__DOT__cores_8;
+    #endif
+    #if CORE_COUNT > 9
+    perf_cores[9] = c->__PVT__Patmos__DOT__cores_9;
+    #endif
+    #if CORE_COUNT > 10
+    perf_cores[10] = c->__PVT__Patmos__DOT__cores_10;
+    #endif
+    #if CORE_COUNT > 11
+    perf_cores[11] = c->__PVT__Patmos__DOT__cores_11;
+    #endif
+    #if CORE_COUNT > 12
+    perf_cores[12] = c->__PVT__Patmos__DOT__cores_12;
+    #endif
+    #if CORE_COUNT > 13
+    perf_cores[13] = c->__PVT__Patmos__DOT__cores_13;
+    #endif
+    #if CORE_COUNT > 14
+    perf_cores[14] = c->__PVT__Patmos__DOT__cores_14;
+    #endif
+    #if CORE_COUNT > 15
+    perf_cores[15] = c->__PVT__Patmos__DOT__cores_15;
+    #endif
+    return perf.open(path, PERF_CORE_COUNT, interval, m_tickcount);
+  }
+
+  void itrace_close(void)
+  {
+    itrace.close();
+  }
+
+  void perf_close(void)
+  {
+    perf.close(m_tickcount);
+  }
+
+  // Add the events of the current cycle
+  void perf_count(void)
+  {
+    #if CORE_COUNT == 1
+    uint64_t *cnt = perf.core(0);
+    cnt[PERF_IC_HIT] += c->Patmos__DOT__cores_0__DOT__io_perf_ic_hit;
+    cnt[PERF_IC_MISS] += c->Patmos__DOT__cores_0__DOT__io_perf_ic_miss;
+    cnt[PERF_DC_HIT] += c->Patmos__DOT__cores_0__DOT__io_perf_dc_hit;
+    cnt[PERF_DC_MISS] += c->Patmos__DOT__cores_0__DOT__io_perf_dc_miss;
+    cnt[PERF_SC_SPILL] += c->Patmos__DOT__cores_0__DOT__io_perf_sc_spill;
+    cnt[PERF_SC_FILL] += c->Patmos__DOT__cores_0__DOT__io_perf_sc_fill;
+    cnt[PERF_WC_HIT] += c->Patmos__DOT__cores_0__DOT__io_perf_wc_hit;
+    cnt[PERF_WC_MISS] += c->Patmos__DOT__cores_0__DOT__io_perf_wc_miss;
+    cnt[PERF_MEM_READ] += c->Patmos__DOT__cores_0__DOT__io_perf_mem_read;
+    cnt[PERF_MEM_WRITE] += c->Patmos__DOT__cores_0__DOT__io_perf_mem_write;
+    cnt[PERF_STALL] += !c->Patmos__DOT__cores_0__DOT__enableReg;
+    cnt[PERF_BUS_WAIT] += (c->Patmos__DOT__cores_0__DOT__io_memPort_M_Cmd != 0
+                           && !c->Patmos__DOT__cores_0__DOT__io_memPort_S_CmdAccept);
+    #endif
+    #if CORE_COUNT > 1
+    for (unsigned i = 0; i < PERF_CORE_COUNT; i++) {
+      VPatmos_PatmosCore *core = perf_cores[i];
+      uint64_t *cnt = perf.core(i);
+      cnt[PERF_IC_HIT] += core->io_perf_ic_hit;
+      cnt[PERF_IC_MISS] += core->io_perf_ic_miss;
+      cnt[PERF_DC_HIT] += core->io_perf_dc_hit;
+      cnt[PERF_DC_MISS] += core->io_perf_dc_miss;
+      cnt[PERF_SC_SPILL] += core->io_perf_sc_spill;
+      cnt[PERF_SC_FILL] += core->io_perf_sc_fill;
+      cnt[PERF_WC_HIT] += core->io_perf_wc_hit;
+      cnt[PERF_WC_MISS] += core->io_perf_wc_miss;
+      cnt[PERF_MEM_READ] += core->io_perf_mem_read;
+      cnt[PERF_MEM_WRITE] += core->io_perf_mem_write;
+      cnt[PERF_STALL] += !core->__PVT__enableReg;
+      cnt[PERF_BUS_WAIT] += (core->io_memPort_M_Cmd != 0
+                             && !core->io_memPort_S_CmdAccept);
+    }
+    #endif
+  }
+
+  bool itrace_open(const char *path, bool delta)
+  {
+    return itrace.open(path, ITRACE_BUNDLE | (delta ? ITRACE_DELTA : 0));
+  }
+
+  // Record the bundle in decode and the registers of core 0, in the same
+  // cycles and with the same PC as print_state()
+  void trace_instr(void)
+  {
+    // The register file is a VlUnpacked under Verilator 5, copy it
+    uint32_t regs[32];
+    #if CORE_COUNT == 1
+    if (c->Patmos__DOT__cores_0__DOT__enableReg) {
+      for (int i = 0; i < 32; i++) {
+        regs[i] = c->Patmos__DOT__cores_0__DOT__decode__DOT__rf__DOT__rf[i];
+      }
+      itrace.record((itrace_base + c->Patmos__DOT__cores_0__DOT__fetch__DOT__pcNext) * 4
+                    - c->Patmos__DOT__cores_0__DOT__fetch__DOT__relBaseNext * 4,
+                    c->Patmos__DOT__cores_0__DOT__decode__DOT__decReg_instr_a,
+                    c->Patmos__DOT__cores_0__DOT__decode__DOT__decReg_instr_b,
+                    regs);
+      itrace_base = c->Patmos__DOT__cores_0__DOT__icache__DOT__repl__DOT__callRetBaseNext;
+    }
+    #endif
+    #if CORE_COUNT > 1
+    if (c->__PVT__Patmos__DOT__cores_0->__PVT__enableReg) {
+      for (int i = 0; i < 32; i++) {
+        regs[i] = c->__PVT__Patmos__DOT__cores_0->__PVT__decode__DOT__rf__DOT__rf[i];
+      }
+      itrace.record((itrace_base + c->__PVT__Patmos__DOT__cores_0->fetch__DOT__pcNext) * 4
+                    - c->__PVT__Patmos__DOT__cores_0->fetch__DOT__relBaseNext * 4,
+                    c->__PVT__Patmos__DOT__cores_0->decode__DOT__decReg_instr_a,
+                    c->__PVT__Patmos__DOT__cores_0->decode__DOT__decReg_instr_b,
+                    regs);
+      itrace_base = c->__PVT__Patmos__DOT__cores_0->icache__DOT__repl__DOT__callRetBaseNext;
+    }
+    #endif
+  }
+
+  // Byte address of the bundle core 0 is fetching
+  unsigned long get_pc(void)
+  {
+    #if CORE_COUNT == 1
+    return (c->Patmos__DOT__cores_0__DOT__fetch__DOT__pcReg
+            - c->Patmos__DOT__cores_0__DOT__fetch__DOT__relBaseReg
+            + c->Patmos__DOT__cores_0__DOT__fetch__DOT__relocReg) * 4;
+    #endif
+    #if CORE_COUNT > 1
+    return (c->__PVT__Patmos__DOT__cores_0->fetch__DOT__pcReg
+            - c->__PVT__Patmos__DOT__cores_0->fetch__DOT__relBaseReg
+            + c->__PVT__Patmos__DOT__cores_0->fetch__DOT__relocReg) * 4;
+    #endif
+  }
+
+  // Check whether core 0 returns to address 0
+  bool at_halt(void)
+  {
+    #if CORE_COUNT == 1
+    return ((c->Patmos__DOT__cores_0__DOT__memory__DOT__memReg_mem_brcf == 1
+             || c->Patmos__DOT__cores_0__DOT__memory__DOT__memReg_mem_ret == 1)
+            && c->Patmos__DOT__cores_0__DOT__icache__DOT__repl__DOT__callRetBaseReg == 0);
+    #endif
+    #if CORE_COUNT > 1
+    return ((c->__PVT__Patmos__DOT__cores_0->__PVT__memory__DOT__memReg_mem_brcf == 1
+             || c->__PVT__Patmos__DOT__cores_0->__PVT__memory__DOT__memReg_mem_ret == 1)
+            && c->__PVT__Patmos__DOT__cores_0->__PVT__icache__DOT__repl__DOT__callRetBaseReg == 0);
+    #endif
+  }
+
   void print_state()
   {
     static unsigned int baseReg = 0;
@@ -826,9 +1283,38 @@ static void help(ostream &out) {
   out << endl << "Options:" << endl
       << "  -h            Print this help" << endl
       << "  -i            Initialize memory with random values" << endl
-      << "  -l <N>        Stop after <N> cycles" << endl
-      << "  -v            Dump wave forms file \"Patmos.vcd\"" << endl
+      << "  -l <N>        Stop after <N> cycles, exit with status " << EXIT_LIMIT << endl
+      << "  -v            Dump wave forms file \"" TRACE_FILE "\"" << endl
+      << "  --trace-start <N>" << endl
+      << "                Dump wave forms from cycle <N> on" << endl
+      << "  --trace-stop <N>" << endl
+      << "                Stop dumping wave forms at cycle <N>" << endl
+      << "  --trace-pc <addr>" << endl
+      << "                Start dumping wave forms when core 0 fetches from <addr>" << endl
+      << "  --trace-uart <byte>" << endl
+      << "                Start dumping wave forms when <byte> is written to the UART" << endl
+      << "  --trace-cycles <N>" << endl
+      << "                Dump <N> cycles of wave forms after a trigger" << endl
       << "  -r            Print register values in each cycle" << endl
+      << "  --itrace <file>" << endl
+      << "                Write a binary instruction trace to <file>, see patrace" << endl
+      << "  --itrace-delta" << endl
+      << "                Delta-encode PCs and register values in the instruction trace" << endl
+      << "  -j <N>        Run the model on <N> threads (needs a multi-threaded build)" << endl
+      << "  -s            Print simulation speed in cycles per second" << endl
+      << "  -b <N>        Run in batches of <N> cycles, doing host I/O only between batches" << endl
+      << "  -P <N>        Write per-core performance counters every <N> cycles" << endl
+      << "                to \"Patmos-perf.csv\"" << endl
+      << "  --save-checkpoint <N> <file>" << endl
+      << "                Save the emulator state to <file> at cycle <N>" << endl
+      << "  --restore <file>" << endl
+      << "                Continue from a checkpoint instead of loading an ELF file" << endl
+      #ifdef EXTMEM_MEMBRIDGE
+      << "  --mem-latency <N>" << endl
+      << "                Cycles from a memory command to its first data word (default 3)" << endl
+      << "  --mem-interval <N>" << endl
+      << "                Cycles per data word of a memory burst (default 1)" << endl
+      #endif /* EXTMEM_MEMBRIDGE */
       #ifdef IO_KEYS
       << "  -k            Simulate random input from keys" << endl
       #endif /* IO_KEYS */
@@ -840,30 +1326,164 @@ static void help(ostream &out) {
 }
    
 
+// Simulation speed report, printed when the emulator exits
+static Emulator *speed_emu = NULL;
+static unsigned speed_threads = 0;
+static chrono::steady_clock::time_point speed_start;
+
+// Trace and statistics files, closed when the emulator exits
+static Emulator *output_emu = NULL;
+
+static void close_outputs(void)
+{
+  output_emu->itrace_close();
+  output_emu->perf_close();
+}
+
+static void print_speed(void)
+{
+  double secs = chrono::duration<double>(chrono::steady_clock::now() - speed_start).count();
+  long int cycles = speed_emu->get_tick_count();
+  cerr << "patemu: " << cycles << " cycles in " << secs << " s, "
+       << (secs > 0 ? cycles / secs : 0) << " cycles/s"
+       << " (" << CORE_COUNT << " cores";
+  if (speed_threads > 0) {
+    cerr << ", " << speed_threads << " threads";
+  }
+  cerr << ")" << endl;
+}
+
 int main(int argc, char **argv, char **env)
 {
   Verilated::commandArgs(argc, argv);
-  Emulator *emu = new Emulator();
   int opt;
   int limit = -1;
   bool halt = false;
   bool reg_print = false;
+  bool vcd = false;
+  bool random = false;
+  bool speed = false;
+  unsigned threads = 0;
+  unsigned long batch = 0;
+  unsigned long perf_interval = 0;
+  long ckpt_cycle = -1;
+  const char *ckpt_file = NULL;
+  const char *restore_file = NULL;
+  const char *itrace_file = NULL;
+  bool itrace_delta = false;
+  unsigned mem_latency = 3;
+  unsigned mem_interval = 1;
+
+  TraceWindow trace_win;
+
+  enum { OPT_SAVE_CHECKPOINT = 256, OPT_RESTORE, OPT_MEM_LATENCY, OPT_MEM_INTERVAL,
+         OPT_TRACE_START, OPT_TRACE_STOP, OPT_TRACE_PC, OPT_TRACE_UART, OPT_TRACE_CYCLES,
+         OPT_ITRACE, OPT_ITRACE_DELTA };
+  static struct option long_options[] = {
+    { "save-checkpoint", required_argument, NULL, OPT_SAVE_CHECKPOINT },
+    { "restore",         required_argument, NULL, OPT_RESTORE },
+    { "trace-start",     required_argument, NULL, OPT_TRACE_START },
+    { "trace-stop",      required_argument, NULL, OPT_TRACE_STOP },
+    { "trace-pc",        required_argument, NULL, OPT_TRACE_PC },
+    { "trace-uart",      required_argument, NULL, OPT_TRACE_UART },
+    { "trace-cycles",    required_argument, NULL, OPT_TRACE_CYCLES },
+    { "itrace",          required_argument, NULL, OPT_ITRACE },
+    { "itrace-delta",    no_argument,       NULL, OPT_ITRACE_DELTA },
+    #ifdef EXTMEM_MEMBRIDGE
+    { "mem-latency",     required_argument, NULL, OPT_MEM_LATENCY },
+    { "mem-interval",    required_argument, NULL, OPT_MEM_INTERVAL },
+    #endif /* EXTMEM_MEMBRIDGE */
+    { NULL, 0, NULL, 0 }
+  };
 
   int uart_in = STDIN_FILENO;
   int uart_out = STDOUT_FILENO;
   bool keys = false;
   
   //Parse Arguments
-  while ((opt = getopt(argc, argv, "hvl:iO:I:rk")) != -1){
+  while ((opt = getopt_long(argc, argv, "hvl:iO:I:rkj:sb:P:", long_options, NULL)) != -1){
     switch (opt) {
       case 'v':
-        emu->setTrace();
+        vcd = true;
         break;
       case 'l':
         limit = atoi(optarg);
         break;
       case 'i':
-        emu->init_extmem();
+        random = true;
+        break;
+      case 'j':
+        threads = atoi(optarg);
+        if (threads < 1) {
+          cerr << argv[0] << ": error: Invalid number of threads " << optarg << endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 's':
+        speed = true;
+        break;
+      case 'b':
+        batch = strtoul(optarg, NULL, 0);
+        if (batch < 1) {
+          cerr << argv[0] << ": error: Invalid batch size " << optarg << endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case 'P':
+        perf_interval = strtoul(optarg, NULL, 0);
+        if (perf_interval < 1) {
+          cerr << argv[0] << ": error: Invalid sampling interval " << optarg << endl;
+          exit(EXIT_FAILURE);
+        }
+        break;
+      case OPT_SAVE_CHECKPOINT:
+        // takes the file name as a second argument
+        if (optind >= argc) {
+          cerr << argv[0] << ": error: --save-checkpoint needs a cycle and a file name" << endl;
+          exit(EXIT_FAILURE);
+        }
+        ckpt_cycle = atol(optarg);
+        ckpt_file = argv[optind++];
+        break;
+      case OPT_RESTORE:
+        restore_file = optarg;
+        break;
+      case OPT_ITRACE:
+        itrace_file = optarg;
+        break;
+      case OPT_ITRACE_DELTA:
+        itrace_delta = true;
+        break;
+      // the trace window options imply -v
+      case OPT_TRACE_START:
+        trace_win.set_start(strtoul(optarg, NULL, 0));
+        vcd = true;
+        break;
+      case OPT_TRACE_STOP:
+        trace_win.set_stop(strtoul(optarg, NULL, 0));
+        vcd = true;
+        break;
+      case OPT_TRACE_PC:
+        trace_win.set_pc_trigger(strtol(optarg, NULL, 0));
+        vcd = true;
+        break;
+      case OPT_TRACE_UART:
+        trace_win.set_uart_trigger(strtol(optarg, NULL, 0) & 0xff);
+        vcd = true;
+        break;
+      case OPT_TRACE_CYCLES:
+        trace_win.set_cycles(strtoul(optarg, NULL, 0));
+        vcd = true;
+        break;
+      case OPT_MEM_LATENCY:
+        mem_latency = atoi(optarg);
+        break;
+      case OPT_MEM_INTERVAL:
+        mem_interval = atoi(optarg);
+        if (mem_interval < 1) {
+          cerr << argv[0] << ": error: Invalid memory interval " << optarg << endl;
+          exit(EXIT_FAILURE);
+        }
         break;
       #ifdef IO_UART
       case 'I':
@@ -908,71 +1528,162 @@ int main(int argc, char **argv, char **env)
     }
   }
 
-  
-  emu->reset(1);
-  emu->tick(uart_in, uart_out);
-  emu->UART_init();
+  #ifndef EMU_SAVABLE
+  if (ckpt_file != NULL || restore_file != NULL) {
+    cerr << argv[0] << ": error: Checkpoints need an emulator built with EMU_SAVABLE=1" << endl;
+    exit(EXIT_FAILURE);
+  }
+  #endif
 
-  val_t entry = 0;
-  if (optind < argc)
-  {
-    ifstream *fs = new ifstream(argv[optind]);
-    if (!fs->good())
-    {
-      cerr << "Error: Cannot open elf file " << endl;
-      exit(EXIT_FAILURE);
+  if (batch > 0 && (reg_print || keys)) {
+    cerr << argv[0] << ": error: Batch mode cannot be combined with -r or -k" << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // The thread pool must be sized before the model is constructed
+  if (threads > 0) {
+    #if VERILATOR_VERSION_INTEGER >= 5000000
+    Verilated::defaultContextp()->threads(threads);
+    #else
+    if (threads != (unsigned)Verilated::threads()) {
+      cerr << argv[0] << ": warning: Thread count is fixed at build time,"
+           << " rebuild with EMU_THREADS=" << threads << endl;
     }
-    entry = emu->readelf(*fs);
+    #endif
   }
 
-  emu->reset(5);
-  emu->tick(uart_in, uart_out);
+  Emulator *emu = new Emulator();
+  if (vcd) {
+    emu->traceWindow() = trace_win;
+    emu->setTrace();
+  }
+  if (random) {
+    emu->init_extmem();
+  }
+  #ifdef EXTMEM_MEMBRIDGE
+  emu->set_mem_timing(mem_latency, mem_interval);
+  #endif /* EXTMEM_MEMBRIDGE */
+
+  if (restore_file != NULL) {
+    // The checkpoint holds the loaded program and all model state
+    emu->UART_init();
+    #ifdef EMU_SAVABLE
+    emu->restore_checkpoint(restore_file);
+    #endif
+  } else {
+    emu->reset(1);
+    emu->tick(uart_in, uart_out);
+    emu->UART_init();
+
+    val_t entry = 0;
+    if (optind < argc)
+    {
+      double load_secs;
+      entry = emu->readelf(argv[optind], &load_secs);
+      if (speed) {
+        cerr << "patemu: loaded " << argv[optind] << " in "
+             << load_secs * 1000 << " ms" << endl;
+      }
+    }
+
+    emu->reset(5);
+    emu->tick(uart_in, uart_out);
+
+    emu->init_icache(entry);
+  }
 
-  emu->init_icache(entry);
 
+  if (itrace_file != NULL && !emu->itrace_open(itrace_file, itrace_delta)) {
+    cerr << argv[0] << ": error: Cannot open instruction trace " << itrace_file << endl;
+    exit(EXIT_FAILURE);
+  }
+  if (perf_interval > 0 && !emu->perf_open("Patmos-perf.csv", perf_interval)) {
+    cerr << argv[0] << ": error: Cannot open \"Patmos-perf.csv\"" << endl;
+    exit(EXIT_FAILURE);
+  }
+  #if CORE_COUNT > PERF_CORE_COUNT
+  if (perf_interval > 0) {
+    cerr << argv[0] << ": warning: Performance counters cover only the first "
+         << PERF_CORE_COUNT << " of " << CORE_COUNT << " cores" << endl;
+  }
+  #endif
+  output_emu = emu;
+  atexit(close_outputs);
+
+  if (speed) {
+    speed_emu = emu;
+    speed_threads = threads;
+    speed_start = chrono::steady_clock::now();
+    atexit(print_speed);
+  }
 
   int cnt = 0;
   int waituart = 0;
   if(reg_print){
     printf("Patmos start\n");
   }
-  while (limit < 0 || emu->get_tick_count() < limit)
-  {
-    cnt++;
-    emu->tick(uart_in, uart_out);
-    if(keys){
-      emu->emu_keys();
-    }
-    emu->emu_extmem();
-     // Return to address 0 halts the execution after one more iteration
-    if (halt) {
-      break;
-    }
-    #if CORE_COUNT == 1
-    if (reg_print && emu->c->Patmos__DOT__cores_0__DOT__enableReg) {
-      emu->print_state();
-    }
-
-    if ((emu->c->Patmos__DOT__cores_0__DOT__memory__DOT__memReg_mem_brcf == 1
-         || emu->c->Patmos__DOT__cores_0__DOT__memory__DOT__memReg_mem_ret == 1)
-        && emu->c->Patmos__DOT__cores_0__DOT__icache__DOT__repl__DOT__callRetBaseReg == 0) {
-      halt = true;
-    }
-    #endif
-    #if CORE_COUNT > 1
-    if (reg_print && emu->c->__PVT__Patmos__DOT__cores_0->__PVT__enableReg) {
-      emu->print_state();
+  if (batch > 0) {
+    emu->setBatch(true);
+    while (limit < 0 || emu->get_tick_count() < limit)
+    {
+      unsigned long n = batch;
+      if (limit >= 0 && (unsigned long)(limit - emu->get_tick_count()) < n) {
+        n = limit - emu->get_tick_count();
+      }
+      // End the batch at the checkpoint
+      if (ckpt_file != NULL && emu->get_tick_count() < ckpt_cycle
+          && (unsigned long)(ckpt_cycle - emu->get_tick_count()) < n) {
+        n = ckpt_cycle - emu->get_tick_count();
+      }
+      #ifdef EMU_SAVABLE
+      if (ckpt_file != NULL && emu->get_tick_count() == ckpt_cycle) {
+        emu->save_checkpoint(ckpt_file);
+      }
+      #endif
+      if (emu->run_batch(n, uart_in, uart_out, halt)) {
+        break;
+      }
     }
+  } else {
+    while (limit < 0 || emu->get_tick_count() < limit)
+    {
+      #ifdef EMU_SAVABLE
+      if (ckpt_file != NULL && emu->get_tick_count() == ckpt_cycle) {
+        emu->save_checkpoint(ckpt_file);
+      }
+      #endif
+      cnt++;
+      emu->tick(uart_in, uart_out);
+      if(keys){
+        emu->emu_keys();
+      }
+      emu->emu_extmem();
+       // Return to address 0 halts the execution after one more iteration
+      if (halt) {
+        break;
+      }
+      #if CORE_COUNT == 1
+      if (reg_print && emu->c->Patmos__DOT__cores_0__DOT__enableReg) {
+        emu->print_state();
+      }
+      #endif
+      #if CORE_COUNT > 1
+      if (reg_print && emu->c->__PVT__Patmos__DOT__cores_0->__PVT__enableReg) {
+        emu->print_state();
+      }
+      #endif
 
-    if ((emu->c->__PVT__Patmos__DOT__cores_0->__PVT__memory__DOT__memReg_mem_brcf == 1
-         || emu->c->__PVT__Patmos__DOT__cores_0->__PVT__memory__DOT__memReg_mem_ret == 1)
-        && emu->c->__PVT__Patmos__DOT__cores_0->__PVT__icache__DOT__repl__DOT__callRetBaseReg == 0) {
-      halt = true;
+      if (emu->at_halt()) {
+        halt = true;
+      }
     }
-    #endif
   }
 
   emu->stopTrace();
+  // The program did not halt before the -l limit
+  if (!halt) {
+    exit(EXIT_LIMIT);
+  }
   exit(EXIT_SUCCESS);
 }
 
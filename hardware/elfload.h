@@ -0,0 +1,188 @@
+/*
+   Copyright 2026 Technical University of Denmark, DTU Compute.
+   All rights reserved.
+
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * ELF loader shared by the emulators. The file is mapped into memory and
+ * each PT_LOAD segment is handed to the caller in one piece, so the caller
+ * can copy it into its memory model as a block.
+ */
+
+#ifndef _ELFLOAD_H_
+#define _ELFLOAD_H_
+
+#include <chrono>
+#include <iostream>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <gelf.h>
+#include <libelf.h>
+
+// A loadable segment of an ELF file
+struct elf_segment {
+  uint32_t paddr;       // physical start address
+  uint32_t flags;       // PF_* flags
+  const uint8_t *data;  // file image of the segment
+  size_t filesz;        // size of the file image
+  size_t memsz;         // size in memory, beyond filesz it is zero
+};
+
+// Read a big-endian word
+static inline uint32_t elf_word(const uint8_t *p) {
+  uint32_t w;
+  memcpy(&w, p, sizeof(w));
+  return __builtin_bswap32(w);
+}
+
+// Get word k of a segment, zero-padded beyond the file image
+static inline uint32_t elf_segment_word(const elf_segment &seg, size_t k) {
+  size_t off = k << 2;
+  if (off + 4 <= seg.filesz) {
+    return elf_word(seg.data + off);
+  }
+  uint32_t word = 0;
+  for (size_t i = 0; i < 4 && off + i < seg.filesz; i++) {
+    word |= (uint32_t)seg.data[off + i] << (24 - 8*i);
+  }
+  return word;
+}
+
+// Number of words a segment occupies in memory
+static inline size_t elf_segment_words(const elf_segment &seg) {
+  return (seg.memsz + 3) >> 2;
+}
+
+// Map an ELF file, check that it is a Patmos executable and pass each
+// loadable segment to load_segment(). Returns the entry point. The time
+// spent is stored in load_secs if that is not NULL.
+template<typename F>
+uint64_t elf_load(const char *path, F load_segment, double *load_secs = NULL)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "readelf: Cannot open elf file " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size == 0) {
+    std::cerr << "readelf: Cannot read elf file " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  // private mapping, libelf may not modify the file
+  char *image = (char *)mmap(NULL, st.st_size, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (image == MAP_FAILED) {
+    std::cerr << "readelf: Cannot map elf file " << path << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  // check libelf version
+  elf_version(EV_CURRENT);
+
+  // open elf binary
+  Elf *elf = elf_memory(image, st.st_size);
+  assert(elf);
+
+  // check file kind
+  Elf_Kind ek = elf_kind(elf);
+  if (ek != ELF_K_ELF) {
+    std::cerr << "readelf: ELF file must be of kind ELF.\n";
+    exit(EXIT_FAILURE);
+  }
+
+  // get elf header
+  GElf_Ehdr hdr;
+  GElf_Ehdr *tmphdr = gelf_getehdr(elf, &hdr);
+  assert(tmphdr);
+
+  if (hdr.e_machine != 0xBEEB) {
+    std::cerr << "readelf: unsupported architecture: ELF file is not a Patmos ELF file.\n";
+    exit(EXIT_FAILURE);
+  }
+
+  // check class
+  int ec = gelf_getclass(elf);
+  if (ec != ELFCLASS32) {
+    std::cerr << "readelf: unsupported architecture: ELF file is not a 32bit Patmos ELF file.\n";
+    exit(EXIT_FAILURE);
+  }
+
+  // get program headers
+  size_t n;
+  int ntmp = elf_getphdrnum(elf, &n);
+  assert(ntmp == 0);
+
+  for (size_t i = 0; i < n; i++) {
+    // get program header
+    GElf_Phdr phdr;
+    GElf_Phdr *phdrtmp = gelf_getphdr(elf, i, &phdr);
+    assert(phdrtmp);
+
+    if (phdr.p_type == PT_LOAD) {
+      // some assertions
+      assert(phdr.p_filesz <= phdr.p_memsz);
+      assert((phdr.p_paddr & 0x3) == 0 && "Segment not aligned to a word boundary");
+      assert(phdr.p_offset + phdr.p_filesz <= (uint64_t)st.st_size);
+
+      elf_segment seg;
+      seg.paddr = phdr.p_paddr;
+      seg.flags = phdr.p_flags;
+      seg.data = (const uint8_t *)image + phdr.p_offset;
+      seg.filesz = phdr.p_filesz;
+      seg.memsz = phdr.p_memsz;
+      load_segment(seg);
+    }
+  }
+
+  // get entry point
+  uint64_t entry = hdr.e_entry;
+
+  elf_end(elf);
+  munmap(image, st.st_size);
+
+  if (load_secs != NULL) {
+    *load_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  return entry;
+}
+
+#endif /* _ELFLOAD_H_ */
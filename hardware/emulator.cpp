@@ -38,19 +38,33 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/poll.h>
-#include <gelf.h>
-#include <libelf.h>
+#include <getopt.h>
 
 #include "Patmos.h"
 #include "emulator_config.h"
+#include "elfload.h"
+#include "extmem.h"
+#include "perfstat.h"
+#include "tracewin.h"
+#include "itrace.h"
 
 ostream *out = &cout;
 char *program_name = NULL;
 
+// Wave forms are only dumped inside the trace window
+static TraceWindow trace_win;
+static unsigned long cycle_count = 0;
+
+// Binary instruction trace of core 0
+static InstrTrace itrace;
+
 #define OCMEM_ADDR_BITS 16
 
+// Exit status when the program is stopped by -l
+#define EXIT_LIMIT 2
+
 #ifdef EXTMEM_SSRAM32CTRL
-static uint32_t *ram_buf;
+static PagedMemory<uint32_t> ram_buf;
 #define SRAM_CYCLES 3
 
 static void write_extmem(val_t address, val_t word) {
@@ -62,20 +76,11 @@ static void init_extmem(Patmos_t *c, bool random) {
   uint32_t addr_bits = c->Patmos__io_sSRam32CtrlPins_ramOut_addr.width();
   uint32_t cells = 1 << addr_bits;
 
-  // Check data width and allocate buffer
+  // Check data width and set up paged buffer, pages are allocated and
+  // initialized with random data (if requested) when first touched
   assert(c->Patmos__io_sSRam32CtrlPins_ramOut_dout.width() == 32);
-  ram_buf = (uint32_t *)calloc(cells, sizeof(uint32_t));
-  if (ram_buf == NULL) {
-    cerr << program_name << ": error: Cannot allocate memory for SRAM emulation" << endl;
-    exit(EXIT_FAILURE);
-  }
-
-  // Initialize with random data
-  if (random) {
-    for (int i = 0; i < cells; i++) {
-      write_extmem(i, rand());
-    }
-  }
+  ram_buf.init(cells);
+  ram_buf.set_random(random);
 }
 
 static void emu_extmem(Patmos_t *c) {
@@ -127,7 +132,7 @@ static void emu_extmem(Patmos_t *c) {
 #endif /* EXTMEM_SSRAM32CTRL */
 
 #ifdef EXTMEM_SRAMCTRL
-static uint16_t *ram_buf;
+static PagedMemory<uint16_t> ram_buf;
 
 static void write_extmem(val_t address, val_t word) {
   ram_buf[(address << 1) | 0] = word & 0xffff;
@@ -139,20 +144,11 @@ static void init_extmem(Patmos_t *c, bool random) {
   uint32_t addr_bits = c->Patmos_ramCtrl__addrReg.width();
   uint32_t cells = 1 << addr_bits;
 
-  // Check data width and allocate buffer
+  // Check data width and set up paged buffer, pages are allocated and
+  // initialized with random data (if requested) when first touched
   assert(c->Patmos__io_SRamCtrl_ramOut_dout.width() == 16);
-  ram_buf = (uint16_t *)calloc(cells, sizeof(uint16_t));
-  if (ram_buf == NULL) {
-    cerr << program_name << ": error: Cannot allocate memory for SRAM emulation" << endl;
-    exit(EXIT_FAILURE);
-  }
-
-  // Initialize with random data
-  if (random) {
-    for (int i = 0; i < cells/2; i++) {
-      write_extmem(i, rand());
-    }
-  }
+  ram_buf.init(cells);
+  ram_buf.set_random(random);
 }
 
 static void emu_extmem(Patmos_t *c) {
@@ -210,6 +206,7 @@ static void emu_uart(Patmos_t *c, int uart_in, int uart_out) {
   if (c->Patmos_UartCmp_uart__io_ocp_M_Cmd.to_ulong() == 0x1
       && (c->Patmos_UartCmp_uart__io_ocp_M_Addr.to_ulong() & 0xff) == 0x04) {
     unsigned char d = c->Patmos_UartCmp_uart__io_ocp_M_Data.to_ulong();
+    trace_win.uart_byte(d, cycle_count);
     int w = write(uart_out, &d, 1);
     if (w != 1) {
       cerr << program_name << ": error: Cannot write UART output" << endl;
@@ -351,6 +348,10 @@ static void emu_ethmac(Patmos_t *c, int ethmac_tap) {
     } else {
       switch (addr) {
       case 0xf004: data = (rx_ready << 2) | (tx_ready << 0); break;
+      case 0xf400: data = (tx_length << 16) | (tx ? 0x8000 : 0); break;
+      case 0xf404: data = tx_addr; break;
+      case 0xf600: data = (rx_length << 16) | (rx ? 0x8000 : 0); break;
+      case 0xf604: data = rx_addr; break;
       }
     }
     c->Patmos_PatmosCore_iocomp_EthMac_bb__dataReg = data;
@@ -372,6 +373,7 @@ static void emu_ethmac(Patmos_t *c, int ethmac_tap) {
     if (poll(&pfd, 1, 0) > 0) {
       ssize_t len = read(ethmac_tap, &buffer[rx_addr], 0x600);
       if (len > 0) {
+        rx_length = len;
         rx = 0;
         rx_ready = 1;
       } else if (len < 0) {
@@ -382,122 +384,48 @@ static void emu_ethmac(Patmos_t *c, int ethmac_tap) {
 }
 #endif /* IO_ETHMAC */
 
-// Read an elf executable image into the on-chip memories
-static val_t readelf(istream &is, Patmos_t *c)
+// Copy a segment into the on-chip memories and external memory
+static void load_segment(const elf_segment &seg, Patmos_t *c)
 {
-  vector<unsigned char> elfbuf;
-  elfbuf.reserve(1 << 20);
-
-  // read the whole stream.
-  while (!is.eof())
-  {
-    char buf[1024];
-
-    // read into buffer
-    is.read(&buf[0], sizeof(buf));
-
-    // check how much was read
-    streamsize count = is.gcount();
-    assert(count <= 1024);
-
-    // write into main memory
-    for(unsigned i = 0; i < count; i++)
-      elfbuf.push_back(buf[i]);
-  }
-
-  // check libelf version
-  elf_version(EV_CURRENT);
-
-  // open elf binary
-  Elf *elf = elf_memory((char*)&elfbuf[0], elfbuf.size());
-  assert(elf);
-
-  // check file kind
-  Elf_Kind ek = elf_kind(elf);
-  if (ek != ELF_K_ELF) {
-    cerr << "readelf: ELF file must be of kind ELF.\n";
-    exit(EXIT_FAILURE);
-  }
-
-  // get elf header
-  GElf_Ehdr hdr;
-  GElf_Ehdr *tmphdr = gelf_getehdr(elf, &hdr);
-  assert(tmphdr);
-
-  if (hdr.e_machine != 0xBEEB) {
-    cerr << "readelf: unsupported architecture: ELF file is not a Patmos ELF file.\n";
-    exit(EXIT_FAILURE);
-  }
-
-  // check class
-  int ec = gelf_getclass(elf);
-  if (ec != ELFCLASS32) {
-    cerr << "readelf: unsupported architecture: ELF file is not a 32bit Patmos ELF file.\n";
-    exit(EXIT_FAILURE);
-  }
-
-  // get program headers
-  size_t n;
-  int ntmp = elf_getphdrnum (elf, &n);
-  assert(ntmp == 0);
-
-  for(size_t i = 0; i < n; i++) {
-    // get program header
-    GElf_Phdr phdr;
-    GElf_Phdr *phdrtmp = gelf_getphdr(elf, i, &phdr);
-    assert(phdrtmp);
-
-    if (phdr.p_type == PT_LOAD) {
-      // some assertions
-      //assert(phdr.p_vaddr == phdr.p_paddr);
-      assert(phdr.p_filesz <= phdr.p_memsz);
-
-      // copy from the buffer into the on-chip memories
-      for (size_t k = 0; k < phdr.p_memsz; k++) {
-
-        if ((phdr.p_flags & PF_X) != 0 &&
-            ((phdr.p_paddr + k) >> OCMEM_ADDR_BITS) == 0x1 &&
-            ((phdr.p_paddr + k) & 0x3) == 0) {
-          // Address maps to ISPM and is at a word boundary
-          val_t word = k >= phdr.p_filesz ? 0 :
-            (((val_t)elfbuf[phdr.p_offset + k + 0] << 24) |
-             ((val_t)elfbuf[phdr.p_offset + k + 1] << 16) |
-             ((val_t)elfbuf[phdr.p_offset + k + 2] << 8) |
-             ((val_t)elfbuf[phdr.p_offset + k + 3] << 0));
-          val_t addr = ((phdr.p_paddr + k) - (0x1 << OCMEM_ADDR_BITS)) >> 3;
-          unsigned size = (sizeof(c->Patmos_PatmosCore_fetch_MemBlock__mem.contents) /
-                           sizeof(c->Patmos_PatmosCore_fetch_MemBlock__mem.contents[0]));
-          assert(addr < size && "Instructions mapped to ISPM exceed size");
-
-          // Write to even or odd block
-          if (((phdr.p_paddr + k) & 0x4) == 0) {
-            c->Patmos_PatmosCore_fetch_MemBlock__mem.put(addr, word);
-          } else {
-            c->Patmos_PatmosCore_fetch_MemBlock_1__mem.put(addr, word);
-          }
-        }
-
-        if (((phdr.p_paddr + k) & 0x3) == 0) {
-          // Address maps to SRAM and is at a word boundary
-          val_t word = k >= phdr.p_filesz ? 0 :
-            (((val_t)elfbuf[phdr.p_offset + k + 0] << 24) |
-             ((val_t)elfbuf[phdr.p_offset + k + 1] << 16) |
-             ((val_t)elfbuf[phdr.p_offset + k + 2] << 8) |
-             ((val_t)elfbuf[phdr.p_offset + k + 3] << 0));
+  size_t words = elf_segment_words(seg);
+
+  // Executable segments that start in the ISPM are also copied to the ISPM
+  if ((seg.flags & PF_X) != 0 && (seg.paddr >> OCMEM_ADDR_BITS) == 0x1) {
+    unsigned size = (sizeof(c->Patmos_PatmosCore_fetch_MemBlock__mem.contents) /
+                     sizeof(c->Patmos_PatmosCore_fetch_MemBlock__mem.contents[0]));
+    for (size_t k = 0; k < words; k++) {
+      uint32_t paddr = seg.paddr + (k << 2);
+      if ((paddr >> OCMEM_ADDR_BITS) != 0x1) {
+        break;
+      }
+      val_t addr = (paddr - (0x1 << OCMEM_ADDR_BITS)) >> 3;
+      assert(addr < size && "Instructions mapped to ISPM exceed size");
 
-          val_t addr = ((phdr.p_paddr + k) >> 2);
-          write_extmem(addr, word);
-        }
+      // Write to even or odd block
+      if ((paddr & 0x4) == 0) {
+        c->Patmos_PatmosCore_fetch_MemBlock__mem.put(addr, elf_segment_word(seg, k));
+      } else {
+        c->Patmos_PatmosCore_fetch_MemBlock_1__mem.put(addr, elf_segment_word(seg, k));
       }
     }
   }
 
-  // get entry point
-  val_t entry = hdr.e_entry;
-
-  elf_end(elf);
+  val_t addr = seg.paddr >> 2;
+  size_t full = seg.filesz >> 2;
+  for (size_t k = 0; k < full; k++) {
+    write_extmem(addr + k, elf_word(seg.data + (k << 2)));
+  }
+  // partial word at the end of the file image and zero-initialized data
+  for (size_t k = full; k < words; k++) {
+    write_extmem(addr + k, elf_segment_word(seg, k));
+  }
+}
 
-  return entry;
+// Read an elf executable image into the on-chip memories
+static val_t readelf(const char *path, Patmos_t *c, double *load_secs)
+{
+  return elf_load(path, [c](const elf_segment &seg) { load_segment(seg, c); },
+                  load_secs);
 }
 
 static void init_icache(Patmos_t *c, val_t entry) {
@@ -705,6 +633,66 @@ static void stat_icache(Patmos_t *c, bool halt) {
   }
 }
 
+static PerfStats perf;
+
+#define PERF_COUNT_CORE(n, core) do {                                   \
+    uint64_t *cnt = perf.core(n);                                       \
+    cnt[PERF_IC_HIT] += c->core##__io_perf_ic_hit.to_bool();            \
+    cnt[PERF_IC_MISS] += c->core##__io_perf_ic_miss.to_bool();          \
+    cnt[PERF_DC_HIT] += c->core##__io_perf_dc_hit.to_bool();            \
+    cnt[PERF_DC_MISS] += c->core##__io_perf_dc_miss.to_bool();          \
+    cnt[PERF_SC_SPILL] += c->core##__io_perf_sc_spill.to_bool();        \
+    cnt[PERF_SC_FILL] += c->core##__io_perf_sc_fill.to_bool();          \
+    cnt[PERF_WC_HIT] += c->core##__io_perf_wc_hit.to_bool();            \
+    cnt[PERF_WC_MISS] += c->core##__io_perf_wc_miss.to_bool();          \
+    cnt[PERF_MEM_READ] += c->core##__io_perf_mem_read.to_bool();        \
+    cnt[PERF_MEM_WRITE] += c->core##__io_perf_mem_write.to_bool();      \
+    cnt[PERF_STALL] += !c->core##__enableReg.to_bool();                 \
+    cnt[PERF_BUS_WAIT] += (c->core##__io_memPort_M_Cmd.to_ulong() != 0 \
+                           && !c->core##__io_memPort_S_CmdAccept.to_bool()); \
+  } while(0)
+
+// Only the first 8 cores are sampled
+#if CORE_COUNT > 8
+#define PERF_CORE_COUNT 8
+#else
+#define PERF_CORE_COUNT CORE_COUNT
+#endif
+
+// Record the performance counters of the first PERF_CORE_COUNT cores
+static void stat_perf(Patmos_t *c, unsigned long cycle) {
+  PERF_COUNT_CORE(0, Patmos_PatmosCore);
+  #if CORE_COUNT>1
+  PERF_COUNT_CORE(1, Patmos_PatmosCore_1);
+  #endif
+  #if CORE_COUNT>2
+  PERF_COUNT_CORE(2, Patmos_PatmosCore_2);
+  #endif
+  #if CORE_COUNT>3
+  PERF_COUNT_CORE(3, Patmos_PatmosCore_3);
+  #endif
+  #if CORE_COUNT>4
+  PERF_COUNT_CORE(4, Patmos_PatmosCore_4);
+  #endif
+  #if CORE_COUNT>5
+  PERF_COUNT_CORE(5, Patmos_PatmosCore_5);
+  #endif
+  #if CORE_COUNT>6
+  PERF_COUNT_CORE(6, Patmos_PatmosCore_6);
+  #endif
+  #if CORE_COUNT>7
+  PERF_COUNT_CORE(7, Patmos_PatmosCore_7);
+  #endif
+  perf.sample(cycle);
+}
+
+// Byte address of the bundle core 0 is fetching
+static unsigned long get_pc(Patmos_t *c) {
+  return (c->Patmos_PatmosCore_fetch__pcReg.to_ulong()
+          - c->Patmos_PatmosCore_fetch__relBaseReg.to_ulong()
+          + c->Patmos_PatmosCore_fetch__relocReg.to_ulong()) * 4;
+}
+
 static void print_state(Patmos_t *c) {
   static unsigned int baseReg = 0;
   *out << ((baseReg + c->Patmos_PatmosCore_fetch__pcReg.to_ulong()) * 4 - c->Patmos_PatmosCore_fetch__relBaseReg.to_ulong() * 4) << " - ";
@@ -717,6 +705,22 @@ static void print_state(Patmos_t *c) {
   *out << endl;
 }
 
+// Record the bundle in decode and the registers, with the same PC as
+// print_state()
+static void trace_instr(Patmos_t *c) {
+  static unsigned int baseReg = 0;
+  uint32_t regs[32];
+  for (unsigned i = 0; i < 32; i++) {
+    regs[i] = c->Patmos_PatmosCore_decode_rf__rf.get(i).to_ulong();
+  }
+  itrace.record((baseReg + c->Patmos_PatmosCore_fetch__pcReg.to_ulong()) * 4
+                - c->Patmos_PatmosCore_fetch__relBaseReg.to_ulong() * 4,
+                c->Patmos_PatmosCore_decode__decReg_instr_a.to_ulong(),
+                c->Patmos_PatmosCore_decode__decReg_instr_b.to_ulong(),
+                regs);
+  baseReg = c->Patmos_PatmosCore_icache_repl__callRetBaseReg.to_ulong();
+}
+
 static void usage(ostream &out, const char *name) {
   out << "Usage: " << name
       << " <options> [file]" << endl;
@@ -732,10 +736,26 @@ static void help(ostream &out) {
       #ifdef IO_KEYS
       << "  -k            Simulate random input from keys" << endl
       #endif /* IO_KEYS */
-      << "  -l <N>        Stop after <N> cycles" << endl
+      << "  -l <N>        Stop after <N> cycles, exit with status " << EXIT_LIMIT << endl
       << "  -p            Print instruction cache statistics" << endl
+      << "  -P <N>        Write per-core performance counters every <N> cycles" << endl
+      << "                to \"Patmos-perf.csv\"" << endl
       << "  -r            Print register values in each cycle" << endl
+      << "  --itrace <file>" << endl
+      << "                Write a binary instruction trace to <file>, see patrace" << endl
+      << "  --itrace-delta" << endl
+      << "                Delta-encode PCs and register values in the instruction trace" << endl
       << "  -v            Dump wave forms file \"Patmos.vcd\"" << endl
+      << "  --trace-start <N>" << endl
+      << "                Dump wave forms from cycle <N> on" << endl
+      << "  --trace-stop <N>" << endl
+      << "                Stop dumping wave forms at cycle <N>" << endl
+      << "  --trace-pc <addr>" << endl
+      << "                Start dumping wave forms when core 0 fetches from <addr>" << endl
+      << "  --trace-uart <byte>" << endl
+      << "                Start dumping wave forms when <byte> is written to the UART" << endl
+      << "  --trace-cycles <N>" << endl
+      << "                Dump <N> cycles of wave forms after a trigger" << endl
       #ifdef IO_UART
       << "  -I <file>     Read input for UART from file <file>" << endl
       << "  -O <file>     Write output from UART to file <file>" << endl
@@ -751,6 +771,9 @@ int main (int argc, char* argv[]) {
   bool random = false;
   int  lim = -1;
   bool print_stat = false;
+  unsigned long perf_interval = 0;
+  const char *itrace_file = NULL;
+  bool itrace_delta = false;
   bool quiet = true;
   bool vcd = false;
 
@@ -767,8 +790,21 @@ int main (int argc, char* argv[]) {
 
   program_name = argv[0];
 
+  enum { OPT_TRACE_START = 256, OPT_TRACE_STOP, OPT_TRACE_PC, OPT_TRACE_UART, OPT_TRACE_CYCLES,
+         OPT_ITRACE, OPT_ITRACE_DELTA };
+  static struct option long_options[] = {
+    { "trace-start",  required_argument, NULL, OPT_TRACE_START },
+    { "trace-stop",   required_argument, NULL, OPT_TRACE_STOP },
+    { "trace-pc",     required_argument, NULL, OPT_TRACE_PC },
+    { "trace-uart",   required_argument, NULL, OPT_TRACE_UART },
+    { "trace-cycles", required_argument, NULL, OPT_TRACE_CYCLES },
+    { "itrace",       required_argument, NULL, OPT_ITRACE },
+    { "itrace-delta", no_argument,       NULL, OPT_ITRACE_DELTA },
+    { NULL, 0, NULL, 0 }
+  };
+
   // Parse command line arguments
-  while ((opt = getopt(argc, argv, "e:hikl:nprvI:O:")) != -1) {
+  while ((opt = getopt_long(argc, argv, "e:hikl:npP:rvI:O:", long_options, NULL)) != -1) {
     switch (opt) {
     #ifdef IO_ETHMAC
     case 'e':
@@ -789,12 +825,46 @@ int main (int argc, char* argv[]) {
     case 'p':
       print_stat = true;
       break;
+    case 'P':
+      perf_interval = strtoul(optarg, NULL, 0);
+      if (perf_interval < 1) {
+        cerr << argv[0] << ": error: Invalid sampling interval " << optarg << endl;
+        exit(EXIT_FAILURE);
+      }
+      break;
     case 'r':
       quiet = false;
       break;
     case 'v':
       vcd = true;
       break;
+    case OPT_ITRACE:
+      itrace_file = optarg;
+      break;
+    case OPT_ITRACE_DELTA:
+      itrace_delta = true;
+      break;
+    // the trace window options imply -v
+    case OPT_TRACE_START:
+      trace_win.set_start(strtoul(optarg, NULL, 0));
+      vcd = true;
+      break;
+    case OPT_TRACE_STOP:
+      trace_win.set_stop(strtoul(optarg, NULL, 0));
+      vcd = true;
+      break;
+    case OPT_TRACE_PC:
+      trace_win.set_pc_trigger(strtol(optarg, NULL, 0));
+      vcd = true;
+      break;
+    case OPT_TRACE_UART:
+      trace_win.set_uart_trigger(strtol(optarg, NULL, 0) & 0xff);
+      vcd = true;
+      break;
+    case OPT_TRACE_CYCLES:
+      trace_win.set_cycles(strtoul(optarg, NULL, 0));
+      vcd = true;
+      break;
     #ifdef IO_UART
     case 'I':
       if (strcmp(optarg, "-") == 0) {
@@ -844,16 +914,21 @@ int main (int argc, char* argv[]) {
   // Parse ELF file, if present
   val_t entry = 0;
   if (optind < argc) {
-    ifstream *fs = new ifstream(argv[optind]);
-    if (!fs->good()) {
-      cerr << argv[0] << ": error: Cannot open elf file " << argv[optind] << endl;
-      exit(EXIT_FAILURE);
+    double load_secs;
+    entry = readelf(argv[optind], c, &load_secs);
+    if (print_stat) {
+      cerr << argv[0] << ": loaded " << argv[optind] << " in "
+           << load_secs * 1000 << " ms" << endl;
     }
-    entry = readelf(*fs, c);
   }
 
   // Create vcd trace file if necessary
   FILE *f = vcd ? fopen("Patmos.vcd", "w") : NULL;
+  if (f != NULL) {
+    // dumps are written out in large blocks
+    setvbuf(f, NULL, _IOFBF, 1 << 20);
+    trace_win.enable();
+  }
 
   if (!quiet) {
     *out << "Patmos start" << endl;
@@ -869,14 +944,34 @@ int main (int argc, char* argv[]) {
   // Initialize instruction cache for entry point
   init_icache(c, entry);
 
+  if (itrace_file != NULL
+      && !itrace.open(itrace_file, ITRACE_BUNDLE | (itrace_delta ? ITRACE_DELTA : 0))) {
+    cerr << argv[0] << ": error: Cannot open instruction trace " << itrace_file << endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (perf_interval > 0 && !perf.open("Patmos-perf.csv", PERF_CORE_COUNT, perf_interval)) {
+    cerr << argv[0] << ": error: Cannot open \"Patmos-perf.csv\"" << endl;
+    exit(EXIT_FAILURE);
+  }
+  #if CORE_COUNT > PERF_CORE_COUNT
+  if (perf_interval > 0) {
+    cerr << argv[0] << ": warning: Performance counters cover only the first "
+         << PERF_CORE_COUNT << " of " << CORE_COUNT << " cores" << endl;
+  }
+  #endif
+
   // Main emulation loop
   bool halt = false;
-  for (int t = 0; lim < 0 || t < lim; t++) {
+  int t;
+  for (t = 0; lim < 0 || t < lim; t++) {
     dat_t<1> reset = LIT<1>(0);
 
+    cycle_count = t;
     c->clock_lo(reset);
     // Print tracing information
-    if (vcd) {
+    if (trace_win.active()
+        && trace_win.update(t, trace_win.wants_pc() ? get_pc(c) : 0)) {
       c->dump(f, t);
     }
     c->clock_hi(reset);
@@ -899,6 +994,9 @@ int main (int argc, char* argv[]) {
     if (!quiet && c->Patmos_PatmosCore__enableReg.to_bool()) {
       print_state(c);
     }
+    if (itrace.enabled() && c->Patmos_PatmosCore__enableReg.to_bool()) {
+      trace_instr(c);
+    }
 
     // Return to address 0 halts the execution after one more iteration
     if (halt) {
@@ -914,13 +1012,23 @@ int main (int argc, char* argv[]) {
     if (print_stat) {
       stat_icache(c, halt);
     }
+    if (perf.enabled()) {
+      stat_perf(c, t + 1);
+    }
   }
+  perf.close(t);
+  itrace.close();
 
   // TODO: adapt comparison tool so this can be removed
   if (!quiet) {
     *out << "PASSED" << endl;
   }
 
+  // The program did not halt before the -l limit
+  if (!halt) {
+    return EXIT_LIMIT;
+  }
+
   // Pass on return value from processor
   return c->Patmos_PatmosCore_decode_rf__rf.get(1).to_ulong();
 }
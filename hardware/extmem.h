@@ -0,0 +1,164 @@
+/*
+   Copyright 2026 Technical University of Denmark, DTU Compute.
+   All rights reserved.
+
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Paged external memory model for the emulators. Pages of 4 KiB are only
+ * allocated when they are first touched, and are either zeroed or filled
+ * with pseudo-random data derived from the page number. This keeps startup
+ * time and memory footprint proportional to the memory a program uses.
+ */
+
+#ifndef _EXTMEM_H_
+#define _EXTMEM_H_
+
+#include <iostream>
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EXTMEM_PAGE_BYTES 4096
+
+template<typename T>
+class PagedMemory
+{
+  static const size_t page_cells = EXTMEM_PAGE_BYTES / sizeof(T);
+
+  T **pages;
+  size_t page_count;
+  size_t cells;
+  bool random;
+
+  // Allocate a page and fill it according to the initialization mode
+  T *alloc_page(size_t page)
+  {
+    T *p = (T *)malloc(EXTMEM_PAGE_BYTES);
+    if (p == NULL) {
+      std::cerr << "patemu: error: Cannot allocate memory for SRAM emulation" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+    if (random) {
+      // splitmix64 seeded with the page number, so the contents do not
+      // depend on the order in which pages are touched
+      uint64_t state = page * 0x9e3779b97f4a7c15ULL;
+      for (size_t i = 0; i < page_cells; i++) {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        p[i] = (T)(z ^ (z >> 31));
+      }
+    } else {
+      memset(p, 0, EXTMEM_PAGE_BYTES);
+    }
+    pages[page] = p;
+    return p;
+  }
+
+public:
+  PagedMemory(void) : pages(NULL), page_count(0), cells(0), random(false) { }
+
+  ~PagedMemory(void)
+  {
+    for (size_t i = 0; i < page_count; i++) {
+      free(pages[i]);
+    }
+    free(pages);
+  }
+
+  // Set up a memory of the given number of cells
+  void init(size_t size)
+  {
+    cells = size;
+    page_count = (size + page_cells - 1) / page_cells;
+    pages = (T **)calloc(page_count, sizeof(T *));
+    if (pages == NULL) {
+      std::cerr << "patemu: error: Cannot allocate memory for SRAM emulation" << std::endl;
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Fill pages that are touched from now on with random data
+  void set_random(bool on) { random = on; }
+
+  size_t size(void) const { return cells; }
+
+  T &operator[](size_t idx)
+  {
+    assert(idx < cells && "Access beyond external memory");
+    T *p = pages[idx / page_cells];
+    if (p == NULL) {
+      p = alloc_page(idx / page_cells);
+    }
+    return p[idx % page_cells];
+  }
+
+  // Serialize the allocated pages
+  template<typename S>
+  void save(S &os)
+  {
+    uint64_t allocated = 0;
+    for (size_t i = 0; i < page_count; i++) {
+      if (pages[i] != NULL) {
+        allocated++;
+      }
+    }
+    os.write(&random, sizeof(random));
+    os.write(&allocated, sizeof(allocated));
+    for (uint64_t i = 0; i < page_count; i++) {
+      if (pages[i] != NULL) {
+        os.write(&i, sizeof(i));
+        os.write(pages[i], EXTMEM_PAGE_BYTES);
+      }
+    }
+  }
+
+  template<typename S>
+  void restore(S &is)
+  {
+    uint64_t allocated;
+    for (size_t i = 0; i < page_count; i++) {
+      free(pages[i]);
+      pages[i] = NULL;
+    }
+    is.read(&random, sizeof(random));
+    is.read(&allocated, sizeof(allocated));
+    for (uint64_t k = 0; k < allocated; k++) {
+      uint64_t i;
+      is.read(&i, sizeof(i));
+      assert(i < page_count && "Invalid page in checkpoint");
+      is.read(alloc_page(i), EXTMEM_PAGE_BYTES);
+    }
+  }
+};
+
+#endif /* _EXTMEM_H_ */
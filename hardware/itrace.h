@@ -0,0 +1,153 @@
+/*
+   Copyright 2026 Technical University of Denmark, DTU Compute.
+   All rights reserved.
+
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Binary instruction trace written by the emulators, a compact replacement
+ * for the register dumps of -r. Use patrace to turn it into text.
+ *
+ * The file starts with the magic "PITR", a version byte and a flags byte
+ * (ITRACE_DELTA, ITRACE_BUNDLE). Each record then holds:
+ *   - the PC, as a 32-bit little-endian word, or with ITRACE_DELTA as a
+ *     zigzag varint of the difference to the previous PC
+ *   - with ITRACE_BUNDLE, the two instruction words of the bundle in decode
+ *   - a varint mask of the registers that changed since the last record
+ *   - the value of each changed register in ascending order, as a 32-bit
+ *     word, or with ITRACE_DELTA as a zigzag varint of the difference
+ * Varints are LEB128, 7 bits per byte starting with the least significant.
+ */
+
+#ifndef _ITRACE_H_
+#define _ITRACE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "itrace_format.h"
+
+class InstrTrace
+{
+  FILE *out;
+  unsigned flags;
+  uint32_t last_pc;
+  uint32_t last_regs[32];
+  char buf[1 << 20];
+
+  void put_word(uint32_t w)
+  {
+    uint8_t b[4] = { (uint8_t)w, (uint8_t)(w >> 8), (uint8_t)(w >> 16), (uint8_t)(w >> 24) };
+    fwrite(b, 1, 4, out);
+  }
+
+  void put_varint(uint32_t v)
+  {
+    uint8_t b[5];
+    int n = 0;
+    do {
+      b[n] = v & 0x7f;
+      v >>= 7;
+      if (v != 0) {
+        b[n] |= 0x80;
+      }
+      n++;
+    } while (v != 0);
+    fwrite(b, 1, n, out);
+  }
+
+  void put_value(uint32_t v, uint32_t last)
+  {
+    if (flags & ITRACE_DELTA) {
+      int32_t d = (int32_t)(v - last);
+      put_varint(((uint32_t)d << 1) ^ (uint32_t)(d >> 31));
+    } else {
+      put_word(v);
+    }
+  }
+
+public:
+  InstrTrace(void) : out(NULL), flags(0), last_pc(0) {}
+
+  ~InstrTrace(void) { close(); }
+
+  bool open(const char *path, unsigned f)
+  {
+    out = fopen(path, "wb");
+    if (out == NULL) {
+      return false;
+    }
+    setvbuf(out, buf, _IOFBF, sizeof(buf));
+    flags = f;
+    last_pc = 0;
+    memset(last_regs, 0, sizeof(last_regs));
+
+    fwrite(ITRACE_MAGIC, 1, 4, out);
+    fputc(ITRACE_VERSION, out);
+    fputc(flags, out);
+    return true;
+  }
+
+  bool enabled(void) const { return out != NULL; }
+
+  // Record a bundle and the register file after it
+  void record(uint32_t pc, uint32_t instr_a, uint32_t instr_b, const uint32_t *regs)
+  {
+    put_value(pc, last_pc);
+    last_pc = pc;
+    if (flags & ITRACE_BUNDLE) {
+      put_word(instr_a);
+      put_word(instr_b);
+    }
+    uint32_t mask = 0;
+    for (unsigned i = 0; i < 32; i++) {
+      if (regs[i] != last_regs[i]) {
+        mask |= 1u << i;
+      }
+    }
+    put_varint(mask);
+    for (unsigned i = 0; i < 32; i++) {
+      if (mask & (1u << i)) {
+        put_value(regs[i], last_regs[i]);
+        last_regs[i] = regs[i];
+      }
+    }
+  }
+
+  void close(void)
+  {
+    if (out != NULL) {
+      fclose(out);
+      out = NULL;
+    }
+  }
+};
+
+#endif /* _ITRACE_H_ */
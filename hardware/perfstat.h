@@ -0,0 +1,144 @@
+/*
+   Copyright 2026 Technical University of Denmark, DTU Compute.
+   All rights reserved.
+
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Per-core performance statistics shared by the emulators. The emulator
+ * adds the events of each core every cycle; every N cycles the counts of
+ * the last interval are written as one CSV row per core.
+ */
+
+#ifndef _PERFSTAT_H_
+#define _PERFSTAT_H_
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include <stdint.h>
+#include <stdlib.h>
+
+enum perf_event {
+  PERF_IC_HIT,
+  PERF_IC_MISS,
+  PERF_DC_HIT,
+  PERF_DC_MISS,
+  PERF_SC_SPILL,
+  PERF_SC_FILL,
+  PERF_WC_HIT,
+  PERF_WC_MISS,
+  PERF_MEM_READ,
+  PERF_MEM_WRITE,
+  PERF_STALL,     // pipeline not enabled
+  PERF_BUS_WAIT,  // memory command not yet accepted
+  PERF_EVENT_COUNT
+};
+
+static const char *const perf_event_names[PERF_EVENT_COUNT] = {
+  "ic_hit", "ic_miss", "dc_hit", "dc_miss", "sc_spill", "sc_fill",
+  "wc_hit", "wc_miss", "mem_read", "mem_write", "stall", "bus_wait"
+};
+
+class PerfStats
+{
+  unsigned cores;
+  unsigned long interval;
+  unsigned long last;  // cycle of the last sample
+  std::vector<uint64_t> counts;
+  std::ofstream out;
+
+public:
+  PerfStats(void) : cores(0), interval(0), last(0) {}
+
+  // Start sampling every <interval> cycles into file <path>
+  bool open(const char *path, unsigned n_cores, unsigned long n_cycles,
+            unsigned long start = 0)
+  {
+    out.open(path);
+    if (!out) {
+      return false;
+    }
+    cores = n_cores;
+    interval = n_cycles;
+    last = start;
+    counts.assign(cores * PERF_EVENT_COUNT, 0);
+
+    out << "cycle,core";
+    for (unsigned i = 0; i < PERF_EVENT_COUNT; i++) {
+      out << "," << perf_event_names[i];
+    }
+    out << "\n";
+    return true;
+  }
+
+  bool enabled(void) const { return interval != 0; }
+
+  // Event counters of one core for the current interval
+  uint64_t *core(unsigned n) { return &counts[n * PERF_EVENT_COUNT]; }
+
+  // Write a sample if the interval has passed
+  void sample(unsigned long cycle)
+  {
+    if (cycle - last >= interval) {
+      dump(cycle);
+    }
+  }
+
+  // Write the counts since the last sample and clear them
+  void dump(unsigned long cycle)
+  {
+    if (!enabled() || cycle == last) {
+      return;
+    }
+    for (unsigned n = 0; n < cores; n++) {
+      uint64_t *cnt = core(n);
+      out << cycle << "," << n;
+      for (unsigned i = 0; i < PERF_EVENT_COUNT; i++) {
+        out << "," << cnt[i];
+        cnt[i] = 0;
+      }
+      out << "\n";
+    }
+    last = cycle;
+  }
+
+  // Write the final partial interval
+  void close(unsigned long cycle)
+  {
+    if (enabled()) {
+      dump(cycle);
+      out.close();
+      interval = 0;
+    }
+  }
+};
+
+#endif /* _PERFSTAT_H_ */
@@ -290,6 +290,7 @@ object Config {
       for (d <- Devs) { emuConfig.write("#define IO_"+d.name.toUpperCase+"\n") }
       emuConfig.write("#define EXTMEM_"+ExtMem.ram.name.toUpperCase+"\n")
       emuConfig.write("#define EXTMEM_ADDR_BITS "+ ExtMemAddrWidth +"\n")
+      emuConfig.write("#define EXTMEM_SIZE "+ ExtMem.size +"\n")
       emuConfig.write("#define BAUDRATE " + ConstantsForConf.UART_BAUD.toString + "\n") //TODO take baud from configuration .XML
       emuConfig.write("#define FREQ "+ frequency +"\n")
       emuConfig.close();
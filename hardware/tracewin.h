@@ -0,0 +1,103 @@
+/*
+   Copyright 2026 Technical University of Denmark, DTU Compute.
+   All rights reserved.
+
+   This file is part of the time-predictable VLIW processor Patmos.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+      1. Redistributions of source code must retain the above copyright notice,
+         this list of conditions and the following disclaimer.
+
+      2. Redistributions in binary form must reproduce the above copyright
+         notice, this list of conditions and the following disclaimer in the
+         documentation and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDER ``AS IS'' AND ANY EXPRESS
+   OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+   OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN
+   NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY
+   DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+   THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+   The views and conclusions contained in the software and documentation are
+   those of the authors and should not be interpreted as representing official
+   policies, either expressed or implied, of the copyright holder.
+ */
+
+/*
+ * Trace window shared by the emulators. Waveforms are only dumped between
+ * a start and a stop cycle, or for a number of cycles after a trigger (PC
+ * of core 0 or a byte written to the UART).
+ */
+
+#ifndef _TRACEWIN_H_
+#define _TRACEWIN_H_
+
+class TraceWindow
+{
+  bool armed;            // tracing requested and window not closed yet
+  bool on;               // inside the window
+  unsigned long start;   // first cycle that may be traced
+  unsigned long stop;    // first cycle after the window, 0 for no end
+  unsigned long cycles;  // window length after a trigger, 0 for no end
+  long pc;               // trigger PC (byte address), -1 for none
+  int uart;              // trigger UART byte, -1 for none
+
+  void open(unsigned long cycle)
+  {
+    on = true;
+    if (cycles != 0) {
+      stop = cycle + cycles;
+    }
+  }
+
+public:
+  TraceWindow(void)
+    : armed(false), on(false), start(0), stop(0), cycles(0), pc(-1), uart(-1) {}
+
+  void enable(void) { armed = true; }
+  void set_start(unsigned long c) { start = c; }
+  void set_stop(unsigned long c) { stop = c; }
+  void set_cycles(unsigned long n) { cycles = n; }
+  void set_pc_trigger(long addr) { pc = addr; }
+  void set_uart_trigger(int byte) { uart = byte; }
+
+  // Whether update() needs to be called at all
+  bool active(void) const { return armed; }
+  bool is_on(void) const { return on; }
+  // Whether update() looks at the PC
+  bool wants_pc(void) const { return armed && !on && pc >= 0; }
+
+  // Advance to <cycle>, returns true if the cycle is to be traced. The
+  // PC is only looked at while waiting for a PC trigger.
+  bool update(unsigned long cycle, unsigned long cur_pc)
+  {
+    if (!on) {
+      if (cycle >= start
+          && ((pc < 0 && uart < 0) || (pc >= 0 && cur_pc == (unsigned long)pc))) {
+        open(cycle);
+      }
+    } else if (stop != 0 && cycle >= stop) {
+      // only one window per run
+      on = false;
+      armed = false;
+    }
+    return on;
+  }
+
+  // Note a byte written to the UART
+  void uart_byte(unsigned char d, unsigned long cycle)
+  {
+    if (armed && !on && uart >= 0 && d == uart && cycle >= start) {
+      open(cycle);
+    }
+  }
+};
+
+#endif /* _TRACEWIN_H_ */
@@ -1,4 +1,24 @@
 #!/bin/bash
+#
+# Synopsis: testsuite/run.sh [-j JOBS]
+#
+# Runs the assembler tests on the Chisel emulator and compares them against
+# the ISA simulator and pasim. With -j the tests are split into JOBS shards
+# that run in parallel. Each shard builds the emulator in its own directory
+# (hardware/build-shardN), as every test is a boot ROM application and needs
+# its own hardware build.
+
+LOG_DIR="tmp"
+jobs=1
+
+while getopts "j:h" opt; do
+    case "${opt}" in
+        j) jobs="${OPTARG}" ;;
+        *) sed -n 's/^# Synopsis: /Usage: /p' "$0" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+
 # Directories containing assembler tests
 cd asm
 test_dirs="./inst_tests ./vliw_tests"
@@ -47,19 +67,54 @@ function wait_timeout {
     fi
 }
 
-function run_chsl {
-	echo === Chisel Tests ===
-	failed_chsl=()
+# Run every JOBS-th test, starting at test number $2, with the script $1.
+# The names of the failed tests go to the shard's .failed file.
+function run_shard {
+	local i=0
+	rm -f "${LOG_DIR}/shard$2.failed"
 	for f in  ${tests}; do
-		testsuite/single_chsl.sh ${f}
-		result=$?
-		if [ "$result" -eq 124 ] ; then
-			echo " timeout"
+		if [ $((i % jobs)) -eq "$2" ] ; then
+			$1 ${f}
+			result=$?
+			if [ "$result" -eq 124 ] ; then
+				echo " timeout"
+			fi
+			if [ "$result" -ne 0 ] ; then
+				echo "${f}" >> "${LOG_DIR}/shard$2.failed"
+			fi
 		fi
-		if [ "$result" -ne 0 ] ; then
-			failed_chsl+=("${f}")
+		i=$((i+1))
+	done
+}
+
+# Run all tests with the script $1 and collect the failed ones in failed
+function run_tests {
+	failed=()
+	if [ "${jobs}" -le 1 ] ; then
+		run_shard $1 0
+	else
+		for ((s=0; s<jobs; s++)); do
+			( export HWBUILDDIR="${PWD}/hardware/build-shard${s}"
+			  run_shard $1 ${s} ) > "${LOG_DIR}/shard${s}.out" 2>&1 &
+		done
+		wait
+		for ((s=0; s<jobs; s++)); do
+			cat "${LOG_DIR}/shard${s}.out"
+		done
+	fi
+	for ((s=0; s<jobs; s++)); do
+		if [ -f "${LOG_DIR}/shard${s}.failed" ] ; then
+			while read f; do
+				failed+=("${f}")
+			done < "${LOG_DIR}/shard${s}.failed"
 		fi
 	done
+}
+
+function run_chsl {
+	echo === Chisel Tests ===
+	run_tests testsuite/single_chsl.sh
+	failed_chsl=("${failed[@]}")
 
 	for f in  ${not_working_chsl}; do
 		echo $f
@@ -74,17 +129,8 @@ function run_chsl {
 
 function run_isa {
 	echo === ISA Tests ===
-	failed_isa=()
-	for f in  ${tests}; do
-		testsuite/single_isa.sh ${f}
-		result=$?
-		if [ "$result" -eq 124 ] ; then
-			echo " timeout"
-		fi
-		if [ "$result" -ne 0 ] ; then
-			failed_isa+=("${f}")
-		fi
-	done
+	run_tests testsuite/single_isa.sh
+	failed_isa=("${failed[@]}")
 
 	for f in  ${not_working_isa}; do
 		echo $f
@@ -113,4 +159,12 @@ function run_all {
 }
 
 make tools
+mkdir -p "${LOG_DIR}"
+if [ "${jobs}" -gt 1 ] ; then
+	# Compile the Chisel and ISA simulator sources once, the shards then
+	# start their own sbt instances next to each other
+	(cd hardware && sbt compile)
+	(cd isasim && sbt compile)
+	export SBT_OPTS="${SBT_OPTS} -Dsbt.server.forcestart=true"
+fi
 run_all
@@ -0,0 +1,126 @@
+#!/bin/bash
+#
+# Synopsis: ./run_emu.sh [-j JOBS] [-l CYCLES] [-t SECONDS] [-e EMULATOR] [APP...]
+#
+# Runs C test programs on the emulator, one emulator process per test and
+# JOBS tests at a time. The UART output of each test is compared against
+# testsuite/ref/APP.ref. Without APP arguments all tests that have a .ref
+# file are run. The emulator is built once beforehand ("make emulator"),
+# so the tests must be ELF files and not boot ROM applications. The boot ROM
+# (assembler) tests are run in parallel with testsuite/run.sh -j instead.
+#
+# Return Value:
+#   0 ... all tests ok
+#   1 ... at least one test failed, timed out or reached the cycle limit
+
+LOG_DIR="tmp"
+REF_DIR="testsuite/ref"
+INSTALLDIR=../local
+
+jobs=$(nproc 2>/dev/null || echo 1)
+limit=100000000
+timeout=600
+emu="${INSTALLDIR}/bin/patemu"
+
+while getopts "j:l:t:e:h" opt; do
+    case "${opt}" in
+        j) jobs="${OPTARG}" ;;
+        l) limit="${OPTARG}" ;;
+        t) timeout="${OPTARG}" ;;
+        e) emu="${OPTARG}" ;;
+        *) sed -n 's/^# Synopsis: /Usage: /p' "$0" >&2; exit 1 ;;
+    esac
+done
+shift $((OPTIND-1))
+
+tests="$*"
+if [ -z "${tests}" ] ; then
+    for f in ${REF_DIR}/*.ref ; do
+        s="${f##*/}"
+        tests+="${s%.ref} "
+    done
+fi
+
+if [ ! -x "${emu}" ] ; then
+    echo "Emulator ${emu} not found, run 'make emulator' first" >&2
+    exit 1
+fi
+
+# Compile all tests first, the build directory is shared
+mkdir -p "${LOG_DIR}"
+for t in ${tests}; do
+    if ! make comp APP="${t}" > "${LOG_DIR}/${t}.comp.out" 2>&1 ; then
+        echo "${t}: does not compile, see ${LOG_DIR}/${t}.comp.out" >&2
+    fi
+done
+
+# Run one test and write "name result cycles seconds" to its .result file
+function run_test {
+    local t="$1"
+    local out="${LOG_DIR}/${t}.emu.out"
+    local err="${LOG_DIR}/${t}.emu.err"
+    local result
+
+    if [ ! -f "${LOG_DIR}/${t}.elf" ] ; then
+        echo "${t} nocompile 0 0" > "${LOG_DIR}/${t}.result"
+        return
+    fi
+
+    local start=$(date +%s.%N)
+    timeout "${timeout}" "${emu}" -s -l "${limit}" -O "${out}" "${LOG_DIR}/${t}.elf" \
+        < /dev/null 2> "${err}"
+    local status=$?
+    local end=$(date +%s.%N)
+
+    if [ "${status}" -eq 124 ] ; then
+        result="timeout"
+    elif [ "${status}" -eq 2 ] ; then
+        # the emulator stopped the test at the -l limit
+        result="limit"
+    elif [ "${status}" -ne 0 ] ; then
+        result="failed"
+    elif [ -f "${REF_DIR}/${t}.ref" ] && ! cmp -s "${REF_DIR}/${t}.ref" "${out}" ; then
+        result="failed"
+    else
+        result="ok"
+    fi
+
+    # the emulator reports the cycle count with -s
+    local cycles=$(sed -n 's/^patemu: \([0-9]*\) cycles in.*/\1/p' "${err}")
+    local secs=$(awk "BEGIN { print ${end} - ${start} }")
+    echo "${t} ${result} ${cycles:-0} ${secs}" > "${LOG_DIR}/${t}.result"
+}
+
+start=$(date +%s.%N)
+running=0
+for t in ${tests}; do
+    if [ "${running}" -ge "${jobs}" ] ; then
+        wait -n
+        running=$((running-1))
+    fi
+    run_test "${t}" &
+    running=$((running+1))
+done
+wait
+end=$(date +%s.%N)
+
+# Summary
+failed=()
+printf "%-32s %-10s %12s %10s\n" "test" "result" "cycles" "seconds"
+for t in ${tests}; do
+    read name result cycles secs < "${LOG_DIR}/${t}.result"
+    printf "%-32s %-10s %12s %10.2f\n" "${name}" "${result}" "${cycles}" "${secs}"
+    if [ "${result}" != "ok" ] ; then
+        failed+=("${t}")
+    fi
+done
+
+nr=$(echo ${tests} | wc -w)
+printf "%d tests on %d jobs in %.2f s\n" "${nr}" "${jobs}" "$(awk "BEGIN { print ${end} - ${start} }")"
+if [ "${#failed[@]}" -ne 0 ] ; then
+    echo "Failed tests: ${failed[@]}" >&2
+    exit 1
+else
+    echo "All tests ok"
+    exit 0
+fi
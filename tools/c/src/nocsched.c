@@ -0,0 +1,392 @@
+/*
+ * Generate a TDM schedule for the S4NOC from a communication graph.
+ *
+ * The S4NOC runs the same schedule in every router of an N x M bi-torus,
+ * so a path in the schedule carries one word from every core to the core
+ * at the same relative offset. The generator therefore turns the channels
+ * of the graph into per-offset demands and packs one path per requested
+ * slot, looking for the shortest period in which all paths fit without
+ * using a router output twice in a slot.
+ *
+ * Each line of the graph file describes one channel:
+ *
+ *   <channel id> <source core> <destination core> [<bandwidth>]
+ *
+ * The bandwidth is the number of words per period and defaults to 1.
+ * Cores are numbered row by row as in s4noc/Network.scala. Lines starting
+ * with '#' are ignored. With -a all-to-all communication is scheduled.
+ *
+ * The default output is the format read by ScheduleTable.main in the s4noc
+ * and twoway packages, -s prints the Scala string literal directly. With -x
+ * the channels are printed as a communication specification for Poseidon,
+ * which generates the noc_init_array for the Argo NoC and noc_configure().
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_DIM 16
+#define MAX_NODES (MAX_DIM*MAX_DIM)
+#define MAX_CHANNELS 4096
+#define MAX_PATHS 4096
+// Moves of a shortest path plus the local exit
+#define MAX_HOPS (MAX_DIM+1)
+#define MAX_PERIOD (MAX_PATHS*MAX_HOPS)
+
+enum { NORTH, EAST, SOUTH, WEST, LOCAL, PORTS };
+static const char port_char[PORTS] = { 'n', 'e', 's', 'w', 'l' };
+
+struct channel {
+  int id, src, dst, bw;
+};
+
+struct path {
+  int dx, dy;      // offset, east and south are positive
+  int len;         // moves plus the local exit
+  int start;
+  char route[MAX_HOPS];
+};
+
+static int width, height;
+static struct channel channels[MAX_CHANNELS];
+static int num_channels;
+static struct path paths[MAX_PATHS];
+static int num_paths;
+
+static unsigned char busy[MAX_PERIOD][PORTS];
+static unsigned char inject[MAX_PERIOD];
+
+static int offset_index(int dx, int dy)
+{
+  return ((dy + height) % height) * width + (dx + width) % width;
+}
+
+// Shortest distance on a ring and the directions that achieve it
+static int ring_dist(int d, int n, int *dir_pos, int *dir_neg)
+{
+  d = (d % n + n) % n;
+  int pos = d <= n/2;
+  *dir_pos = pos;
+  *dir_neg = d >= n - n/2 && d != 0;
+  return pos ? d : n - d;
+}
+
+static int fits(const struct path *p, int t)
+{
+  if (inject[t]) {
+    return 0;
+  }
+  for (int h = 0; h < p->len; h++) {
+    if (busy[t+h][(int)p->route[h]]) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void mark(const struct path *p, int t, int val)
+{
+  inject[t] = val;
+  for (int h = 0; h < p->len; h++) {
+    busy[t+h][(int)p->route[h]] = val;
+  }
+}
+
+// Try all orders of the horizontal and vertical moves at start slot t
+static int place_route(struct path *p, int t, int h, int hor, int nh,
+                       int ver, int nv)
+{
+  if (nh == 0 && nv == 0) {
+    p->route[h] = LOCAL;
+    return fits(p, t);
+  }
+  if (nh > 0) {
+    p->route[h] = hor;
+    if (place_route(p, t, h+1, hor, nh-1, ver, nv)) {
+      return 1;
+    }
+  }
+  if (nv > 0) {
+    p->route[h] = ver;
+    if (place_route(p, t, h+1, hor, nh, ver, nv-1)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+static int place(struct path *p, int period)
+{
+  int east, west, south, north;
+  int nh = ring_dist(p->dx, width, &east, &west);
+  int nv = ring_dist(p->dy, height, &south, &north);
+  int hors[2], vers[2];
+  int num_hor = 0, num_ver = 0;
+  if (east) hors[num_hor++] = EAST;
+  if (west) hors[num_hor++] = WEST;
+  if (south) vers[num_ver++] = SOUTH;
+  if (north) vers[num_ver++] = NORTH;
+
+  for (int t = 0; t + p->len <= period; t++) {
+    for (int i = 0; i < num_hor; i++) {
+      for (int j = 0; j < num_ver; j++) {
+        if (place_route(p, t, 0, hors[i], nh, vers[j], nv)) {
+          p->start = t;
+          mark(p, t, 1);
+          return 1;
+        }
+      }
+    }
+  }
+  return 0;
+}
+
+static int cmp_len(const void *a, const void *b)
+{
+  const struct path *pa = a, *pb = b;
+  if (pa->len != pb->len) {
+    return pb->len - pa->len;
+  }
+  return offset_index(pa->dx, pa->dy) - offset_index(pb->dx, pb->dy);
+}
+
+static int cmp_start(const void *a, const void *b)
+{
+  return ((const struct path *)a)->start - ((const struct path *)b)->start;
+}
+
+// First fit of all paths, longest first, for a growing period
+static int schedule(void)
+{
+  int lower = num_paths;
+  qsort(paths, num_paths, sizeof(struct path), cmp_len);
+  if (paths[0].len > lower) {
+    lower = paths[0].len;
+  }
+  for (int period = lower; period < MAX_PERIOD; period++) {
+    int i;
+    memset(busy, 0, sizeof(busy));
+    memset(inject, 0, sizeof(inject));
+    for (i = 0; i < num_paths; i++) {
+      if (!place(&paths[i], period)) {
+        break;
+      }
+    }
+    if (i == num_paths) {
+      qsort(paths, num_paths, sizeof(struct path), cmp_start);
+      return period;
+    }
+  }
+  return -1;
+}
+
+// One path per word of the most demanding source for each offset
+static void build_paths(void)
+{
+  static int demand[MAX_NODES][MAX_NODES];
+  memset(demand, 0, sizeof(demand));
+  for (int i = 0; i < num_channels; i++) {
+    int dx = channels[i].dst % width - channels[i].src % width;
+    int dy = channels[i].dst / width - channels[i].src / width;
+    demand[channels[i].src][offset_index(dx, dy)] += channels[i].bw;
+  }
+  num_paths = 0;
+  for (int o = 1; o < width*height; o++) {
+    int max = 0;
+    for (int s = 0; s < width*height; s++) {
+      if (demand[s][o] > max) {
+        max = demand[s][o];
+      }
+    }
+    for (int k = 0; k < max; k++) {
+      if (num_paths == MAX_PATHS) {
+        fprintf(stderr, "Too many paths\n");
+        exit(-1);
+      }
+      struct path *p = &paths[num_paths++];
+      int dummy;
+      p->dx = o % width;
+      p->dy = o / width;
+      p->len = ring_dist(p->dx, width, &dummy, &dummy)
+        + ring_dist(p->dy, height, &dummy, &dummy) + 1;
+    }
+  }
+}
+
+static void read_graph(FILE *in)
+{
+  char line[256];
+  int lineno = 0;
+  while (fgets(line, sizeof(line), in) != NULL) {
+    struct channel c;
+    lineno++;
+    if (line[0] == '#') {
+      continue;
+    }
+    c.bw = 1;
+    int n = sscanf(line, "%d %d %d %d", &c.id, &c.src, &c.dst, &c.bw);
+    if (n <= 0) {
+      continue;
+    }
+    if (n < 3 || c.src < 0 || c.src >= width*height
+        || c.dst < 0 || c.dst >= width*height || c.src == c.dst || c.bw < 1) {
+      fprintf(stderr, "Invalid channel in line %d\n", lineno);
+      exit(-1);
+    }
+    if (num_channels == MAX_CHANNELS) {
+      fprintf(stderr, "Too many channels\n");
+      exit(-1);
+    }
+    channels[num_channels++] = c;
+  }
+}
+
+static void all_to_all(void)
+{
+  num_channels = 0;
+  for (int s = 0; s < width*height; s++) {
+    for (int d = 0; d < width*height; d++) {
+      if (s != d) {
+        struct channel c = { num_channels, s, d, 1 };
+        channels[num_channels++] = c;
+      }
+    }
+  }
+}
+
+static void print_schedule(int scala)
+{
+  for (int i = 0; i < num_paths; i++) {
+    const struct path *p = &paths[i];
+    if (scala) {
+      printf("    \"");
+    }
+    for (int t = 0; t < p->start; t++) {
+      putchar(' ');
+    }
+    for (int h = 0; h < p->len - 1; h++) {
+      putchar(port_char[(int)p->route[h]]);
+    }
+    if (scala) {
+      printf("l|\"%s", i < num_paths-1 ? " +" : "");
+    }
+    printf("\n");
+  }
+}
+
+static void print_poseidon(void)
+{
+  printf("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+  printf("<communication comType=\"custom\" phits=\"3\">\n");
+  for (int i = 0; i < num_channels; i++) {
+    const struct channel *c = &channels[i];
+    printf("  <channel from=\"(%d,%d)\" to=\"(%d,%d)\" bandwidth=\"%d\"/>\n",
+           c->src % width, c->src / width, c->dst % width, c->dst / width, c->bw);
+  }
+  printf("</communication>\n");
+}
+
+// The start slots of each channel, paths of an offset are taken in order
+static void print_channels(void)
+{
+  static int used[MAX_NODES][MAX_NODES];
+  memset(used, 0, sizeof(used));
+  for (int i = 0; i < num_channels; i++) {
+    const struct channel *c = &channels[i];
+    int o = offset_index(c->dst % width - c->src % width,
+                         c->dst / width - c->src / width);
+    fprintf(stderr, "channel %d: %d -> %d, slots", c->id, c->src, c->dst);
+    int k = 0;
+    for (int j = 0; j < num_paths && k < c->bw; j++) {
+      if (offset_index(paths[j].dx, paths[j].dy) == o && k++ >= used[c->src][o]) {
+        fprintf(stderr, " %d", paths[j].start);
+      }
+    }
+    used[c->src][o] += c->bw;
+    fprintf(stderr, "\n");
+  }
+}
+
+void usage(char *name) {
+  fprintf(stderr, "Usage: %s [-s|-x] [-v] [-m height] -n width (-a | <graphfile>)\n", name);
+}
+
+int main(int argc, char* argv[]) {
+
+    int opt;
+    int scala = 0;
+    int poseidon = 0;
+    int verbose = 0;
+    int all = 0;
+
+    while ((opt = getopt(argc, argv, "asvxn:m:")) != -1) {
+      switch (opt) {
+      case 'a':
+        all = 1;
+        break;
+      case 's':
+        scala = 1;
+        break;
+      case 'v':
+        verbose = 1;
+        break;
+      case 'x':
+        poseidon = 1;
+        break;
+      case 'n':
+        width = atoi(optarg);
+        break;
+      case 'm':
+        height = atoi(optarg);
+        break;
+      default:  /* '?' */
+        usage(argv[0]);
+        exit(-1);
+      }
+    }
+    if (height == 0) {
+      height = width;
+    }
+
+    if ((argc - optind) != !all || width < 1 || width > MAX_DIM
+        || height < 1 || height > MAX_DIM || width*height < 2) {
+        usage(argv[0]);
+        exit(-1);
+    }
+
+    if (all) {
+      all_to_all();
+    } else {
+      FILE *in = fopen(argv[optind], "r");
+      if (in == NULL) {
+        perror("Cannot open input file");
+        exit(-1);
+      }
+      read_graph(in);
+      fclose(in);
+    }
+    if (num_channels == 0) {
+      fprintf(stderr, "%s: no channels\n", argv[0]);
+      exit(-1);
+    }
+
+    if (poseidon) {
+      print_poseidon();
+      return 0;
+    }
+
+    build_paths();
+    int period = schedule();
+    if (period < 0) {
+      fprintf(stderr, "%s: no schedule found\n", argv[0]);
+      exit(-1);
+    }
+    print_schedule(scala);
+    if (verbose) {
+      fprintf(stderr, "%d paths, period %d\n", num_paths, period);
+      print_channels();
+    }
+    return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Decode the binary instruction trace of the emulators (--itrace) into
+ * the text format of their -r option, which CompareChisel and the other
+ * comparison tools read. The format is described in hardware/itrace.h.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "itrace_format.h"
+
+static int get_word(FILE *in, uint32_t *w)
+{
+  uint8_t b[4];
+  if (fread(b, 1, 4, in) != 4) {
+    return 0;
+  }
+  *w = b[0] | (b[1] << 8) | (b[2] << 16) | ((uint32_t)b[3] << 24);
+  return 1;
+}
+
+static int get_varint(FILE *in, uint32_t *v)
+{
+  int shift = 0;
+  int c;
+  *v = 0;
+  do {
+    c = getc(in);
+    if (c == EOF || shift > 28) {
+      return 0;
+    }
+    *v |= (uint32_t)(c & 0x7f) << shift;
+    shift += 7;
+  } while (c & 0x80);
+  return 1;
+}
+
+static int get_value(FILE *in, int flags, uint32_t last, uint32_t *v)
+{
+  if (flags & ITRACE_DELTA) {
+    uint32_t z;
+    if (!get_varint(in, &z)) {
+      return 0;
+    }
+    *v = last + ((z >> 1) ^ -(z & 1));
+    return 1;
+  }
+  return get_word(in, v);
+}
+
+void usage(char *name) {
+  fprintf(stderr, "Usage: %s [-i] <tracefile>\n", name);
+}
+
+int main(int argc, char* argv[]) {
+
+    int opt;
+    int print_instr = 0;
+
+    while ((opt = getopt(argc, argv, "i")) != -1) {
+      switch (opt) {
+      case 'i':
+        print_instr = 1;
+        break;
+      default:  /* '?' */
+        usage(argv[0]);
+        exit(-1);
+      }
+    }
+
+    if ((argc - optind) != 1) {
+        usage(argv[0]);
+        exit(-1);
+    }
+
+    FILE *in = fopen(argv[optind], "rb");
+    if (in == NULL) {
+      perror("Cannot open input file");
+      exit(-1);
+    }
+
+    char magic[4];
+    int version = 0;
+    int flags = 0;
+    if (fread(magic, 1, 4, in) != 4 || memcmp(magic, ITRACE_MAGIC, 4) != 0
+        || (version = getc(in)) != ITRACE_VERSION || (flags = getc(in)) == EOF) {
+      fprintf(stderr, "%s: %s is not an instruction trace\n", argv[0], argv[optind]);
+      exit(-1);
+    }
+
+    // same as the output of -r
+    printf("Patmos start\n");
+
+    uint32_t pc = 0;
+    uint32_t regs[32];
+    memset(regs, 0, sizeof(regs));
+
+    while (get_value(in, flags, pc, &pc)) {
+      uint32_t instr_a = 0, instr_b = 0;
+      uint32_t mask;
+      int i;
+
+      if ((flags & ITRACE_BUNDLE)
+          && !(get_word(in, &instr_a) && get_word(in, &instr_b))) {
+        break;
+      }
+      if (!get_varint(in, &mask)) {
+        break;
+      }
+      for (i = 0; i < 32; i++) {
+        if ((mask & (1u << i)) && !get_value(in, flags, regs[i], &regs[i])) {
+          fprintf(stderr, "%s: truncated trace\n", argv[0]);
+          exit(-1);
+        }
+      }
+
+      printf("%u - ", pc);
+      for (i = 0; i < 32; i++) {
+        printf("%u ", regs[i]);
+      }
+      if (print_instr) {
+        printf("%08x %08x", instr_a, instr_b);
+      }
+      printf("\n");
+    }
+
+    fclose(in);
+    return 0;
+}